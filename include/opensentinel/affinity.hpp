@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements CPU affinity and NUMA placement of the sensor threads.
+     * @note Only supported on Linux, elsewhere the thread is left to the
+     * scheduler.
+     */
+    class affinity
+    {
+        public:
+        
+            /**
+             * Parses a CPU list (0-3,8,10-11).
+             * @param val The value.
+             */
+            static std::vector<std::uint32_t> parse_cpu_list(
+                const std::string & val
+            );
+        
+            /**
+             * Pins a thread to a set of CPUs.
+             * @param t The std::thread.
+             * @param cpus The CPUs, if empty nothing is done.
+             */
+            static void pin(
+                std::thread & t, const std::vector<std::uint32_t> & cpus
+            );
+        
+            /**
+             * The NUMA node of a network interface.
+             * @param name The interface name.
+             * @ret The node or -1 if unknown.
+             */
+            static std::int32_t interface_node(const std::string & name);
+        
+            /**
+             * The CPUs of a NUMA node.
+             * @param node The node.
+             */
+            static std::vector<std::uint32_t> node_cpus(
+                const std::int32_t & node
+            );
+        
+            /**
+             * Sets the memory policy of the calling thread to prefer a NUMA
+             * node, threads it starts inherit the policy.
+             * @param node The node, if less than zero the default policy is
+             * restored.
+             */
+            static bool set_preferred_node(const std::int32_t & node);
+    };
+
+} // namespace opensentinel
@@ -20,19 +20,25 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <ctime>
 #include <map>
 #include <string>
 #include <thread>
+#include <vector>
 
 #define ASIO_STANDALONE 1
 
 #include <asio.hpp>
 
-namespace opensentinel {
+#include <opensentinel/backpressure.hpp>
+#include <opensentinel/spsc_ring.hpp>
+#include <opensentinel/stage_signal.hpp>
+#include <opensentinel/threat.hpp>
 
-    class threat;
+namespace opensentinel {
     
     class alert_manager
     {
@@ -54,12 +60,70 @@ namespace opensentinel {
             void stop();
             
             /**
-             * :TODO:
+             * Called by the threat_manager's thread (the single producer)
+             * with a checked threat.
+             * @param threat_data The threat.
+             * @note The threat is queued on a ring drained by the alert
+             * thread, if the ring is full the backpressure policy applies.
              */
             void on_threat(const threat & threat_data);
         
+            /**
+             * Blocks until every threat handed over before the call has been
+             * handled.
+             */
+            void flush();
+        
+            /**
+             * Sets if the threat alert file is executed for each alert.
+             * @param val The value.
+             */
+            void set_execute_threat_alert(const bool & val);
+        
+            /**
+             * Sets the backpressure policy (before start).
+             * @param val The policy.
+             * @param sample_rate The sample rate.
+             */
+            void set_backpressure(
+                const backpressure::policy_t & val,
+                const std::uint32_t & sample_rate
+            );
+        
+            /**
+             * Sets the CPUs the thread is pinned to (before start).
+             * @param val The value.
+             */
+            void set_cpus(const std::vector<std::uint32_t> & val);
+        
+            /**
+             * The number of alerts raised.
+             */
+            std::uint64_t alerts() const;
+        
+            /**
+             * The (approximate) number of threats waiting to be handled.
+             */
+            std::size_t queue_depth() const;
+        
+            /**
+             * The number of threats dropped because the queue was full.
+             */
+            std::uint64_t threats_dropped() const;
+        
         private:
         
+            /**
+             * Drains up to max_batch_size threats from the queue.
+             */
+            void drain();
+        
+            /**
+             * Raises an alert for the threat unless it is a duplicate.
+             * @param val The threat.
+             */
+            void handle_threat(const threat & val);
+        
             /**
              * The timer handler.
              */
@@ -75,8 +139,38 @@ namespace opensentinel {
              */
             std::string m_file_threat_alert;
         
+            /**
+             * If true the threat alert file is executed for each alert.
+             */
+            bool m_execute_threat_alert;
+        
+            /**
+             * The number of threats dropped when last logged.
+             */
+            std::uint64_t m_threats_dropped_logged;
+        
+            /**
+             * The CPUs the thread is pinned to.
+             */
+            std::vector<std::uint32_t> m_cpus;
+        
         protected:
         
+            /**
+             * The number of threats the queue holds.
+             */
+            enum { queue_size = 1024 };
+        
+            /**
+             * The maximum number of threats handled per drain.
+             */
+            enum { max_batch_size = 64 };
+        
+            /**
+             * The maximum number of threat alert files executing at once.
+             */
+            enum { max_executing = 16 };
+        
             /**
              * The state.
              */
@@ -115,5 +209,30 @@ namespace opensentinel {
              * The alert cache.
              */
             std::map<std::string, std::time_t> alert_cache_;
+        
+            /**
+             * The number of alerts raised.
+             */
+            std::atomic<std::uint64_t> alerts_;
+        
+            /**
+             * The queue of threats waiting to be handled.
+             */
+            spsc_ring<threat> queue_;
+        
+            /**
+             * The backpressure applied when the queue is full.
+             */
+            backpressure backpressure_;
+        
+            /**
+             * The stage_signal waking the thread.
+             */
+            stage_signal stage_signal_;
+        
+            /**
+             * The number of threat alert files executing.
+             */
+            std::atomic<std::size_t> executing_;
     };
 } // namespace opensentinel
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace opensentinel {
+
+    /**
+     * Implements the policy applied when a pipeline stage hands a value to
+     * a downstream stage whose ring is full.
+     */
+    class backpressure
+    {
+        public:
+        
+            /**
+             * The policy.
+             */
+            typedef enum policy_s
+            {
+                policy_drop,
+                policy_sample,
+                policy_block,
+            } policy_t;
+        
+            /**
+             * Constructor
+             */
+            backpressure()
+                : m_policy(policy_drop)
+                , m_sample_rate(16)
+                , m_full(0)
+                , m_dropped(0)
+                , m_closed(false)
+            {
+                // ...
+            }
+        
+            /**
+             * Sets the policy (before the stage starts).
+             * @param val The policy.
+             * @param sample_rate When sampling one in sample_rate values
+             * waits for room, the rest are dropped.
+             */
+            void set_policy(
+                const policy_t & val, const std::uint32_t & sample_rate
+                )
+            {
+                m_policy = val;
+                m_sample_rate = sample_rate > 0 ? sample_rate : 1;
+            }
+        
+            /**
+             * The policy.
+             */
+            const policy_t & policy() const
+            {
+                return m_policy;
+            }
+        
+            /**
+             * Pushes a value onto the ring applying the policy if it is full.
+             * @param ring The ring.
+             * @param val The value.
+             * @return False if the value was dropped.
+             */
+            template <typename Ring, typename U>
+            bool push(Ring & ring, U && val)
+            {
+                if (ring.try_push(std::forward<U> (val)) == true)
+                {
+                    return true;
+                }
+                
+                if (
+                    m_policy == policy_drop || (m_policy == policy_sample &&
+                    ++m_full % m_sample_rate != 0)
+                    )
+                {
+                    m_dropped++;
+                    
+                    return false;
+                }
+                
+                /**
+                 * Wait for the downstream stage, try_push does not move from
+                 * the value when the ring is full.
+                 */
+                while (ring.try_push(std::forward<U> (val)) == false)
+                {
+                    if (m_closed == true)
+                    {
+                        m_dropped++;
+                        
+                        return false;
+                    }
+                    
+                    std::this_thread::yield();
+                }
+                
+                return true;
+            }
+        
+            /**
+             * Releases (and from then on drops instead of blocking) any
+             * producer waiting for room.
+             */
+            void close()
+            {
+                m_closed = true;
+            }
+        
+            /**
+             * The number of values dropped.
+             */
+            std::uint64_t dropped() const
+            {
+                return m_dropped;
+            }
+        
+            /**
+             * Parses a policy (drop, sample or block).
+             * @param val The value.
+             */
+            static policy_t policy_from_string(const std::string & val)
+            {
+                if (val == "drop")
+                {
+                    return policy_drop;
+                }
+                else if (val == "sample")
+                {
+                    return policy_sample;
+                }
+                else if (val == "block")
+                {
+                    return policy_block;
+                }
+                
+                throw std::runtime_error("invalid backpressure policy");
+            }
+        
+        private:
+        
+            /**
+             * The policy.
+             */
+            policy_t m_policy;
+        
+            /**
+             * The sample rate.
+             */
+            std::uint32_t m_sample_rate;
+        
+            /**
+             * The number of times the ring was found full.
+             */
+            std::atomic<std::uint64_t> m_full;
+        
+            /**
+             * The number of values dropped.
+             */
+            std::atomic<std::uint64_t> m_dropped;
+        
+            /**
+             * If true producers no longer block.
+             */
+            std::atomic<bool> m_closed;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace opensentinel
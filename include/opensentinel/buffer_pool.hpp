@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a per-thread pool of fixed size receive buffers.
+     * @note A buffer is leased only while a receive is completing and is
+     * returned to the free list of the thread it was leased on, so memory
+     * scales with the number of threads rather than the number of sockets.
+     */
+    class buffer_pool
+    {
+        public:
+        
+            /**
+             * The buffer length.
+             */
+            enum { buffer_length = 65535 };
+        
+            /**
+             * The maximum number of free buffers kept per thread.
+             */
+            enum { max_free = 32 };
+        
+            /**
+             * Implements a lease of a single buffer.
+             */
+            class lease
+            {
+                public:
+                
+                    /**
+                     * Constructor
+                     */
+                    lease();
+                
+                    /**
+                     * Move constructor
+                     * @param other The other lease.
+                     */
+                    lease(lease && other);
+                
+                    /**
+                     * Move assignment operator
+                     * @param other The other lease.
+                     */
+                    lease & operator = (lease && other);
+                
+                    /**
+                     * Destructor, returns the buffer to the pool.
+                     */
+                    ~lease();
+                
+                    /**
+                     * The data.
+                     */
+                    char * data();
+                
+                    /**
+                     * The size.
+                     */
+                    std::size_t size() const;
+                
+                private:
+                
+                    friend class buffer_pool;
+                
+                    /**
+                     * Constructor
+                     * @param buf The buffer.
+                     */
+                    explicit lease(std::unique_ptr<char[]> && buf);
+                
+                    /**
+                     * Copy constructor (deleted)
+                     */
+                    lease(const lease &) = delete;
+                
+                    /**
+                     * Copy assignment operator (deleted)
+                     */
+                    lease & operator = (const lease &) = delete;
+                
+                    /**
+                     * The buffer.
+                     */
+                    std::unique_ptr<char[]> m_buffer;
+            };
+        
+            /**
+             * Leases a buffer from the calling thread's free list allocating
+             * one if it is empty.
+             */
+            static lease acquire();
+        
+        private:
+        
+            /**
+             * Returns a buffer to the calling thread's free list.
+             * @param buf The buffer.
+             */
+            static void release(std::unique_ptr<char[]> && buf);
+        
+            /**
+             * The calling thread's free list.
+             */
+            static std::vector< std::unique_ptr<char[]> > & free_list();
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace opensentinel {
+
+    class capture_worker;
+    class stack_impl;
+    
+    /**
+     * Implements a capture manager that detects threats from the frames of
+     * memory-mapped packet rings instead of per port sockets. Each
+     * capture_worker runs on it's own thread and the kernel spreads the
+     * frames across them by source address.
+     */
+    class capture_manager
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             */
+            explicit capture_manager(stack_impl & owner);
+        
+            /**
+             * Starts
+             */
+            void start();
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+        private:
+        
+            // ...
+        
+        protected:
+        
+            /**
+             * The state.
+             */
+            enum
+            {
+                state_none,
+                state_starting,
+                state_started,
+                state_stopped,
+                state_stopping,
+            } state_;
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The capture_worker's.
+             */
+            std::vector< std::shared_ptr<capture_worker> > capture_workers_;
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <opensentinel/packet_ring.hpp>
+#include <opensentinel/scan_correlator.hpp>
+#include <opensentinel/scan_detector.hpp>
+
+namespace opensentinel {
+
+    class socket_filter;
+    class stack_impl;
+    
+    /**
+     * Implements a capture worker that owns a single packet ring, thread,
+     * scan_detector and scan_correlator. Workers sharing a PACKET_FANOUT
+     * group each see a disjoint set of sources so no state is shared
+     * between them.
+     */
+    class capture_worker
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             * @param index The index of this worker.
+             */
+            explicit capture_worker(
+                stack_impl & owner, const std::uint32_t & index
+            );
+        
+            /**
+             * Starts
+             * @param fanout_group The PACKET_FANOUT group to join or zero.
+             * @param filter The socket_filter or nullptr.
+             */
+            void start(
+                const std::uint16_t & fanout_group,
+                const std::shared_ptr<socket_filter> & filter
+            );
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+            /**
+             * The number of frames received.
+             */
+            std::uint64_t frames_received() const;
+        
+            /**
+             * The number of frames dropped by the kernel.
+             */
+            std::uint64_t frames_dropped();
+        
+            /**
+             * The number of threats detected.
+             */
+            std::uint64_t threats() const;
+        
+            /**
+             * Sets the time of the frames handled next.
+             * @note The replay_manager sets the recorded time of each frame
+             * so the detection windows follow the capture, not the wall
+             * clock.
+             * @param val The value.
+             */
+            void set_time(const std::chrono::system_clock::time_point & val);
+        
+            /**
+             * The (ethernet) frame handler.
+             * @note Also called by the replay_manager to feed frames read
+             * from a capture file.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_frame(
+                const std::uint8_t * buf, const std::size_t & len
+            );
+        
+            /**
+             * The ipv4 packet handler.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_ipv4(
+                const std::uint8_t * buf, const std::size_t & len
+            );
+        
+            /**
+             * The ipv6 packet handler.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_ipv6(
+                const std::uint8_t * buf, const std::size_t & len
+            );
+        
+        private:
+        
+            /**
+             * The thread loop.
+             */
+            void run();
+        
+        protected:
+        
+            /**
+             * The state.
+             */
+            enum
+            {
+                state_none,
+                state_starting,
+                state_started,
+                state_stopped,
+                state_stopping,
+            } state_;
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The index of this worker.
+             */
+            std::uint32_t index_;
+        
+            /**
+             * The packet_ring.
+             */
+            packet_ring packet_ring_;
+        
+            /**
+             * The scan_detector.
+             */
+            scan_detector scan_detector_;
+        
+            /**
+             * The scan_correlator, it sees every probe the scan_detector
+             * classifies and not only the ones it reports.
+             */
+            scan_correlator scan_correlator_;
+        
+            /**
+             * The std::thread.
+             */
+            std::thread thread_;
+        
+            /**
+             * The number of threats detected.
+             */
+            std::atomic<std::uint64_t> threats_;
+        
+            /**
+             * The (ip) packet being classified.
+             */
+            const std::uint8_t * packet_;
+        
+            /**
+             * The length of the (ip) packet being classified.
+             */
+            std::size_t packet_length_;
+        
+            /**
+             * The time of the frame being classified.
+             */
+            std::chrono::system_clock::time_point time_;
+    };
+
+} // namespace opensentinel
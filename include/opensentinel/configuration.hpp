@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/backpressure.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements the (startup) configuration.
+     */
+    class configuration
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            explicit configuration();
+        
+            /**
+             * Loads the configuration from the command line arguments.
+             * @param args The arguments.
+             */
+            void load(const std::map<std::string, std::string> & args);
+        
+            /**
+             * Sets the capture interface.
+             * @param val The value.
+             */
+            void set_capture_interface(const std::string & val);
+        
+            /**
+             * The capture interface, if empty the socket based managers are
+             * used.
+             */
+            const std::string & capture_interface() const;
+        
+            /**
+             * Sets the capture ring block size.
+             * @param val The value.
+             */
+            void set_capture_block_size(const std::uint32_t & val);
+        
+            /**
+             * The capture ring block size.
+             */
+            const std::uint32_t & capture_block_size() const;
+        
+            /**
+             * Sets the capture ring block count.
+             * @param val The value.
+             */
+            void set_capture_block_count(const std::uint32_t & val);
+        
+            /**
+             * The capture ring block count.
+             */
+            const std::uint32_t & capture_block_count() const;
+        
+            /**
+             * Sets the number of capture threads.
+             * @param val The value.
+             */
+            void set_capture_threads(const std::uint32_t & val);
+        
+            /**
+             * The number of capture threads (PACKET_FANOUT group members).
+             */
+            const std::uint32_t & capture_threads() const;
+        
+            /**
+             * Sets the replay file.
+             * @param val The value.
+             */
+            void set_replay_file(const std::string & val);
+        
+            /**
+             * The (pcap) replay file, if not empty no live sockets are used.
+             */
+            const std::string & replay_file() const;
+        
+            /**
+             * Sets if the replay follows the recorded timestamps.
+             * @param val The value.
+             */
+            void set_replay_realtime(const bool & val);
+        
+            /**
+             * If true the replay follows the recorded timestamps, otherwise
+             * it runs at maximum speed.
+             */
+            const bool & replay_realtime() const;
+        
+            /**
+             * Sets the evidence directory.
+             * @param val The value.
+             */
+            void set_evidence_path(const std::string & val);
+        
+            /**
+             * The evidence directory, if not empty threats are recorded to
+             * pcapng segments.
+             */
+            const std::string & evidence_path() const;
+        
+            /**
+             * Sets the evidence segment size.
+             * @param val The value.
+             */
+            void set_evidence_segment_size(const std::uint32_t & val);
+        
+            /**
+             * The evidence segment size in bytes.
+             */
+            const std::uint32_t & evidence_segment_size() const;
+        
+            /**
+             * Sets the evidence segment count.
+             * @param val The value.
+             */
+            void set_evidence_segment_count(const std::uint32_t & val);
+        
+            /**
+             * The number of evidence segments kept before the oldest is
+             * removed.
+             */
+            const std::uint32_t & evidence_segment_count() const;
+        
+            /**
+             * Sets the UDP batch size.
+             * @param val The value.
+             */
+            void set_udp_batch_size(const std::uint32_t & val);
+        
+            /**
+             * The maximum number of datagrams a udp_listener receives per
+             * wakeup (recvmmsg), 1 receives them one at a time.
+             */
+            const std::uint32_t & udp_batch_size() const;
+        
+            /**
+             * Sets the transparent port.
+             * @param val The value.
+             */
+            void set_transparent_port(const std::uint16_t & val);
+        
+            /**
+             * The transparent port, if not zero a single IP_TRANSPARENT TCP
+             * acceptor and UDP listener are opened on it (for TPROXY rules)
+             * instead of one per monitored port.
+             */
+            const std::uint16_t & transparent_port() const;
+        
+            /**
+             * Sets the number of network threads.
+             * @param val The value.
+             */
+            void set_network_threads(const std::uint32_t & val);
+        
+            /**
+             * The number of network threads, if greater than 1 each TCP port
+             * is opened once per thread with SO_REUSEPORT and the UDP
+             * listeners are spread across the threads.
+             */
+            const std::uint32_t & network_threads() const;
+        
+            /**
+             * Sets if the io_uring backend is used.
+             * @param val The value.
+             */
+            void set_io_uring(const bool & val);
+        
+            /**
+             * If true (on Linux) the uring_manager serves the per port
+             * sockets instead of the asio based managers.
+             */
+            const bool & io_uring() const;
+        
+            /**
+             * Sets if the per port sockets are dual-stack.
+             * @param val The value.
+             */
+            void set_dual_stack(const bool & val);
+        
+            /**
+             * If true each port is served by a single ipv6 socket with
+             * IPV6_V6ONLY disabled instead of an ipv4 and an ipv6 socket.
+             */
+            const bool & dual_stack() const;
+        
+            /**
+             * Sets the backpressure policy of the threat stage.
+             * @param val The value.
+             */
+            void set_threat_policy(const backpressure::policy_t & val);
+        
+            /**
+             * The backpressure policy applied when the threat_manager's
+             * queue is full.
+             */
+            const backpressure::policy_t & threat_policy() const;
+        
+            /**
+             * Sets the backpressure policy of the alert stage.
+             * @param val The value.
+             */
+            void set_alert_policy(const backpressure::policy_t & val);
+        
+            /**
+             * The backpressure policy applied when the alert_manager's
+             * queue is full.
+             */
+            const backpressure::policy_t & alert_policy() const;
+        
+            /**
+             * Sets the sample rate.
+             * @param val The value.
+             */
+            void set_sample_rate(const std::uint32_t & val);
+        
+            /**
+             * When a stage samples one in sample rate values waits for room
+             * downstream, the rest are dropped.
+             */
+            const std::uint32_t & sample_rate() const;
+        
+            /**
+             * Sets the CPUs of a thread role.
+             * @param role The role (network, capture, threat, alert, icmp,
+             * evidence or uring).
+             * @param val The value.
+             */
+            void set_cpus(
+                const std::string & role, const std::vector<std::uint32_t> & val
+            );
+        
+            /**
+             * The CPUs the threads of a role are pinned to, if empty the
+             * threads are left to the scheduler.
+             * @param role The role.
+             */
+            std::vector<std::uint32_t> cpus(const std::string & role) const;
+        
+            /**
+             * Sets the NUMA node.
+             * @param val The value.
+             */
+            void set_numa_node(const std::int32_t & val);
+        
+            /**
+             * The NUMA node the rings and buffer pools are allocated on, if
+             * less than zero the node of the capture interface (if any).
+             */
+            const std::int32_t & numa_node() const;
+        
+            /**
+             * Sets the signature file.
+             * @param val The value.
+             */
+            void set_signature_file(const std::string & val);
+        
+            /**
+             * The signature file the threat_manager compiles it's signatures
+             * from, if empty the built-in signatures are used.
+             */
+            const std::string & signature_file() const;
+        
+            /**
+             * Sets the correlation window.
+             * @param val The value.
+             */
+            void set_correlation_window(const std::uint32_t & val);
+        
+            /**
+             * The window in seconds over which the scan_correlator counts the
+             * distinct ports and hosts of each source.
+             */
+            const std::uint32_t & correlation_window() const;
+        
+            /**
+             * Sets the number of correlation sources.
+             * @param val The value.
+             */
+            void set_correlation_sources(const std::uint32_t & val);
+        
+            /**
+             * The maximum number of sources the scan_correlator tracks at
+             * once.
+             */
+            const std::uint32_t & correlation_sources() const;
+        
+            /**
+             * Sets the flood threshold.
+             * @param val The value.
+             */
+            void set_flood_threshold(const std::uint32_t & val);
+        
+            /**
+             * The number of threats a source must send within a flood
+             * interval for the heavy_hitters to summarize it, zero never
+             * summarizes.
+             */
+            const std::uint32_t & flood_threshold() const;
+        
+            /**
+             * Sets the flood interval.
+             * @param val The value.
+             */
+            void set_flood_interval(const std::uint32_t & val);
+        
+            /**
+             * The interval in seconds at which the heavy_hitters are logged
+             * and the summarized sources reported.
+             */
+            const std::uint32_t & flood_interval() const;
+        
+            /**
+             * The monitored port ranges.
+             */
+            const std::vector<
+                std::pair<std::uint16_t, std::uint16_t>
+            > & port_ranges() const;
+        
+            /**
+             * If true the port falls within a monitored port range.
+             * @param port The port.
+             */
+            bool is_monitored_port(const std::uint16_t & port) const;
+        
+            /**
+             * The allow-listed sources (address and prefix length), traffic
+             * from these is dropped before it reaches a manager.
+             */
+            const std::vector<
+                std::pair<asio::ip::address, std::uint8_t>
+            > & allowed_sources() const;
+        
+            /**
+             * If true the address falls within an allow-listed source.
+             * @param addr The address.
+             */
+            bool is_allowed_source(const asio::ip::address & addr) const;
+        
+        private:
+        
+            /**
+             * The capture interface.
+             */
+            std::string m_capture_interface;
+        
+            /**
+             * The capture ring block size.
+             */
+            std::uint32_t m_capture_block_size;
+        
+            /**
+             * The capture ring block count.
+             */
+            std::uint32_t m_capture_block_count;
+        
+            /**
+             * The number of capture threads.
+             */
+            std::uint32_t m_capture_threads;
+        
+            /**
+             * The replay file.
+             */
+            std::string m_replay_file;
+        
+            /**
+             * If true the replay follows the recorded timestamps.
+             */
+            bool m_replay_realtime;
+        
+            /**
+             * The evidence directory.
+             */
+            std::string m_evidence_path;
+        
+            /**
+             * The evidence segment size.
+             */
+            std::uint32_t m_evidence_segment_size;
+        
+            /**
+             * The evidence segment count.
+             */
+            std::uint32_t m_evidence_segment_count;
+        
+            /**
+             * The UDP batch size.
+             */
+            std::uint32_t m_udp_batch_size;
+        
+            /**
+             * The transparent port.
+             */
+            std::uint16_t m_transparent_port;
+        
+            /**
+             * The number of network threads.
+             */
+            std::uint32_t m_network_threads;
+        
+            /**
+             * If true the io_uring backend is used.
+             */
+            bool m_io_uring;
+        
+            /**
+             * If true the per port sockets are dual-stack.
+             */
+            bool m_dual_stack;
+        
+            /**
+             * The backpressure policy of the threat stage.
+             */
+            backpressure::policy_t m_threat_policy;
+        
+            /**
+             * The backpressure policy of the alert stage.
+             */
+            backpressure::policy_t m_alert_policy;
+        
+            /**
+             * The sample rate.
+             */
+            std::uint32_t m_sample_rate;
+        
+            /**
+             * The CPUs of each thread role.
+             */
+            std::map<std::string, std::vector<std::uint32_t> > m_cpus;
+        
+            /**
+             * The NUMA node.
+             */
+            std::int32_t m_numa_node;
+        
+            /**
+             * The signature file.
+             */
+            std::string m_signature_file;
+        
+            /**
+             * The correlation window.
+             */
+            std::uint32_t m_correlation_window;
+        
+            /**
+             * The number of correlation sources.
+             */
+            std::uint32_t m_correlation_sources;
+        
+            /**
+             * The flood threshold.
+             */
+            std::uint32_t m_flood_threshold;
+        
+            /**
+             * The flood interval.
+             */
+            std::uint32_t m_flood_interval;
+        
+            /**
+             * The monitored port ranges.
+             */
+            std::vector<
+                std::pair<std::uint16_t, std::uint16_t>
+            > m_port_ranges;
+        
+            /**
+             * The allow-listed sources.
+             */
+            std::vector<
+                std::pair<asio::ip::address, std::uint8_t>
+            > m_allowed_sources;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
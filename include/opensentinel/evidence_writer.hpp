@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+namespace opensentinel {
+
+    class threat;
+    
+    /**
+     * Implements an evidence writer that appends the packets (or payloads)
+     * of threats to rotating pcapng segments.
+     * @note Each segment is preallocated and memory-mapped so records are
+     * copied in without a write system call, all file IO happens on the
+     * writer's own thread so callers never block.
+     */
+    class evidence_writer
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            explicit evidence_writer();
+        
+            /**
+             * Destructor
+             */
+            ~evidence_writer();
+        
+            /**
+             * Starts
+             * @param path The directory the segments are written to.
+             * @param segment_size The size of each segment in bytes.
+             * @param segment_count The number of segments to keep.
+             */
+            void start(
+                const std::string & path, const std::uint32_t & segment_size,
+                const std::uint32_t & segment_count
+            );
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+            /**
+             * Queues the threat to be written, if the queue is full the
+             * threat is dropped rather than blocking the caller.
+             * @param threat_data The threat.
+             */
+            void write(const threat & threat_data);
+        
+            /**
+             * The number of records written.
+             */
+            std::uint64_t records_written() const;
+        
+            /**
+             * The number of records dropped.
+             */
+            std::uint64_t records_dropped() const;
+        
+            /**
+             * Sets the CPUs the thread is pinned to (before start).
+             * @param val The value.
+             */
+            void set_cpus(const std::vector<std::uint32_t> & val);
+        
+        private:
+        
+            /**
+             * The timer handler.
+             */
+            void on_tick();
+        
+            /**
+             * The thread loop.
+             */
+            void run();
+        
+            /**
+             * Opens a new segment writing the section and interface headers.
+             */
+            void open_segment();
+        
+            /**
+             * Closes the current segment trimming it to the bytes used.
+             */
+            void close_segment();
+        
+            /**
+             * Appends an enhanced packet block for the threat.
+             * @param threat_data The threat.
+             */
+            void append(const threat & threat_data);
+        
+            /**
+             * Copies a block into the current segment.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void append_block(
+                const std::uint8_t * buf, const std::size_t & len
+            );
+        
+            /**
+             * The directory the segments are written to.
+             */
+            std::string m_path;
+        
+            /**
+             * The size of each segment in bytes.
+             */
+            std::uint32_t m_segment_size;
+        
+            /**
+             * The number of segments to keep.
+             */
+            std::uint32_t m_segment_count;
+        
+            /**
+             * The number of segments opened.
+             */
+            std::uint32_t m_segments_opened;
+        
+            /**
+             * The paths of the segments written, oldest first.
+             */
+            std::deque<std::string> m_segment_paths;
+        
+            /**
+             * The file descriptor of the current segment.
+             */
+            int m_file;
+        
+            /**
+             * The memory-mapped current segment.
+             */
+            std::uint8_t * m_segment;
+        
+            /**
+             * The offset into the current segment.
+             */
+            std::size_t m_offset;
+        
+            /**
+             * The CPUs the thread is pinned to.
+             */
+            std::vector<std::uint32_t> m_cpus;
+        
+        protected:
+        
+            /**
+             * The maximum number of threats waiting to be written.
+             */
+            enum { maximum_pending = 8192 };
+        
+            /**
+             * The state.
+             */
+            enum
+            {
+                state_none,
+                state_starting,
+                state_started,
+                state_stopped,
+                state_stopping,
+            } state_;
+        
+            /**
+             * The asio::io_service.
+             */
+            asio::io_service io_service_;
+        
+            /**
+             * The asio::strand.
+             */
+            asio::strand strand_;
+        
+            /**
+             * The std::thread.
+             */
+            std::thread thread_;
+        
+            /**
+             * The timer.
+             */
+            asio::basic_waitable_timer<
+                std::chrono::steady_clock
+            > timer_;
+        
+            /**
+             * The number of threats waiting to be written.
+             */
+            std::atomic<std::size_t> pending_;
+        
+            /**
+             * The number of records written.
+             */
+            std::atomic<std::uint64_t> records_written_;
+        
+            /**
+             * The number of records dropped.
+             */
+            std::atomic<std::uint64_t> records_dropped_;
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/threat.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements a streaming heavy hitter stage, every threat is counted by
+     * it's source and destination port in a count-min sketch and the
+     * highest volume of each are kept in a top-K heap and logged once per
+     * interval. A source that reaches the flood threshold within an
+     * interval is summarized, it's threats are counted instead of reported
+     * and a single flood threat with it's rate and highest level is
+     * reported for it at the end of each interval it lasts.
+     * The intervals run on the threat timestamps so a replay summarizes
+     * the same at any speed.
+     * @note Memory is fixed by the sketch width, the heap size and the
+     * number of summarized sources, it never grows with the attack. This
+     * class is not thread safe, the threat_manager's thread owns it.
+     */
+    class heavy_hitters
+    {
+        public:
+        
+            /**
+             * The number of heavy hitters kept (and summarized sources),
+             * beyond it a flooding source is reported as usual.
+             */
+            enum { top_k = 16 };
+        
+            /**
+             * Constructor
+             */
+            explicit heavy_hitters();
+        
+            /**
+             * Starts the first interval.
+             * @param threshold The number of threats per interval at which a
+             * source is summarized, zero never summarizes.
+             * @param interval The interval in seconds.
+             */
+            void start(
+                const std::uint32_t & threshold, const std::uint32_t & interval
+            );
+        
+            /**
+             * Sets the flood threat handler.
+             * @param f The std::function.
+             */
+            void set_on_threat(const std::function<void (threat &)> & f);
+        
+            /**
+             * Called for every (checked) threat.
+             * @param val The threat.
+             * @return If true the threat was summarized and should not be
+             * reported on it's own.
+             */
+            bool on_threat(const threat & val);
+        
+            /**
+             * Called once per second (or for every threat of a replay), ends
+             * the interval when due.
+             * @param time The current (or recorded) time.
+             */
+            void on_tick(const std::chrono::system_clock::time_point & time);
+        
+            /**
+             * The number of threats summarized.
+             */
+            const std::uint64_t & summarized() const;
+        
+            /**
+             * The memory used by the sketches in bytes.
+             */
+            std::size_t memory() const;
+        
+        private:
+        
+            /**
+             * The number of rows of a count-min sketch.
+             */
+            enum { sketch_depth = 4 };
+        
+            /**
+             * The number of counters per row (a power of two).
+             */
+            enum { sketch_width = 4096 };
+        
+            /**
+             * A heavy hitter.
+             */
+            typedef struct entry_s
+            {
+                std::uint64_t hash;
+                std::uint32_t count;
+                std::uint8_t key[16];
+            } entry_t;
+        
+            /**
+             * Implements a count-min sketch (with conservative update) and a
+             * min heap of the top_k keys by estimate.
+             */
+            class sketch
+            {
+                public:
+                
+                    /**
+                     * Constructor
+                     */
+                    sketch();
+                
+                    /**
+                     * Counts a key.
+                     * @param hash The hash of the key.
+                     * @param key The key (16 bytes).
+                     * @return The estimate.
+                     */
+                    std::uint32_t add(
+                        const std::uint64_t & hash, const std::uint8_t * key
+                    );
+                
+                    /**
+                     * The heavy hitters, highest first.
+                     */
+                    std::vector<entry_t> top() const;
+                
+                    /**
+                     * Clears the counters and the heap.
+                     */
+                    void clear();
+                
+                    /**
+                     * The memory used in bytes.
+                     */
+                    std::size_t memory() const;
+                
+                private:
+                
+                    /**
+                     * The counters.
+                     */
+                    std::vector<std::uint32_t> m_counters;
+                
+                    /**
+                     * The heap.
+                     */
+                    std::vector<entry_t> m_heap;
+            };
+        
+            /**
+             * A summarized source.
+             */
+            typedef struct summary_s
+            {
+                std::uint64_t hash;
+                std::uint64_t events;
+                std::uint16_t port;
+                std::uint8_t protocol;
+                std::uint8_t level;
+                std::uint8_t address[16];
+            } summary_t;
+        
+            /**
+             * The seconds since the first time seen.
+             * @param time The time.
+             */
+            std::uint32_t now(
+                const std::chrono::system_clock::time_point & time
+            );
+        
+            /**
+             * Ends the interval, logging the heavy hitters and reporting the
+             * summarized sources.
+             * @param time The seconds since the first time seen.
+             */
+            void end_interval(const std::uint32_t & time);
+        
+            /**
+             * The flood threat handler.
+             */
+            std::function<void (threat &)> m_on_threat;
+        
+            /**
+             * The source sketch.
+             */
+            sketch m_sources;
+        
+            /**
+             * The destination port sketch.
+             */
+            sketch m_ports;
+        
+            /**
+             * The summarized sources.
+             */
+            std::vector<summary_t> m_summaries;
+        
+            /**
+             * The flood threshold.
+             */
+            std::uint32_t m_threshold;
+        
+            /**
+             * The interval in seconds.
+             */
+            std::uint32_t m_interval;
+        
+            /**
+             * The first time seen, every time is relative to it.
+             */
+            std::chrono::system_clock::time_point m_time_start;
+        
+            /**
+             * The start of the interval.
+             */
+            std::uint32_t m_time_interval;
+        
+            /**
+             * The number of threats in the interval.
+             */
+            std::uint64_t m_events;
+        
+            /**
+             * The number of threats summarized.
+             */
+            std::uint64_t m_summarized;
+        
+            /**
+             * The number of threats in the interval of sources that reached
+             * the threshold but could not be summarized (top_k were).
+             */
+            std::uint64_t m_unsummarized;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
@@ -62,7 +62,9 @@ namespace opensentinel {
                         type_info_request = 15,
                         type_info_reply = 16,
                         type_address_request = 17,
-                        type_address_reply = 18
+                        type_address_reply = 18,
+                        type_echo_request_v6 = 128,
+                        type_echo_reply_v6 = 129
                     } type_t;
 
                     /**
@@ -85,10 +87,21 @@ namespace opensentinel {
                      * The type (string).
                      */
                     const std::string type_string() const
+                    {
+                        return type_string(type());
+                    }
+                
+                    /**
+                     * The type (string).
+                     * @param val The type.
+                     */
+                    static const std::string type_string(
+                        const std::uint8_t & val
+                        )
                     {
                         std::string ret;
                         
-                        switch (type())
+                        switch (val)
                         {
                             case type_echo_reply:
                             {
@@ -155,6 +168,16 @@ namespace opensentinel {
                                 ret = "type_address_reply";
                             }
                             break;
+                            case type_echo_request_v6:
+                            {
+                                ret = "type_echo_request_v6";
+                            }
+                            break;
+                            case type_echo_reply_v6:
+                            {
+                                ret = "type_echo_reply_v6";
+                            }
+                            break;
                             default:
                             break;
                         }
@@ -21,12 +21,17 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #define ASIO_STANDALONE 1
 
 #include <asio.hpp>
 
+#include <opensentinel/socket_filter.hpp>
+
 namespace opensentinel {
 
     class stack_impl;
@@ -53,29 +58,62 @@ namespace opensentinel {
         
         private:
         
-            /**
-             * The timer handler.
-             */
-            void on_tick();
-        
             /**
              * The thread loop.
              */
             void run();
         
             /**
-             * Starts an IPv4 receive operation.
+             * Starts a receive operation.
+             * @param s The asio::ip::icmp::socket.
              */
-            void async_receive_ipv4();
+            void async_receive(asio::ip::icmp::socket & s);
         
             /**
              * The receive handler.
+             * @param ec The std::error_code.
+             * @param len The length (unused on Linux where the packets are
+             * read with recvmmsg).
+             * @param s The asio::ip::icmp::socket.
+             */
+            void handle_receive(
+                const std::error_code & ec, const std::size_t & len,
+                asio::ip::icmp::socket & s
+            );
+        
+            /**
+             * Handles an ipv4 packet (including the ipv4 header).
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_packet_ipv4(
+                const std::uint8_t * buf, const std::size_t & len
+            );
+        
+            /**
+             * Handles an ICMPv6 packet (the kernel strips the ipv6 header).
+             * @param addr The source asio::ip::address_v6.
+             * @param buf The buffer.
              * @param len The length.
              */
-            void handle_receive_ipv4(const std::size_t & len);
+            void handle_packet_ipv6(
+                const asio::ip::address_v6 & addr, const std::uint8_t * buf,
+                const std::size_t & len
+            );
         
         protected:
         
+            /**
+             * The maximum length of a packet, only the headers are parsed
+             * so longer packets are truncated.
+             */
+            enum { max_length = 2048 };
+        
+            /**
+             * The maximum number of packets read per wakeup.
+             */
+            enum { max_batch_size = 32 };
+        
             /**
              * The state.
              */
@@ -109,11 +147,9 @@ namespace opensentinel {
             std::thread thread_;
         
             /**
-             * The timer.
+             * The asio::io_service::work keeping the std::thread alive.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > timer_;
+            std::shared_ptr<asio::io_service::work> work_;
         
             /**
              * The asio::ip::icmp::socket.
@@ -121,8 +157,33 @@ namespace opensentinel {
             asio::ip::icmp::socket socket_ipv4_;
         
             /**
-             * The (read) asio::streambuf.
+             * The ipv6 asio::ip::icmp::socket.
+             */
+            asio::ip::icmp::socket socket_ipv6_;
+        
+            /**
+             * The remote asio::ip::icmp::endpoint.
+             */
+            asio::ip::icmp::endpoint remote_endpoint_ipv4_;
+        
+            /**
+             * The ipv6 remote asio::ip::icmp::endpoint.
+             */
+            asio::ip::icmp::endpoint remote_endpoint_ipv6_;
+        
+            /**
+             * The read buffers (one per packet of a batch).
+             */
+            std::vector<std::uint8_t> read_buffers_ipv4_;
+        
+            /**
+             * The ipv6 read buffers (one per packet of a batch).
+             */
+            std::vector<std::uint8_t> read_buffers_ipv6_;
+        
+            /**
+             * The socket_filter.
              */
-            asio::streambuf read_streambuf_ipv4_;
+            socket_filter socket_filter_;
     };
 } // namespace opensentinel
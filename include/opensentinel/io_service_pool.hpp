@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements a pool of asio::io_service objects each run by it's own
+     * thread.
+     */
+    class io_service_pool
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            explicit io_service_pool();
+        
+            /**
+             * Starts
+             * @param size The number of asio::io_service objects (threads).
+             * @param cpus The CPUs the threads are pinned to, one CPU per
+             * thread wrapping around the list.
+             */
+            void start(
+                const std::size_t & size,
+                const std::vector<std::uint32_t> & cpus =
+                std::vector<std::uint32_t> ()
+            );
+        
+            /**
+             * Stops, the threads exit once their asio::io_service has run
+             * out of work.
+             */
+            void stop();
+        
+            /**
+             * The number of asio::io_service objects.
+             */
+            std::size_t size() const;
+        
+            /**
+             * The asio::io_service at index.
+             * @param index The index.
+             */
+            asio::io_service & get_io_service(const std::size_t & index);
+        
+        private:
+        
+            /**
+             * The thread loop.
+             * @param index The index of the asio::io_service.
+             */
+            void run(const std::size_t & index);
+        
+        protected:
+        
+            /**
+             * The state.
+             */
+            enum
+            {
+                state_none,
+                state_starting,
+                state_started,
+                state_stopped,
+                state_stopping,
+            } state_;
+        
+            /**
+             * The asio::io_service objects.
+             */
+            std::vector< std::shared_ptr<asio::io_service> > io_services_;
+        
+            /**
+             * The asio::io_service::work objects keeping the threads alive.
+             */
+            std::vector<
+                std::shared_ptr<asio::io_service::work>
+            > io_service_works_;
+        
+            /**
+             * The std::thread objects.
+             */
+            std::vector<std::thread> threads_;
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a vectorized literal prefilter, the rarest two byte anchor
+     * of every pattern (or the byte of a single byte pattern) is looked for
+     * with Teddy style nibble masks (eight buckets, AVX2 or SSSE3 chosen at
+     * runtime with a scalar fallback) so a payload that contains no anchor
+     * is skipped without walking the automaton.
+     * @note A hit is only a candidate, the exact matcher must confirm it.
+     * Beyond max_anchors the masks saturate so only the exact (scalar)
+     * anchor lookup is used.
+     */
+    class literal_prefilter
+    {
+        public:
+        
+            /**
+             * The maximum number of distinct anchors for the nibble masks,
+             * beyond it the anchors are looked up by the scalar loop.
+             */
+            enum { max_anchors = 64 };
+        
+            /**
+             * Constructor
+             */
+            explicit literal_prefilter();
+        
+            /**
+             * Chooses the anchors of the patterns and builds the masks.
+             * @param patterns The patterns.
+             */
+            void compile(const std::vector<std::string> & patterns);
+        
+            /**
+             * If true the prefilter is in use, otherwise every payload is a
+             * candidate.
+             */
+            const bool & enabled() const;
+        
+            /**
+             * Finds the first candidate in a buffer.
+             * @param buf The buffer.
+             * @param len The length.
+             * @ret The offset from which a pattern may start or len if no
+             * pattern can match.
+             */
+            std::size_t find(const char * buf, const std::size_t & len) const;
+        
+            /**
+             * The name of the instruction set in use (scalar when the masks
+             * are not).
+             */
+            const char * isa() const;
+        
+        private:
+        
+            /**
+             * The instruction sets.
+             */
+            typedef enum isa_s
+            {
+                isa_scalar,
+                isa_ssse3,
+                isa_avx2,
+            } isa_t;
+        
+            /**
+             * The (heuristic) frequency of a byte in honeyport payloads
+             * (mostly HTTP and TLS), lower is rarer.
+             * @param val The value.
+             */
+            static std::uint32_t frequency(const std::uint8_t & val);
+        
+            /**
+             * Finds the first anchor with the scalar loop.
+             * @param buf The buffer.
+             * @param offset The offset to start from.
+             * @param len The length.
+             */
+            std::size_t find_scalar(
+                const std::uint8_t * buf, std::size_t offset,
+                const std::size_t & len
+            ) const;
+        
+            /**
+             * Finds the first anchor with SSSE3.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            std::size_t find_ssse3(
+                const std::uint8_t * buf, const std::size_t & len
+            ) const;
+        
+            /**
+             * Finds the first anchor with AVX2.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            std::size_t find_avx2(
+                const std::uint8_t * buf, const std::size_t & len
+            ) const;
+        
+            /**
+             * If true the prefilter is in use.
+             */
+            bool m_enabled;
+        
+            /**
+             * The instruction set in use.
+             */
+            isa_t m_isa;
+        
+            /**
+             * If true the nibble masks are in use, otherwise the anchors are
+             * looked up by the scalar loop alone.
+             */
+            bool m_masked;
+        
+            /**
+             * The largest offset of an anchor into it's pattern.
+             */
+            std::size_t m_max_offset;
+        
+            /**
+             * The bucket masks indexed by the low and high nibble of the
+             * first and second anchor byte.
+             */
+            std::array<std::uint8_t, 16> m_masks[4];
+        
+            /**
+             * The anchors (first byte << 8 | second byte) confirming a
+             * bucket hit.
+             */
+            std::bitset<65536> m_anchors;
+        
+            /**
+             * The single byte patterns confirming a bucket hit.
+             */
+            std::bitset<256> m_bytes;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a bounded lock-free multiple producer, single consumer
+     * ring.
+     * @note Each cell carries a sequence number (after Vyukov) so producers
+     * claim a cell with a single compare and swap on the tail and the
+     * consumer never takes a lock.
+     */
+    template <typename T>
+    class mpsc_ring
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param size The number of cells, must be a power of two.
+             */
+            explicit mpsc_ring(const std::size_t & size)
+                : m_cells(size)
+                , m_mask(size - 1)
+                , m_head(0)
+                , m_tail(0)
+            {
+                if (size < 2 || (size & (size - 1)) != 0)
+                {
+                    throw std::runtime_error("size must be a power of two");
+                }
+                
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+        
+            /**
+             * Destructor
+             */
+            ~mpsc_ring()
+            {
+                consume([](T &) {}, capacity());
+            }
+        
+            /**
+             * Pushes a value, called by any number of producers.
+             * @param val The value (not moved from if the ring is full).
+             * @return False if the ring is full.
+             */
+            template <typename U>
+            bool try_push(U && val)
+            {
+                cell * c = nullptr;
+                
+                auto pos = m_tail.load(std::memory_order_relaxed);
+                
+                for (;;)
+                {
+                    c = &m_cells[pos & m_mask];
+                    
+                    auto seq = c->sequence.load(std::memory_order_acquire);
+                    
+                    auto diff =
+                        static_cast<std::ptrdiff_t> (seq) -
+                        static_cast<std::ptrdiff_t> (pos)
+                    ;
+                    
+                    if (diff == 0)
+                    {
+                        if (
+                            m_tail.compare_exchange_weak(pos, pos + 1,
+                            std::memory_order_relaxed)
+                            )
+                        {
+                            break;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = m_tail.load(std::memory_order_relaxed);
+                    }
+                }
+                
+                new (&c->storage) T(std::forward<U> (val));
+                
+                c->sequence.store(pos + 1, std::memory_order_release);
+                
+                return true;
+            }
+        
+            /**
+             * Pops up to max values handing each to f, called by the single
+             * consumer only.
+             * @param f The function (which must not throw).
+             * @param max The maximum number of values.
+             * @return The number of values popped.
+             */
+            template <typename F>
+            std::size_t consume(F && f, const std::size_t & max)
+            {
+                std::size_t ret = 0;
+                
+                auto pos = m_head.load(std::memory_order_relaxed);
+                
+                while (ret < max)
+                {
+                    auto & c = m_cells[pos & m_mask];
+                    
+                    if (
+                        c.sequence.load(std::memory_order_acquire) != pos + 1
+                        )
+                    {
+                        break;
+                    }
+                    
+                    auto ptr = reinterpret_cast<T *> (&c.storage);
+                    
+                    f(*ptr);
+                    
+                    ptr->~T();
+                    
+                    /**
+                     * Hand the cell back to the producers one lap ahead.
+                     */
+                    c.sequence.store(
+                        pos + m_mask + 1, std::memory_order_release
+                    );
+                    
+                    m_head.store(++pos, std::memory_order_relaxed);
+                    
+                    ret++;
+                }
+                
+                return ret;
+            }
+        
+            /**
+             * The (approximate) number of values in the ring.
+             */
+            std::size_t size() const
+            {
+                auto tail = m_tail.load(std::memory_order_relaxed);
+                auto head = m_head.load(std::memory_order_relaxed);
+                
+                return tail > head ? tail - head : 0;
+            }
+        
+            /**
+             * The number of cells.
+             */
+            std::size_t capacity() const
+            {
+                return m_mask + 1;
+            }
+        
+        private:
+        
+            /**
+             * A cell.
+             */
+            struct cell
+            {
+                std::atomic<std::size_t> sequence;
+                typename std::aligned_storage<
+                    sizeof(T), alignof(T)
+                >::type storage;
+            };
+        
+            /**
+             * The cells.
+             */
+            std::vector<cell> m_cells;
+        
+            /**
+             * The mask.
+             */
+            std::size_t m_mask;
+        
+            /**
+             * The position the consumer pops from.
+             */
+            alignas(64) std::atomic<std::size_t> m_head;
+        
+            /**
+             * The position the producers push to.
+             */
+            alignas(64) std::atomic<std::size_t> m_tail;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace opensentinel
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace opensentinel {
+
+    class socket_filter;
+    
+    
+    /**
+     * Implements an AF_PACKET TPACKET_V3 memory-mapped receive ring.
+     * @note The kernel fills whole blocks of frames which are then walked
+     * in user space without a system call per frame.
+     */
+    class packet_ring
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            explicit packet_ring();
+        
+            /**
+             * Destructor
+             */
+            ~packet_ring();
+        
+            /**
+             * Opens the ring on the given interface.
+             * @param interface_name The interface name.
+             * @param block_size The size of each block in bytes.
+             * @param block_count The number of blocks.
+             * @param fanout_group The PACKET_FANOUT group to join or zero.
+             */
+            void open(
+                const std::string & interface_name,
+                const std::uint32_t & block_size,
+                const std::uint32_t & block_count,
+                const std::uint16_t & fanout_group = 0
+            );
+        
+            /**
+             * Sets the socket_filter attached by open.
+             * @param val The socket_filter.
+             */
+            void set_socket_filter(const std::shared_ptr<socket_filter> & val);
+        
+            /**
+             * Closes the ring.
+             */
+            void close();
+        
+            /**
+             * If true the ring is open.
+             */
+            bool is_open() const;
+        
+            /**
+             * Waits for the next block and walks all of it's frames.
+             * @param timeout_ms The maximum time to wait in milliseconds.
+             * @param f The frame handler.
+             * @ret The number of frames handled.
+             */
+            std::size_t poll(
+                const std::int32_t & timeout_ms,
+                const std::function<void (const std::uint8_t *,
+                const std::size_t &)> & f
+            );
+        
+            /**
+             * The number of frames received.
+             */
+            const std::uint64_t & frames_received() const;
+        
+            /**
+             * The number of frames dropped by the kernel.
+             */
+            std::uint64_t frames_dropped();
+        
+        private:
+        
+            /**
+             * Joins the PACKET_FANOUT group spreading frames across the
+             * members by source address.
+             * @param fanout_group The group.
+             */
+            void join_fanout_group(const std::uint16_t & fanout_group);
+        
+            /**
+             * The socket.
+             */
+            int m_socket;
+        
+            /**
+             * The memory-mapped ring.
+             */
+            std::uint8_t * m_ring;
+        
+            /**
+             * The size of each block in bytes.
+             */
+            std::uint32_t m_block_size;
+        
+            /**
+             * The number of blocks.
+             */
+            std::uint32_t m_block_count;
+        
+            /**
+             * The index of the next block to be consumed.
+             */
+            std::uint32_t m_block_index;
+        
+            /**
+             * The number of frames received.
+             */
+            std::uint64_t m_frames_received;
+        
+            /**
+             * The number of frames dropped by the kernel.
+             */
+            std::uint64_t m_frames_dropped;
+        
+            /**
+             * The socket_filter.
+             */
+            std::shared_ptr<socket_filter> m_socket_filter;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,685 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements a view of an IPv4 header.
+     * @note The views parse in place from the receive buffer and must not
+     * outlive it, the accessors (other than valid) assume valid() returned
+     * true.
+     */
+    class ipv4_view
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            constexpr ipv4_view(
+                const std::uint8_t * buf, const std::size_t & len
+                )
+                : data_(buf)
+                , length_(len)
+            {
+                // ...
+            }
+        
+            /**
+             * If true the buffer holds a complete IPv4 header.
+             */
+            constexpr bool valid() const
+            {
+                return
+                    length_ >= 20 && version() == 4 && header_length() >= 20 &&
+                    header_length() <= length_
+                ;
+            }
+        
+            /**
+             * The version.
+             */
+            constexpr std::uint8_t version() const
+            {
+                return (data_[0] >> 4) & 0xF;
+            }
+        
+            /**
+             * The header length.
+             */
+            constexpr std::uint16_t header_length() const
+            {
+                return (data_[0] & 0xF) * 4;
+            }
+        
+            /**
+             * The total length.
+             */
+            constexpr std::uint16_t total_length() const
+            {
+                return decode(2);
+            }
+        
+            /**
+             * The current fragment offset.
+             */
+            constexpr std::uint16_t fragment_offset() const
+            {
+                return decode(6) & 0x1FFF;
+            }
+        
+            /**
+             * The TTL (time to live).
+             */
+            constexpr std::uint8_t time_to_live() const
+            {
+                return data_[8];
+            }
+        
+            /**
+             * The protocol.
+             */
+            constexpr std::uint8_t protocol() const
+            {
+                return data_[9];
+            }
+        
+            /**
+             * The length of the packet with any link layer padding trimmed.
+             */
+            constexpr std::size_t packet_length() const
+            {
+                return total_length() < length_ ? total_length() : length_;
+            }
+        
+            /**
+             * The payload (transport header).
+             */
+            constexpr const std::uint8_t * payload() const
+            {
+                return data_ + header_length();
+            }
+        
+            /**
+             * The payload length.
+             */
+            constexpr std::size_t payload_length() const
+            {
+                return
+                    packet_length() > header_length() ?
+                    packet_length() - header_length() : 0
+                ;
+            }
+        
+            /**
+             * The source asio::ip::address_v4.
+             */
+            asio::ip::address_v4 source_address() const
+            {
+                asio::ip::address_v4::bytes_type bytes =
+                {
+                    { data_[12], data_[13], data_[14], data_[15] }
+                };
+                
+                return asio::ip::address_v4(bytes);
+            }
+        
+            /**
+             * The destination asio::ip::address_v4.
+             */
+            asio::ip::address_v4 destination_address() const
+            {
+                asio::ip::address_v4::bytes_type bytes =
+                {
+                    { data_[16], data_[17], data_[18], data_[19] }
+                };
+                
+                return asio::ip::address_v4(bytes);
+            }
+        
+        private:
+        
+            /**
+             * Decodes a big-endian 16-bit value.
+             * @param offset The offset.
+             */
+            constexpr std::uint16_t decode(const std::size_t & offset) const
+            {
+                return
+                    static_cast<std::uint16_t> (
+                    (data_[offset] << 8) + data_[offset + 1])
+                ;
+            }
+        
+            /**
+             * The data.
+             */
+            const std::uint8_t * data_;
+        
+            /**
+             * The length.
+             */
+            std::size_t length_;
+    };
+    
+    /**
+     * Implements a view of an IPv6 header.
+     * @note Extension headers are not followed.
+     */
+    class ipv6_view
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            constexpr ipv6_view(
+                const std::uint8_t * buf, const std::size_t & len
+                )
+                : data_(buf)
+                , length_(len)
+            {
+                // ...
+            }
+        
+            /**
+             * If true the buffer holds a complete IPv6 header.
+             */
+            constexpr bool valid() const
+            {
+                return length_ >= header_length && version() == 6;
+            }
+        
+            /**
+             * The version.
+             */
+            constexpr std::uint8_t version() const
+            {
+                return (data_[0] >> 4) & 0xF;
+            }
+        
+            /**
+             * The next header.
+             */
+            constexpr std::uint8_t next_header() const
+            {
+                return data_[6];
+            }
+        
+            /**
+             * The hop limit.
+             */
+            constexpr std::uint8_t hop_limit() const
+            {
+                return data_[7];
+            }
+        
+            /**
+             * The length of the packet with any link layer padding trimmed.
+             */
+            constexpr std::size_t packet_length() const
+            {
+                return
+                    static_cast<std::size_t> (header_length + decode(4)) <
+                    length_ ? header_length + decode(4) : length_
+                ;
+            }
+        
+            /**
+             * The payload (transport or extension header).
+             */
+            constexpr const std::uint8_t * payload() const
+            {
+                return data_ + header_length;
+            }
+        
+            /**
+             * The payload length.
+             */
+            constexpr std::size_t payload_length() const
+            {
+                return packet_length() - header_length;
+            }
+        
+            /**
+             * The source asio::ip::address_v6.
+             */
+            asio::ip::address_v6 source_address() const
+            {
+                asio::ip::address_v6::bytes_type bytes;
+                
+                std::copy(data_ + 8, data_ + 24, bytes.begin());
+                
+                return asio::ip::address_v6(bytes);
+            }
+        
+            /**
+             * The destination asio::ip::address_v6.
+             */
+            asio::ip::address_v6 destination_address() const
+            {
+                asio::ip::address_v6::bytes_type bytes;
+                
+                std::copy(data_ + 24, data_ + 40, bytes.begin());
+                
+                return asio::ip::address_v6(bytes);
+            }
+        
+        private:
+        
+            /**
+             * The fixed header length.
+             */
+            enum { header_length = 40 };
+        
+            /**
+             * Decodes a big-endian 16-bit value.
+             * @param offset The offset.
+             */
+            constexpr std::uint16_t decode(const std::size_t & offset) const
+            {
+                return
+                    static_cast<std::uint16_t> (
+                    (data_[offset] << 8) + data_[offset + 1])
+                ;
+            }
+        
+            /**
+             * The data.
+             */
+            const std::uint8_t * data_;
+        
+            /**
+             * The length.
+             */
+            std::size_t length_;
+    };
+    
+    /**
+     * Implements a view of a UDP header.
+     */
+    class udp_view
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            constexpr udp_view(
+                const std::uint8_t * buf, const std::size_t & len
+                )
+                : data_(buf)
+                , length_(len)
+            {
+                // ...
+            }
+        
+            /**
+             * If true the buffer holds a complete UDP header.
+             */
+            constexpr bool valid() const
+            {
+                return length_ >= header_length;
+            }
+        
+            /**
+             * The source port.
+             */
+            constexpr std::uint16_t source_port() const
+            {
+                return decode(0);
+            }
+        
+            /**
+             * The destination port.
+             */
+            constexpr std::uint16_t destination_port() const
+            {
+                return decode(2);
+            }
+        
+            /**
+             * The length (header and payload).
+             */
+            constexpr std::uint16_t length() const
+            {
+                return decode(4);
+            }
+        
+            /**
+             * The checksum.
+             */
+            constexpr std::uint16_t checksum() const
+            {
+                return decode(6);
+            }
+        
+            /**
+             * The payload.
+             */
+            constexpr const std::uint8_t * payload() const
+            {
+                return data_ + header_length;
+            }
+        
+            /**
+             * The payload length.
+             */
+            constexpr std::size_t payload_length() const
+            {
+                return length_ - header_length;
+            }
+        
+        private:
+        
+            /**
+             * The header length.
+             */
+            enum { header_length = 8 };
+        
+            /**
+             * Decodes a big-endian 16-bit value.
+             * @param offset The offset.
+             */
+            constexpr std::uint16_t decode(const std::size_t & offset) const
+            {
+                return
+                    static_cast<std::uint16_t> (
+                    (data_[offset] << 8) + data_[offset + 1])
+                ;
+            }
+        
+            /**
+             * The data.
+             */
+            const std::uint8_t * data_;
+        
+            /**
+             * The length.
+             */
+            std::size_t length_;
+    };
+    
+    /**
+     * Implements a view of a TCP header.
+     */
+    class tcp_view
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            constexpr tcp_view(
+                const std::uint8_t * buf, const std::size_t & len
+                )
+                : data_(buf)
+                , length_(len)
+            {
+                // ...
+            }
+        
+            /**
+             * If true the buffer holds a complete TCP header (with any
+             * options).
+             */
+            constexpr bool valid() const
+            {
+                return
+                    length_ >= 20 && header_length() >= 20 &&
+                    header_length() <= length_
+                ;
+            }
+        
+            /**
+             * The source port.
+             */
+            constexpr std::uint16_t source_port() const
+            {
+                return decode(0);
+            }
+        
+            /**
+             * The destination port.
+             */
+            constexpr std::uint16_t destination_port() const
+            {
+                return decode(2);
+            }
+        
+            /**
+             * The sequence number.
+             */
+            constexpr std::uint32_t sequence_number() const
+            {
+                return
+                    (static_cast<std::uint32_t> (decode(4)) << 16) + decode(6)
+                ;
+            }
+        
+            /**
+             * The acknowledgement number.
+             */
+            constexpr std::uint32_t acknowledgement_number() const
+            {
+                return
+                    (static_cast<std::uint32_t> (decode(8)) << 16) + decode(10)
+                ;
+            }
+        
+            /**
+             * The header length.
+             */
+            constexpr std::uint16_t header_length() const
+            {
+                return (data_[12] >> 4) * 4;
+            }
+        
+            /**
+             * The flags (tcp_header::flag_t).
+             */
+            constexpr std::uint8_t flags() const
+            {
+                return data_[13];
+            }
+        
+            /**
+             * The window.
+             */
+            constexpr std::uint16_t window() const
+            {
+                return decode(14);
+            }
+        
+            /**
+             * The payload.
+             */
+            constexpr const std::uint8_t * payload() const
+            {
+                return data_ + header_length();
+            }
+        
+            /**
+             * The payload length.
+             */
+            constexpr std::size_t payload_length() const
+            {
+                return length_ - header_length();
+            }
+        
+        private:
+        
+            /**
+             * Decodes a big-endian 16-bit value.
+             * @param offset The offset.
+             */
+            constexpr std::uint16_t decode(const std::size_t & offset) const
+            {
+                return
+                    static_cast<std::uint16_t> (
+                    (data_[offset] << 8) + data_[offset + 1])
+                ;
+            }
+        
+            /**
+             * The data.
+             */
+            const std::uint8_t * data_;
+        
+            /**
+             * The length.
+             */
+            std::size_t length_;
+    };
+    
+    /**
+     * Implements a view of an ICMP (or ICMPv6) header.
+     */
+    class icmp_view
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            constexpr icmp_view(
+                const std::uint8_t * buf, const std::size_t & len
+                )
+                : data_(buf)
+                , length_(len)
+            {
+                // ...
+            }
+        
+            /**
+             * If true the buffer holds a complete ICMP header.
+             */
+            constexpr bool valid() const
+            {
+                return length_ >= header_length;
+            }
+        
+            /**
+             * The type.
+             */
+            constexpr std::uint8_t type() const
+            {
+                return data_[0];
+            }
+        
+            /**
+             * The code.
+             */
+            constexpr std::uint8_t code() const
+            {
+                return data_[1];
+            }
+        
+            /**
+             * The checksum.
+             */
+            constexpr std::uint16_t checksum() const
+            {
+                return decode(2);
+            }
+        
+            /**
+             * The identifier.
+             */
+            constexpr std::uint16_t identifier() const
+            {
+                return decode(4);
+            }
+        
+            /**
+             * The sequence number.
+             */
+            constexpr std::uint16_t sequence_number() const
+            {
+                return decode(6);
+            }
+        
+            /**
+             * The payload.
+             */
+            constexpr const std::uint8_t * payload() const
+            {
+                return data_ + header_length;
+            }
+        
+            /**
+             * The payload length.
+             */
+            constexpr std::size_t payload_length() const
+            {
+                return length_ - header_length;
+            }
+        
+        private:
+        
+            /**
+             * The header length.
+             */
+            enum { header_length = 8 };
+        
+            /**
+             * Decodes a big-endian 16-bit value.
+             * @param offset The offset.
+             */
+            constexpr std::uint16_t decode(const std::size_t & offset) const
+            {
+                return
+                    static_cast<std::uint16_t> (
+                    (data_[offset] << 8) + data_[offset + 1])
+                ;
+            }
+        
+            /**
+             * The data.
+             */
+            const std::uint8_t * data_;
+        
+            /**
+             * The length.
+             */
+            std::size_t length_;
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a (classic libpcap format) capture file reader.
+     * @note Both byte orders and microsecond or nanosecond timestamps are
+     * supported, pcapng is not.
+     */
+    class pcap_reader
+    {
+        public:
+        
+            /**
+             * The link types.
+             */
+            typedef enum link_type_s
+            {
+                link_type_ethernet = 1,
+                link_type_raw = 101,
+                link_type_linux_sll = 113,
+            } link_type_t;
+        
+            /**
+             * Constructor
+             */
+            explicit pcap_reader();
+        
+            /**
+             * Opens the file and reads the global header.
+             * @param path The path.
+             */
+            void open(const std::string & path);
+        
+            /**
+             * Closes the file.
+             */
+            void close();
+        
+            /**
+             * Reads the next packet.
+             * @param timestamp The (recorded) time the packet was captured.
+             * @ret False at the end of the file.
+             */
+            bool read(std::chrono::nanoseconds & timestamp);
+        
+            /**
+             * The data of the last packet read.
+             */
+            const std::vector<std::uint8_t> & data() const;
+        
+            /**
+             * The link type.
+             */
+            const std::uint32_t & link_type() const;
+        
+        private:
+        
+            /**
+             * Reads a 32-bit value in the byte order of the file.
+             * @param buf The buffer.
+             */
+            std::uint32_t read_uint32(const std::uint8_t * buf) const;
+        
+            /**
+             * The std::ifstream.
+             */
+            std::ifstream m_ifstream;
+        
+            /**
+             * If true the file was written in big endian byte order.
+             */
+            bool m_big_endian;
+        
+            /**
+             * If true the timestamps have nanosecond resolution.
+             */
+            bool m_nanoseconds;
+        
+            /**
+             * The link type.
+             */
+            std::uint32_t m_link_type;
+        
+            /**
+             * The snapshot length.
+             */
+            std::uint32_t m_snap_length;
+        
+            /**
+             * The data of the last packet read.
+             */
+            std::vector<std::uint8_t> m_data;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a regular expression compiled ahead of time into a
+     * minimized DFA over byte classes, so a search costs one table lookup
+     * per byte with no backtracking and memory bounded by max_states.
+     * @note The syntax is a subset of ECMAScript: literals, ., [...] and
+     * [^...] with ranges, \d \D \w \W \s \S, \xHH \r \n \t \0 and escaped
+     * metacharacters, (...) and (?:...), |, *, +, ?, {m}, {m,} and {m,n}, ^
+     * at the start and $ at the end. Back-references, lookaround, lazy
+     * quantifiers and word boundaries can not be expressed by a DFA and are
+     * rejected. Matching is a search (the pattern may match anywhere) unless
+     * anchored with ^.
+     */
+    class regex_dfa
+    {
+        public:
+        
+            /**
+             * The maximum number of DFA states (before minimization).
+             */
+            enum { max_states = 4096 };
+        
+            /**
+             * The maximum count of a bounded repetition.
+             */
+            enum { max_repeat = 255 };
+        
+            /**
+             * Constructor
+             */
+            explicit regex_dfa();
+        
+            /**
+             * Compiles a pattern.
+             * @param pattern The pattern.
+             * @param case_insensitive If true letters match either case.
+             */
+            void compile(
+                const std::string & pattern, const bool & case_insensitive
+            );
+        
+            /**
+             * If true the pattern matches somewhere in the buffer.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            bool search(const char * buf, const std::size_t & len) const;
+        
+            /**
+             * The number of states of the minimized DFA.
+             */
+            std::size_t states() const;
+        
+            /**
+             * The number of byte classes.
+             */
+            std::size_t classes() const;
+        
+            /**
+             * The size of the transition table in bytes.
+             */
+            std::size_t table_size() const;
+        
+        private:
+        
+            /**
+             * A node of the parsed pattern.
+             */
+            struct node;
+        
+            /**
+             * An NFA state.
+             */
+            typedef struct nfa_state_s
+            {
+                std::vector<std::uint32_t> epsilons;
+                std::int32_t set;
+                std::uint32_t next;
+            } nfa_state_t;
+        
+            /**
+             * Parses an alternation.
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param case_insensitive If true letters match either case.
+             * @param anchored If true the alternation is the (ungrouped) top
+             * level of an anchored pattern and a | is rejected.
+             */
+            static std::unique_ptr<node> parse_alternation(
+                const std::string & pattern, std::size_t & pos,
+                const bool & case_insensitive, const bool & anchored
+            );
+        
+            /**
+             * Parses a concatenation.
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param case_insensitive If true letters match either case.
+             */
+            static std::unique_ptr<node> parse_concatenation(
+                const std::string & pattern, std::size_t & pos,
+                const bool & case_insensitive
+            );
+        
+            /**
+             * Parses an atom and it's quantifiers.
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param case_insensitive If true letters match either case.
+             */
+            static std::unique_ptr<node> parse_repetition(
+                const std::string & pattern, std::size_t & pos,
+                const bool & case_insensitive
+            );
+        
+            /**
+             * Parses an atom.
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param case_insensitive If true letters match either case.
+             */
+            static std::unique_ptr<node> parse_atom(
+                const std::string & pattern, std::size_t & pos,
+                const bool & case_insensitive
+            );
+        
+            /**
+             * Parses an escape (after the backslash).
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param in_class If true the escape is inside [...].
+             */
+            static std::bitset<256> parse_escape(
+                const std::string & pattern, std::size_t & pos,
+                const bool & in_class
+            );
+        
+            /**
+             * Parses a bracket expression (after the [).
+             * @param pattern The pattern.
+             * @param pos The position.
+             * @param case_insensitive If true letters match either case.
+             */
+            static std::bitset<256> parse_class(
+                const std::string & pattern, std::size_t & pos,
+                const bool & case_insensitive
+            );
+        
+            /**
+             * Adds the other case of every letter in a set.
+             * @param val The value.
+             */
+            static void fold_case(std::bitset<256> & val);
+        
+            /**
+             * Emits the NFA states of a node.
+             * @param n The node.
+             * @param nfa The NFA.
+             * @param sets The byte sets of the NFA transitions.
+             * @ret The start and end states.
+             */
+            static std::pair<std::uint32_t, std::uint32_t> emit(
+                const node & n, std::vector<nfa_state_t> & nfa,
+                std::vector< std::bitset<256> > & sets
+            );
+        
+            /**
+             * The class of each byte.
+             */
+            std::array<std::uint8_t, 256> m_classes;
+        
+            /**
+             * The number of byte classes.
+             */
+            std::uint32_t m_class_count;
+        
+            /**
+             * The transitions, m_class_count per state.
+             */
+            std::vector<std::uint16_t> m_transitions;
+        
+            /**
+             * If a state is accepting.
+             */
+            std::vector<bool> m_accepting;
+        
+            /**
+             * The start state.
+             */
+            std::uint16_t m_start;
+        
+            /**
+             * The dead state (only anchored patterns have one).
+             */
+            std::int32_t m_dead;
+        
+            /**
+             * If true the pattern is anchored at the start (^).
+             */
+            bool m_anchored_start;
+        
+            /**
+             * If true the pattern is anchored at the end ($).
+             */
+            bool m_anchored_end;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
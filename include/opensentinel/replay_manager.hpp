@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <opensentinel/capture_worker.hpp>
+
+namespace opensentinel {
+
+    class stack_impl;
+    
+    /**
+     * Implements a replay manager that feeds the packets of a capture file
+     * through the same classification as the capture_manager and on to the
+     * threat_manager and alert_manager without any live sockets.
+     */
+    class replay_manager
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             */
+            explicit replay_manager(stack_impl & owner);
+        
+            /**
+             * Replays the capture file blocking until every packet has been
+             * classified.
+             * @param path The path.
+             * @param realtime If true follow the recorded timestamps.
+             */
+            void run(const std::string & path, const bool & realtime);
+        
+            /**
+             * The number of packets replayed.
+             */
+            const std::uint64_t & packets() const;
+        
+            /**
+             * The number of threats detected.
+             */
+            std::uint64_t threats() const;
+        
+        private:
+        
+            /**
+             * The number of packets replayed.
+             */
+            std::uint64_t m_packets;
+        
+        protected:
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The capture_worker doing the classification.
+             */
+            capture_worker capture_worker_;
+    };
+
+} // namespace opensentinel
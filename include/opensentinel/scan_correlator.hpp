@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/threat.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements a per source scan correlation engine, every threat updates
+     * it's source's distinct destination ports (per protocol) and hosts over
+     * a sliding window and a source is reported once as a vertical scan, a
+     * sweep or (when it goes quiet) a single probe with it's rate, a probe
+     * at level_0 as it's threat was already reported on it's own.
+     * The windows run on the threat timestamps so a replay correlates the
+     * same at any speed.
+     * @note The sources live in a fixed size table of compact entries that
+     * count distinct ports and hosts with small HyperLogLog sketches, when
+     * full the least recently seen source of a probe sequence is evicted so
+     * memory never grows with the number of sources. The window slides in
+     * halves, each half has it's own sketches. This class is not thread
+     * safe, the threat_manager's thread owns it.
+     */
+    class scan_correlator
+    {
+        public:
+        
+            /**
+             * The number of distinct ports of a vertical scan.
+             */
+            enum { vertical_threshold = 16 };
+        
+            /**
+             * The number of distinct hosts of a sweep.
+             */
+            enum { sweep_threshold = 16 };
+        
+            /**
+             * Constructor
+             */
+            explicit scan_correlator();
+        
+            /**
+             * Allocates the table.
+             * @param sources The maximum number of sources tracked (rounded
+             * up to a power of two).
+             * @param window The window in seconds.
+             */
+            void start(
+                const std::uint32_t & sources, const std::uint32_t & window
+            );
+        
+            /**
+             * Sets the correlated threat handler.
+             * @param f The std::function.
+             */
+            void set_on_threat(const std::function<void (threat &)> & f);
+        
+            /**
+             * Called for every threat.
+             * @note The scans classified by a capture_worker are skipped, the
+             * worker correlates each of their segments itself.
+             * @param val The threat.
+             */
+            void on_threat(const threat & val);
+        
+            /**
+             * Called for every probe of a source.
+             * @param protocol The protocol.
+             * @param addr The source address.
+             * @param destination The destination address.
+             * @param port The destination port.
+             * @param time The time the probe was received (or recorded).
+             */
+            void on_probe(
+                const threat::protocol_t & protocol,
+                const asio::ip::address & addr,
+                const asio::ip::address & destination,
+                const std::uint16_t & port,
+                const std::chrono::system_clock::time_point & time
+            );
+        
+            /**
+             * Called once per second (or for every threat of a replay),
+             * reports the single probes of sources that have gone quiet and
+             * frees their entries.
+             * @param time The current (or recorded) time.
+             */
+            void on_tick(const std::chrono::system_clock::time_point & time);
+        
+            /**
+             * The number of sources being tracked.
+             */
+            const std::size_t & sources() const;
+        
+            /**
+             * The number of sources evicted to make room.
+             */
+            const std::uint64_t & evictions() const;
+        
+            /**
+             * The memory used by the table in bytes.
+             */
+            std::size_t memory() const;
+        
+        private:
+        
+            /**
+             * The number of HyperLogLog registers for ports (4 bits each).
+             */
+            enum { port_registers = 32 };
+        
+            /**
+             * The number of HyperLogLog registers for hosts (4 bits each).
+             */
+            enum { host_registers = 16 };
+        
+            /**
+             * The number of entries probed for a source.
+             */
+            enum { probe_length = 8 };
+        
+            /**
+             * The per source state, a half window each for the previous and
+             * current half.
+             */
+            typedef struct source_s
+            {
+                std::uint64_t key;
+                std::uint8_t address[16];
+                std::uint32_t half;
+                std::uint32_t time_first;
+                std::uint32_t time_last;
+                std::uint32_t events[2];
+                std::uint32_t half_reported;
+                std::uint16_t port;
+                std::uint8_t protocol;
+                std::uint8_t scan_type;
+                std::uint8_t ports[2][port_registers / 2];
+                std::uint8_t hosts[2][host_registers / 2];
+            } source_t;
+        
+            /**
+             * The seconds since the first time seen.
+             * @param time The time.
+             */
+            std::uint32_t now(
+                const std::chrono::system_clock::time_point & time
+            );
+        
+            /**
+             * Reports a source.
+             * @param source The source.
+             * @param type The scan type.
+             * @param time The seconds since the first time seen.
+             */
+            void report(
+                source_t & source, const threat::scan_type_t & type,
+                const std::uint32_t & time
+            );
+        
+            /**
+             * The correlated threat handler.
+             */
+            std::function<void (threat &)> m_on_threat;
+        
+            /**
+             * The sources.
+             */
+            std::vector<source_t> m_sources;
+        
+            /**
+             * The half window in seconds.
+             */
+            std::uint32_t m_half_window;
+        
+            /**
+             * The first time seen, every time is relative to it.
+             */
+            std::chrono::system_clock::time_point m_time_start;
+        
+            /**
+             * The time of the last tick.
+             */
+            std::uint32_t m_time_tick;
+        
+            /**
+             * The next entry checked by on_tick.
+             */
+            std::size_t m_expire_position;
+        
+            /**
+             * The number of sources being tracked.
+             */
+            std::size_t m_source_count;
+        
+            /**
+             * The number of sources evicted.
+             */
+            std::uint64_t m_evictions;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
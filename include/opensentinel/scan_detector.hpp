@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/threat.hpp>
+
+namespace opensentinel {
+
+    class tcp_view;
+    
+    /**
+     * Implements a half-open (SYN), FIN, NULL and XMAS scan detector that
+     * classifies raw TCP segments per source without accepting connections.
+     * @note This class is not thread safe, each capture thread should own
+     * it's own instance.
+     */
+    class scan_detector
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            explicit scan_detector();
+        
+            /**
+             * Sets the scan handler.
+             * @param f The std::function.
+             */
+            void set_on_scan(const std::function<void (const threat &)> & f);
+        
+            /**
+             * Classifies the TCP flags of a single segment.
+             * @param flags The flags.
+             */
+            static threat::scan_type_t classify(const std::uint8_t & flags);
+        
+            /**
+             * Called for every TCP segment received.
+             * @param addr The source address.
+             * @param destination The destination address.
+             * @param hdr The tcp_view.
+             * @param monitored If true the destination port is monitored.
+             * @param now The time the segment was received (or recorded).
+             * @return The scan type, scan_type_none if the segment is not a
+             * probe. Every probe is returned even when it's threat is not
+             * reported again within the window.
+             */
+            threat::scan_type_t on_tcp_segment(
+                const asio::ip::address & addr,
+                const asio::ip::address & destination, const tcp_view & hdr,
+                const bool & monitored,
+                const std::chrono::system_clock::time_point & now
+            );
+        
+            /**
+             * The number of sources being tracked.
+             */
+            std::size_t sources() const;
+        
+        private:
+        
+            /**
+             * The source key (ipv4 addresses are v4-mapped).
+             */
+            typedef std::array<std::uint8_t, 16> key_t;
+        
+            /**
+             * Hashes a key_t.
+             */
+            struct key_hash
+            {
+                std::size_t operator () (const key_t & val) const
+                {
+                    /**
+                     * FNV-1a
+                     */
+                    std::uint64_t ret = 14695981039346656037ULL;
+                    
+                    for (auto & i : val)
+                    {
+                        ret = (ret ^ i) * 1099511628211ULL;
+                    }
+                    
+                    return static_cast<std::size_t> (ret);
+                }
+            };
+        
+            /**
+             * The per source state.
+             */
+            typedef struct source_s
+            {
+                std::chrono::system_clock::time_point time_last_seen;
+                std::uint32_t probes[5];
+                std::chrono::system_clock::time_point time_reported[5];
+                std::uint64_t ports;
+            } source_t;
+        
+            /**
+             * Erases sources that have not been seen within the window.
+             * @param now The current time.
+             */
+            void prune(const std::chrono::system_clock::time_point & now);
+        
+            /**
+             * The scan handler.
+             */
+            std::function<void (const threat &)> m_on_scan;
+        
+            /**
+             * The sources.
+             */
+            std::unordered_map<key_t, source_t, key_hash> m_sources;
+        
+            /**
+             * The time of the last prune.
+             */
+            std::chrono::system_clock::time_point m_time_last_prune;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
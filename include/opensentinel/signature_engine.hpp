@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opensentinel/literal_prefilter.hpp>
+#include <opensentinel/regex_dfa.hpp>
+#include <opensentinel/threat.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements a multi-pattern signature engine, the byte patterns are
+     * compiled once into an Aho-Corasick automaton and every payload is
+     * matched in a single pass regardless of the number of signatures.
+     * @note The shallow states of the automaton (where nearly every byte
+     * of a payload is spent) are dense transition rows over byte classes
+     * (bytes that occur in no pattern share a class) so each byte costs one
+     * table lookup. The deep states only keep their trie edges and a
+     * failure link, so memory grows with the total length of the patterns
+     * rather than the states times the classes. A literal_prefilter skips the payload up to the first
+     * candidate anchor, most payloads match nothing and are rejected
+     * without walking the automaton at all. The match functions are const
+     * and may be called from any thread once compiled.
+     */
+    class signature_engine
+    {
+        public:
+        
+            /**
+             * A signature.
+             */
+            typedef struct signature_s
+            {
+                std::uint32_t id;
+                threat::level_t level;
+                std::string pattern;
+            } signature_t;
+        
+            /**
+             * Constructor
+             */
+            explicit signature_engine();
+        
+            /**
+             * Loads and compiles the signatures of a file, one per line in
+             * the form "<id> <level> <pattern>" where the pattern is the rest
+             * of the line and may contain \xHH, \r, \n, \t and \\ escapes,
+             * or "<id> <level> regex:/<regex>/[i]" for a regex_dfa, empty
+             * lines and lines starting with # are skipped.
+             * @param path The path.
+             */
+            void load(const std::string & path);
+        
+            /**
+             * Adds a signature, compile must be called before matching.
+             * @param id The id.
+             * @param level The level of a threat matching the signature.
+             * @param pattern The (unescaped) pattern.
+             */
+            void add(
+                const std::uint32_t & id, const threat::level_t & level,
+                const std::string & pattern
+            );
+        
+            /**
+             * Adds and compiles a regex signature.
+             * @param id The id.
+             * @param level The level of a threat matching the signature.
+             * @param pattern The regex.
+             * @param case_insensitive If true letters match either case.
+             */
+            void add_regex(
+                const std::uint32_t & id, const threat::level_t & level,
+                const std::string & pattern, const bool & case_insensitive
+            );
+        
+            /**
+             * Compiles the signatures added into the automaton.
+             */
+            void compile();
+        
+            /**
+             * Matches a payload.
+             * @param buf The buffer.
+             * @param len The length.
+             * @param ids The ids of the signatures that matched (sorted and
+             * unique).
+             * @ret The highest level of the signatures that matched,
+             * level_0 if none did.
+             */
+            threat::level_t match(
+                const char * buf, const std::size_t & len,
+                std::vector<std::uint32_t> & ids
+            ) const;
+        
+            /**
+             * The number of (literal and regex) signatures compiled.
+             */
+            std::size_t size() const;
+        
+            /**
+             * The number of states of the automaton.
+             */
+            std::size_t states() const;
+        
+            /**
+             * The memory used by the automaton in bytes.
+             */
+            std::size_t memory() const;
+        
+            /**
+             * Unescapes a pattern.
+             * @param val The value.
+             */
+            static std::string unescape(const std::string & val);
+        
+        private:
+        
+            /**
+             * The depth up to which states have a dense transition row.
+             */
+            enum { dense_depth = 2 };
+        
+            /**
+             * The next state of the automaton.
+             * @param state The state.
+             * @param c The byte class.
+             */
+            std::uint32_t next_state(
+                std::uint32_t state, const std::uint8_t & c
+            ) const;
+        
+            /**
+             * The signatures.
+             */
+            std::vector<signature_t> m_signatures;
+        
+            /**
+             * The regex signatures (the pattern is the regex).
+             */
+            std::vector<signature_t> m_regex_signatures;
+        
+            /**
+             * The regex_dfa of each regex signature.
+             */
+            std::vector<regex_dfa> m_regexes;
+        
+            /**
+             * The class of each byte.
+             */
+            std::array<std::uint8_t, 256> m_classes;
+        
+            /**
+             * The number of byte classes.
+             */
+            std::uint32_t m_class_count;
+        
+            /**
+             * The number of dense states, they are numbered first (breadth
+             * first) so a state is dense if it is below this.
+             */
+            std::uint32_t m_dense_count;
+        
+            /**
+             * The transitions, m_class_count per dense state.
+             */
+            std::vector<std::uint32_t> m_transitions;
+        
+            /**
+             * The offset of each sparse state's edges into m_edge_classes
+             * and m_edge_states (one more than the number of sparse
+             * states).
+             */
+            std::vector<std::uint32_t> m_edge_offsets;
+        
+            /**
+             * The class of each edge, sorted per state.
+             */
+            std::vector<std::uint8_t> m_edge_classes;
+        
+            /**
+             * The state of each edge.
+             */
+            std::vector<std::uint32_t> m_edge_states;
+        
+            /**
+             * The failure link of each sparse state.
+             */
+            std::vector<std::uint32_t> m_failures;
+        
+            /**
+             * The offset of each state's outputs into m_outputs (one more
+             * than the number of states).
+             */
+            std::vector<std::uint32_t> m_output_offsets;
+        
+            /**
+             * The outputs (signature indexes) of every state, including
+             * those reached through it's failure links.
+             */
+            std::vector<std::uint32_t> m_outputs;
+        
+        protected:
+        
+            /**
+             * The literal_prefilter.
+             */
+            literal_prefilter literal_prefilter_;
+    };
+
+} // namespace opensentinel
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace opensentinel {
+
+    class configuration;
+    
+    /**
+     * Implements a classic BPF program compiled from the monitored port set
+     * and the allow-listed sources. Once attached with SO_ATTACH_FILTER the
+     * kernel drops the traffic we would ignore anyway so it never wakes up
+     * the reactor.
+     * @note All loads are relative to the network header (SKF_NET_OFF) so a
+     * single program works on raw, datagram and packet sockets alike.
+     */
+    class socket_filter
+    {
+        public:
+        
+            /**
+             * The types.
+             */
+            typedef enum type_s
+            {
+                type_none,
+                type_icmp,
+                type_udp,
+                type_capture,
+            } type_t;
+        
+            /**
+             * A single instruction (struct sock_filter).
+             */
+            typedef struct instruction_s
+            {
+                std::uint16_t code;
+                std::uint8_t jt;
+                std::uint8_t jf;
+                std::uint32_t k;
+            } instruction_t;
+        
+            /**
+             * Constructor
+             */
+            explicit socket_filter();
+        
+            /**
+             * Compiles the program.
+             * @param config The configuration.
+             * @param type The type_t.
+             */
+            void compile(const configuration & config, const type_t & type);
+        
+            /**
+             * Attaches the program to a socket.
+             * @param socket The (native) socket.
+             * @param ec The std::error_code.
+             */
+            void attach(const int & socket, std::error_code & ec) const;
+        
+            /**
+             * Sets ICMP_FILTER on a raw ICMP socket so only the given types
+             * are queued to it, this runs before the program is attached.
+             * @param socket The (native) socket.
+             * @param types The ICMP types to receive.
+             * @param ec The std::error_code.
+             */
+            static void attach_icmp_types(
+                const int & socket, const std::vector<std::uint8_t> & types,
+                std::error_code & ec
+            );
+        
+            /**
+             * Sets ICMP6_FILTER on a raw ICMPv6 socket so only the given
+             * types are queued to it.
+             * @param socket The (native) socket.
+             * @param types The ICMPv6 types to receive.
+             * @param ec The std::error_code.
+             */
+            static void attach_icmpv6_types(
+                const int & socket, const std::vector<std::uint8_t> & types,
+                std::error_code & ec
+            );
+        
+            /**
+             * The type_t.
+             */
+            const type_t & type() const;
+        
+            /**
+             * The instructions.
+             */
+            const std::vector<instruction_t> & instructions() const;
+        
+        private:
+        
+            /**
+             * A label, resolved to an instruction index by resolve.
+             */
+            typedef std::size_t label_t;
+        
+            /**
+             * Allocates a new (unbound) label.
+             */
+            label_t new_label();
+        
+            /**
+             * Binds the label to the next instruction.
+             * @param label The label_t.
+             */
+            void bind(const label_t & label);
+        
+            /**
+             * Emits a non-jump instruction.
+             * @param code The code.
+             * @param k The k.
+             */
+            void emit(const std::uint16_t & code, const std::uint32_t & k);
+        
+            /**
+             * Emits a conditional jump instruction.
+             * @param code The code.
+             * @param k The k.
+             * @param jt The label to jump to if true.
+             * @param jf The label to jump to if false.
+             */
+            void emit_jump(
+                const std::uint16_t & code, const std::uint32_t & k,
+                const label_t & jt, const label_t & jf
+            );
+        
+            /**
+             * Emits an unconditional jump, unlike a conditional jump it
+             * reaches any instruction ahead.
+             * @param label The label to jump to.
+             */
+            void emit_long_jump(const label_t & label);
+        
+            /**
+             * Emits the allow-list check for the ipv4 source address, a
+             * matching packet is dropped.
+             * @param config The configuration.
+             */
+            void emit_allowed_ipv4(const configuration & config);
+        
+            /**
+             * Emits the allow-list check for the ipv6 source address, a
+             * matching packet is dropped.
+             * @param config The configuration.
+             */
+            void emit_allowed_ipv6(const configuration & config);
+        
+            /**
+             * Emits the TCP scan probe check, expects the flags in A.
+             * @param config The configuration.
+             * @param port_offset The offset of the destination port.
+             * @param indirect If true the offset is relative to X.
+             * @param accept The accept label.
+             * @param drop The drop label.
+             */
+            void emit_scan_probe(
+                const configuration & config, const std::uint32_t & port_offset,
+                const bool & indirect, const label_t & accept,
+                const label_t & drop
+            );
+        
+            /**
+             * Emits the monitored port check, expects the port in A.
+             * @param config The configuration.
+             * @param accept The accept label.
+             */
+            void emit_monitored_port(
+                const configuration & config, const label_t & accept
+            );
+        
+            /**
+             * Resolves the labels to jump offsets.
+             */
+            void resolve();
+        
+            /**
+             * The type_t.
+             */
+            type_t m_type;
+        
+            /**
+             * The instructions.
+             */
+            std::vector<instruction_t> m_instructions;
+        
+            /**
+             * The instruction index of each label.
+             */
+            std::vector<std::size_t> m_labels;
+        
+            /**
+             * The pending jumps (instruction index, jt label, jf label).
+             */
+            std::vector< std::pair<std::size_t, std::pair<label_t, label_t> > >
+                m_jumps
+            ;
+        
+            /**
+             * The pending unconditional jumps (instruction index, label).
+             */
+            std::vector< std::pair<std::size_t, label_t> > m_long_jumps;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace opensentinel
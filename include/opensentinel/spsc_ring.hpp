@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace opensentinel {
+
+    /**
+     * Implements a bounded lock-free single producer, single consumer ring
+     * connecting two pipeline stages.
+     */
+    template <typename T>
+    class spsc_ring
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param size The number of cells, must be a power of two.
+             */
+            explicit spsc_ring(const std::size_t & size)
+                : m_cells(size)
+                , m_mask(size - 1)
+                , m_head(0)
+                , m_tail(0)
+            {
+                if (size < 2 || (size & (size - 1)) != 0)
+                {
+                    throw std::runtime_error("size must be a power of two");
+                }
+            }
+        
+            /**
+             * Destructor
+             */
+            ~spsc_ring()
+            {
+                consume([](T &) {}, capacity());
+            }
+        
+            /**
+             * Pushes a value, called by the single producer only.
+             * @param val The value (not moved from if the ring is full).
+             * @return False if the ring is full.
+             */
+            template <typename U>
+            bool try_push(U && val)
+            {
+                auto tail = m_tail.load(std::memory_order_relaxed);
+                
+                if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+                {
+                    return false;
+                }
+                
+                new (&m_cells[tail & m_mask]) T(std::forward<U> (val));
+                
+                m_tail.store(tail + 1, std::memory_order_release);
+                
+                return true;
+            }
+        
+            /**
+             * Pops up to max values handing each to f, called by the single
+             * consumer only.
+             * @param f The function (which must not throw).
+             * @param max The maximum number of values.
+             * @return The number of values popped.
+             */
+            template <typename F>
+            std::size_t consume(F && f, const std::size_t & max)
+            {
+                std::size_t ret = 0;
+                
+                auto head = m_head.load(std::memory_order_relaxed);
+                auto tail = m_tail.load(std::memory_order_acquire);
+                
+                while (ret < max && head != tail)
+                {
+                    auto ptr = reinterpret_cast<T *> (&m_cells[head & m_mask]);
+                    
+                    f(*ptr);
+                    
+                    ptr->~T();
+                    
+                    m_head.store(++head, std::memory_order_release);
+                    
+                    ret++;
+                }
+                
+                return ret;
+            }
+        
+            /**
+             * The (approximate) number of values in the ring.
+             */
+            std::size_t size() const
+            {
+                return
+                    m_tail.load(std::memory_order_relaxed) -
+                    m_head.load(std::memory_order_relaxed)
+                ;
+            }
+        
+            /**
+             * The number of cells.
+             */
+            std::size_t capacity() const
+            {
+                return m_mask + 1;
+            }
+        
+        private:
+        
+            /**
+             * The cells.
+             */
+            std::vector<
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type
+            > m_cells;
+        
+            /**
+             * The mask.
+             */
+            std::size_t m_mask;
+        
+            /**
+             * The position the consumer pops from.
+             */
+            alignas(64) std::atomic<std::size_t> m_head;
+        
+            /**
+             * The position the producer pushes to.
+             */
+            alignas(64) std::atomic<std::size_t> m_tail;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace opensentinel
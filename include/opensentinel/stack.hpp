@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include <map>
+#include <string>
+
 namespace opensentinel {
 
     class stack_impl;
@@ -35,13 +38,23 @@ namespace opensentinel {
         
             /**
              * Starts
+             * @param args The arguments.
              */
-            void start();
+            void start(
+                const std::map<std::string, std::string> & args =
+                std::map<std::string, std::string> ()
+            );
         
             /**
              * Stops
              */
             void stop();
+        
+            /**
+             * Replays the configured (--replay) capture file through the
+             * detection pipeline, blocks until it has been drained.
+             */
+            void replay();
             
         private:
         
@@ -21,20 +21,29 @@
 #pragma once
 
 #include <chrono>
+#include <map>
+#include <memory>
+#include <string>
 #include <thread>
 
 #define ASIO_STANDALONE 1
 
 #include <asio.hpp>
 
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/io_service_pool.hpp>
+
 namespace opensentinel {
 
     class alert_manager;
+    class capture_manager;
+    class evidence_writer;
     class icmp_manager;
     class tcp_manager;
     class threat;
     class threat_manager;
     class udp_manager;
+    class uring_manager;
     
     class stack_impl
     {
@@ -47,14 +56,21 @@ namespace opensentinel {
         
             /**
              * Starts
+             * @param args The arguments.
              */
-            void start();
+            void start(const std::map<std::string, std::string> & args);
         
             /**
              * Stops
              */
             void stop();
         
+            /**
+             * Replays the configured capture file, blocks until it has been
+             * drained.
+             */
+            void replay();
+        
             /**
              * Called when a possible threat is detected.
              * @param threat_data The threat.
@@ -66,12 +82,17 @@ namespace opensentinel {
              */
             std::shared_ptr<alert_manager> & get_alert_manager();
         
-        private:
+            /**
+             * The evidence_writer.
+             */
+            std::shared_ptr<evidence_writer> & get_evidence_writer();
         
             /**
-             * The network timer handler.
+             * The configuration.
              */
-            void on_tick_network();
+            const configuration & get_configuration() const;
+        
+        private:
         
             /**
              * The network thread loop.
@@ -93,6 +114,11 @@ namespace opensentinel {
              */
             std::shared_ptr<alert_manager> m_alert_manager;
         
+            /**
+             * The evidence_writer.
+             */
+            std::shared_ptr<evidence_writer> m_evidence_writer;
+        
             /**
              * The icmp_manager.
              */
@@ -103,6 +129,21 @@ namespace opensentinel {
              */
             std::shared_ptr<udp_manager> m_udp_manager;
         
+            /**
+             * The capture_manager.
+             */
+            std::shared_ptr<capture_manager> m_capture_manager;
+        
+            /**
+             * The uring_manager.
+             */
+            std::shared_ptr<uring_manager> m_uring_manager;
+        
+            /**
+             * The configuration.
+             */
+            configuration m_configuration;
+        
         protected:
         
             /**
@@ -136,12 +177,17 @@ namespace opensentinel {
              * The network std::thread.
              */
             std::thread thread_network_;
+        
+            /**
+             * The network io_service_pool the per port sockets are spread
+             * across (when there is more than one network thread).
+             */
+            io_service_pool io_service_pool_network_;
    
             /**
-             * The network timer.
+             * The asio::io_service::work keeping the network std::thread
+             * alive.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > timer_network_;
+            std::shared_ptr<asio::io_service::work> work_network_;
     };
 } // namespace opensentinel
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+namespace opensentinel {
+
+    /**
+     * Implements the wakeup of a pipeline stage's thread when the ring
+     * feeding it goes from empty to not empty.
+     * @note On Linux the producers write an eventfd the stage's
+     * asio::io_service waits on, elsewhere a single handler is posted.
+     */
+    class stage_signal
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param ios The asio::io_service.
+             * @param s The asio::strand.
+             */
+            explicit stage_signal(asio::io_service & ios, asio::strand & s);
+        
+            /**
+             * Starts
+             * @param f The function called on the strand when signalled.
+             */
+            void start(const std::function<void ()> & f);
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+            /**
+             * Called by a producer after a push, only the first producer
+             * since the last clear signals.
+             */
+            void notify();
+        
+            /**
+             * Called by the consumer before it drains the ring.
+             */
+            void clear();
+        
+        private:
+        
+#if (defined __linux__)
+            /**
+             * Starts an asynchronous wait for the eventfd to become
+             * readable.
+             */
+            void async_wait();
+#endif // __linux__
+        
+            /**
+             * The function called when signalled.
+             */
+            std::function<void ()> m_on_signal;
+        
+        protected:
+        
+            /**
+             * The asio::io_service.
+             */
+            asio::io_service & io_service_;
+        
+            /**
+             * The asio::strand.
+             */
+            asio::strand & strand_;
+        
+            /**
+             * If true a wakeup is pending and producers need not signal.
+             */
+            std::atomic<bool> pending_;
+        
+#if (defined __linux__)
+            /**
+             * The eventfd the producers signal.
+             */
+            asio::posix::stream_descriptor eventfd_;
+#endif // __linux__
+    };
+    
+} // namespace opensentinel
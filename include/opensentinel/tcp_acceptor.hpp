@@ -29,6 +29,8 @@
 
 #include <asio.hpp>
 
+#include <opensentinel/timing_wheel.hpp>
+
 namespace opensentinel {
 
     class tcp_transport;
@@ -53,6 +55,30 @@ namespace opensentinel {
              */
             std::error_code open(const std::uint16_t & port);
         
+            /**
+             * If set to true (before open) the acceptor is opened with
+             * IP_TRANSPARENT so it accepts connections redirected to it by a
+             * TPROXY rule for any address and port.
+             * @param val The value.
+             */
+            void set_transparent(const bool & val);
+        
+            /**
+             * If set to true (before open) the acceptor is opened with
+             * SO_REUSEPORT so several acceptors (one per thread) can share
+             * the port and the kernel spreads the connections between them.
+             * @param val The value.
+             */
+            void set_reuse_port(const bool & val);
+        
+            /**
+             * If set to true (before open) a single ipv6 acceptor with
+             * IPV6_V6ONLY disabled accepts both ipv4 (as v4-mapped) and ipv6
+             * connections.
+             * @param val The value.
+             */
+            void set_dual_stack(const bool & val);
+        
             /**
              * Closes the acceptor.
              */
@@ -71,6 +97,16 @@ namespace opensentinel {
              */
             const asio::ip::tcp::endpoint local_endpoint() const;
         
+            /**
+             * The original destination of an accepted connection, for
+             * connections redirected by NAT this is SO_ORIGINAL_DST, for
+             * TPROXY and direct connections the local endpoint.
+             * @param s The socket.
+             */
+            static asio::ip::tcp::endpoint original_destination(
+                asio::ip::tcp::socket & s
+            );
+        
             /**
              * Runs the test case.
              * @param ios The asio::io_service.
@@ -104,6 +140,21 @@ namespace opensentinel {
              */
             std::vector< std::weak_ptr<tcp_transport> > m_tcp_transports;
         
+            /**
+             * If true IP_TRANSPARENT is set on the acceptors.
+             */
+            bool m_transparent;
+        
+            /**
+             * If true SO_REUSEPORT is set on the acceptors.
+             */
+            bool m_reuse_port;
+        
+            /**
+             * If true only the (dual-stack) ipv6 acceptor is opened.
+             */
+            bool m_dual_stack;
+        
         protected:
 
             /**
@@ -141,9 +192,7 @@ namespace opensentinel {
             /**
              * The transports timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > transports_timer_;
+            wheel_timer transports_timer_;
     };
 
 } // namespace opensentinel
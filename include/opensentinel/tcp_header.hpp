@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+
+namespace opensentinel {
+
+    class tcp_header
+    {
+        public:
+        
+            /**
+             * The flags.
+             */
+            typedef enum flag_s
+            {
+                flag_fin = 0x01,
+                flag_syn = 0x02,
+                flag_rst = 0x04,
+                flag_psh = 0x08,
+                flag_ack = 0x10,
+                flag_urg = 0x20,
+                flag_ece = 0x40,
+                flag_cwr = 0x80,
+            } flag_t;
+        
+            /**
+             * Constructor
+             */
+            tcp_header()
+            {
+                std::fill(data_, data_ + sizeof(data_), 0);
+            }
+        
+            /**
+             * The source port.
+             */
+            std::uint16_t source_port() const
+            {
+                return decode(0, 1);
+            }
+        
+            /**
+             * The destination port.
+             */
+            std::uint16_t destination_port() const
+            {
+                return decode(2, 3);
+            }
+        
+            /**
+             * The sequence number.
+             */
+            std::uint32_t sequence_number() const
+            {
+                return (decode(4, 5) << 16) + decode(6, 7);
+            }
+        
+            /**
+             * The acknowledgement number.
+             */
+            std::uint32_t acknowledgement_number() const
+            {
+                return (decode(8, 9) << 16) + decode(10, 11);
+            }
+        
+            /**
+             * The header length.
+             */
+            std::uint16_t header_length() const
+            {
+                return (data_[12] >> 4) * 4;
+            }
+        
+            /**
+             * The flags.
+             */
+            std::uint8_t flags() const
+            {
+                return data_[13];
+            }
+        
+            /**
+             * The window.
+             */
+            std::uint16_t window() const
+            {
+                return decode(14, 15);
+            }
+        
+            /**
+             * The checksum.
+             */
+            std::uint16_t checksum() const
+            {
+                return decode(16, 17);
+            }
+        
+            /**
+             * The urgent pointer.
+             */
+            std::uint16_t urgent_pointer() const
+            {
+                return decode(18, 19);
+            }
+        
+            /**
+             * operator >>
+             */
+            friend std::istream & operator >> (
+                std::istream & is, tcp_header & header
+                )
+            {
+                is.read(reinterpret_cast<char *>(header.data_), 20);
+                
+                std::streamsize options_length = header.header_length() - 20;
+                
+                if (options_length < 0 || options_length > 40)
+                {
+                    is.setstate(std::ios::failbit);
+                }
+                else
+                {
+                    is.read(
+                        reinterpret_cast<char *>(header.data_) + 20,
+                        options_length
+                    );
+                }
+                
+                return is;
+            }
+        
+        private:
+        
+            /**
+             * Decodes
+             * @param a The a.
+             * @param b The b.
+             */
+            std::uint32_t decode(
+                const std::int32_t & a, const std::int32_t & b
+                ) const
+            {
+                return (data_[a] << 8) + data_[b];
+            }
+        
+        protected:
+        
+            /**
+             * The data.
+             */
+            std::uint8_t data_[60];
+    };
+
+} // namespace opensentinel
@@ -28,6 +28,9 @@
 
 #include <asio.hpp>
 
+#include <opensentinel/io_service_pool.hpp>
+#include <opensentinel/timing_wheel.hpp>
+
 namespace opensentinel {
 
     class stack_impl;
@@ -42,9 +45,11 @@ namespace opensentinel {
              * @param owner The stack_impl.
              * @param ios The asio::io_service.
              * @param s The asio::strand.
+             * @param pool The io_service_pool the sockets are spread across.
              */
             explicit tcp_manager(
-                stack_impl & owner, asio::io_service & ios, asio::strand & s
+                stack_impl & owner, asio::io_service & ios, asio::strand & s,
+                io_service_pool & pool
             );
         
             /**
@@ -68,9 +73,11 @@ namespace opensentinel {
              * Opens tcp_acceptor objects.
              * @param port_begin The port to start at.
              * @param port_end The port to end at.
+             * @param transparent If true the acceptors are transparent.
              */
             void open_tcp_acceptors(
-                const std::uint16_t & port_begin, const std::uint16_t & port_end
+                const std::uint16_t & port_begin,
+                const std::uint16_t & port_end, const bool & transparent
             );
         
             /**
@@ -110,14 +117,18 @@ namespace opensentinel {
             /**
              * The timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > timer_;
+            wheel_timer timer_;
         
             /**
              * The tcp_acceptor object's
              */
             std::vector< std::weak_ptr<tcp_acceptor> > tcp_acceptors_;
+        
+            /**
+             * The io_service_pool the tcp_acceptor objects are sharded
+             * across.
+             */
+            io_service_pool & io_service_pool_;
     };
 
 } // namespace opensentinel
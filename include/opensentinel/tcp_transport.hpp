@@ -31,6 +31,8 @@
 
 #include <asio.hpp>
 
+#include <opensentinel/timing_wheel.hpp>
+
 #if (defined USE_TOKEN_BUCKET && USE_TOKEN_BUCKET)
 #include <opensentinel/token_bucket.hpp>
 #endif // USE_TOKEN_BUCKET
@@ -324,30 +326,22 @@ namespace opensentinel {
             /**
              * The timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > timer_;
+            wheel_timer timer_;
         
             /**
              * The connect timeout timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > connect_timeout_timer_;
+            wheel_timer connect_timeout_timer_;
         
             /**
              * The read timeout timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > read_timeout_timer_;
+            wheel_timer read_timeout_timer_;
         
             /**
              * The write timeout timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > write_timeout_timer_;
+            wheel_timer write_timeout_timer_;
         
             /**
              * The write queue.
@@ -373,16 +367,12 @@ namespace opensentinel {
             /**
              * The read retry timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > read_retry_timer_;
+            wheel_timer read_retry_timer_;
         
             /**
              * The write retry timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > write_retry_timer_;
+            wheel_timer write_retry_timer_;
 #endif // USE_TOKEN_BUCKET
     };
     
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -58,9 +59,26 @@ namespace opensentinel {
                 level_5
             } level_t;
         
+            /**
+             * The scan types.
+             */
+            typedef enum scan_type_s
+            {
+                scan_type_none,
+                scan_type_tcp_syn,
+                scan_type_tcp_fin,
+                scan_type_tcp_null,
+                scan_type_tcp_xmas,
+                scan_type_vertical,
+                scan_type_sweep,
+                scan_type_probe,
+                scan_type_flood,
+            } scan_type_t;
+        
             /**
              * Constructor
-             * @param addr The address.
+             * @param addr The address (v4-mapped addresses are stored as
+             * ipv4).
              * @param port The port.
              * @param buf The buffer.
              * @param len The length.
@@ -81,6 +99,28 @@ namespace opensentinel {
              */
             const std::uint16_t & port() const;
         
+            /**
+             * Sets the destination port.
+             * @param val The value.
+             */
+            void set_destination_port(const std::uint16_t & val);
+        
+            /**
+             * The destination port (zero if unknown).
+             */
+            const std::uint16_t & destination_port() const;
+        
+            /**
+             * Sets the destination address.
+             * @param val The value.
+             */
+            void set_destination_address(const asio::ip::address & val);
+        
+            /**
+             * The destination address (unspecified if unknown).
+             */
+            const asio::ip::address & destination_address() const;
+        
             /**
              * The buffer.
              */
@@ -91,6 +131,32 @@ namespace opensentinel {
              */
             const std::vector<char> & buffer() const;
         
+            /**
+             * Sets the raw (ip) packet that triggered the threat.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void set_packet(const std::uint8_t * buf, const std::size_t & len);
+        
+            /**
+             * The raw (ip) packet, empty if only the payload is known.
+             */
+            const std::vector<std::uint8_t> & packet() const;
+        
+            /**
+             * Sets the time the threat was detected (the recorded time of a
+             * replayed packet).
+             * @param val The value.
+             */
+            void set_timestamp(
+                const std::chrono::system_clock::time_point & val
+            );
+        
+            /**
+             * The time the threat was detected.
+             */
+            const std::chrono::system_clock::time_point & timestamp() const;
+        
             /**
              * Sets the level.
              * @param val The value.
@@ -117,6 +183,45 @@ namespace opensentinel {
              */
             const std::string protocol_string() const;
         
+            /**
+             * Sets the scan type.
+             * @param val The value.
+             */
+            void set_scan_type(const scan_type_t & val);
+        
+            /**
+             * The scan type.
+             */
+            const scan_type_t & scan_type() const;
+        
+            /**
+             * The scan type (string).
+             */
+            const std::string scan_type_string() const;
+        
+            /**
+             * Sets the rate.
+             * @param val The value.
+             */
+            void set_rate(const double & val);
+        
+            /**
+             * The rate (events per second) of a correlated scan or a
+             * summarized flood, zero otherwise.
+             */
+            const double & rate() const;
+        
+            /**
+             * Sets the ids of the signatures the buffer matched.
+             * @param val The value.
+             */
+            void set_signatures(const std::vector<std::uint32_t> & val);
+        
+            /**
+             * The ids of the signatures the buffer matched.
+             */
+            const std::vector<std::uint32_t> & signatures() const;
+        
             /**
              * Prints
              */
@@ -134,11 +239,31 @@ namespace opensentinel {
              */
             std::uint16_t m_port = 0;
         
+            /**
+             * The destination port.
+             */
+            std::uint16_t m_destination_port = 0;
+        
+            /**
+             * The destination address.
+             */
+            asio::ip::address m_destination_address;
+        
             /**
              * The buffer.
              */
             std::vector<char> m_buffer;
         
+            /**
+             * The raw (ip) packet.
+             */
+            std::vector<std::uint8_t> m_packet;
+        
+            /**
+             * The time the threat was detected.
+             */
+            std::chrono::system_clock::time_point m_timestamp;
+        
             /**
              * The level.
              */
@@ -149,6 +274,21 @@ namespace opensentinel {
              */
             protocol_t m_protocol = protocol_none;
         
+            /**
+             * The scan type.
+             */
+            scan_type_t m_scan_type = scan_type_none;
+        
+            /**
+             * The rate.
+             */
+            double m_rate = 0.0;
+        
+            /**
+             * The ids of the signatures the buffer matched.
+             */
+            std::vector<std::uint32_t> m_signatures;
+        
         protected:
         
             // ...
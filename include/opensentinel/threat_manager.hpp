@@ -21,16 +21,24 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <thread>
 
 #define ASIO_STANDALONE 1
 
 #include <asio.hpp>
 
+#include <opensentinel/backpressure.hpp>
+#include <opensentinel/heavy_hitters.hpp>
+#include <opensentinel/mpsc_ring.hpp>
+#include <opensentinel/scan_correlator.hpp>
+#include <opensentinel/signature_engine.hpp>
+#include <opensentinel/stage_signal.hpp>
+#include <opensentinel/threat.hpp>
+
 namespace opensentinel {
 
     class stack_impl;
-    class threat;
     
     class threat_manager
     {
@@ -53,13 +61,44 @@ namespace opensentinel {
             void stop();
         
             /**
-             * Called when a (possible) threat is detected.
+             * Called when a (possible) threat is detected, from any thread.
              * @param threat_data The threat.
+             * @note The threat is queued on a lock-free ring and the threat
+             * thread is only woken when the ring goes from empty to not
+             * empty, if the ring is full the backpressure policy applies.
              */
             void on_threat(const threat & threat_data);
+        
+            /**
+             * Blocks until every threat handed over before the call has been
+             * checked.
+             */
+            void flush();
+        
+            /**
+             * The (approximate) number of threats waiting to be checked.
+             */
+            std::size_t queue_depth() const;
+        
+            /**
+             * The number of threats dropped because the queue was full.
+             */
+            std::uint64_t threats_dropped() const;
             
         private:
         
+            /**
+             * Drains up to max_batch_size threats from the queue.
+             */
+            void drain();
+        
+            /**
+             * Checks a threat and hands it to the evidence_writer and the
+             * alert_manager.
+             * @param val The threat.
+             */
+            void handle_threat(threat & val);
+        
             /**
              * The timer handler.
              */
@@ -70,14 +109,46 @@ namespace opensentinel {
              */
             void run();
         
+            /**
+             * Loads the signatures from the configured signature file or the
+             * built-in ones.
+             */
+            void load_signatures();
+        
             /**
              * Checks the threat and set's it's level.
              * @param val The threat.
              */
             bool check_threat(threat & val);
+        
+            /**
+             * The number of threats dropped when last logged.
+             */
+            std::uint64_t m_threats_dropped_logged;
+        
+            /**
+             * If true the threats are replayed and their (recorded)
+             * timestamps drive the scan_correlator and heavy_hitters.
+             */
+            bool m_replay;
+        
+            /**
+             * The ids of the signatures matched by the last threat checked.
+             */
+            std::vector<std::uint32_t> m_signature_ids;
             
         protected:
         
+            /**
+             * The number of threats the queue holds.
+             */
+            enum { queue_size = 8192 };
+        
+            /**
+             * The maximum number of threats checked per drain.
+             */
+            enum { max_batch_size = 256 };
+        
             /**
              * The state.
              */
@@ -116,6 +187,36 @@ namespace opensentinel {
             asio::basic_waitable_timer<
                 std::chrono::steady_clock
             > timer_;
+        
+            /**
+             * The queue of threats waiting to be checked.
+             */
+            mpsc_ring<threat> queue_;
+        
+            /**
+             * The backpressure applied when the queue is full.
+             */
+            backpressure backpressure_;
+        
+            /**
+             * The stage_signal waking the thread.
+             */
+            stage_signal stage_signal_;
+        
+            /**
+             * The signature_engine.
+             */
+            signature_engine signature_engine_;
+        
+            /**
+             * The scan_correlator.
+             */
+            scan_correlator scan_correlator_;
+        
+            /**
+             * The heavy_hitters.
+             */
+            heavy_hitters heavy_hitters_;
     };
     
 } // namespace opensentinel
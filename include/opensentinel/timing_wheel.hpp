@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+namespace opensentinel {
+
+    class wheel_timer;
+    
+    /**
+     * Implements a hashed timing wheel, one per asio::io_service (it is
+     * an asio service), serving every wheel_timer of that asio::io_service
+     * from a single asio timer.
+     * @note Scheduling, cancelling and expiring a wheel_timer is O(1)
+     * regardless of the number of timers, expiry is rounded up to the
+     * resolution.
+     */
+    class timing_wheel : public asio::io_service::service
+    {
+        public:
+        
+            /**
+             * The asio::io_service::id.
+             */
+            static asio::io_service::id id;
+        
+            /**
+             * The number of slots.
+             */
+            enum { slot_count = 512 };
+        
+            /**
+             * The resolution (of a tick) in milliseconds.
+             */
+            enum { resolution = 100 };
+        
+            /**
+             * Constructor
+             * @param ios The asio::io_service.
+             */
+            explicit timing_wheel(asio::io_service & ios);
+        
+            /**
+             * The number of pending timers.
+             */
+            std::size_t size();
+        
+        private:
+        
+            friend class wheel_timer;
+        
+            /**
+             * Schedules a timer, the handler is queued behind any already
+             * pending (on the same expiry).
+             * @param t The wheel_timer.
+             * @param f The handler.
+             */
+            void schedule(
+                wheel_timer & t, const std::function<void (std::error_code)> & f
+            );
+        
+            /**
+             * Cancels a timer, the handlers are posted with
+             * asio::error::operation_aborted.
+             * @param t The wheel_timer.
+             * @ret The number of handlers cancelled.
+             */
+            std::size_t cancel(wheel_timer & t);
+        
+            /**
+             * Links a timer into a slot (mutex_ must be held).
+             * @param t The wheel_timer.
+             * @param slot The slot.
+             */
+            void link(wheel_timer & t, const std::size_t & slot);
+        
+            /**
+             * Unlinks a timer from it's slot (mutex_ must be held).
+             * @param t The wheel_timer.
+             */
+            void unlink(wheel_timer & t);
+        
+            /**
+             * Arms the asio timer for the next tick (mutex_ must be held).
+             */
+            void arm();
+        
+            /**
+             * The tick handler.
+             * @param ec The std::error_code.
+             */
+            void on_tick(const std::error_code & ec);
+        
+            /**
+             * Destroys the pending handlers when the asio::io_service is
+             * destroyed.
+             */
+            void shutdown_service();
+        
+            /**
+             * The slots, each the head of a list of timers.
+             */
+            std::vector<wheel_timer *> m_slots;
+        
+            /**
+             * The current tick.
+             */
+            std::uint64_t m_tick;
+        
+            /**
+             * The time of the current tick.
+             */
+            std::chrono::steady_clock::time_point m_time_tick;
+        
+            /**
+             * The number of pending timers.
+             */
+            std::size_t m_size;
+        
+            /**
+             * If true the asio timer is waiting.
+             */
+            bool m_armed;
+        
+            /**
+             * If true the asio::io_service is shutting down.
+             */
+            bool m_shutdown;
+        
+        protected:
+        
+            /**
+             * The asio::io_service.
+             */
+            asio::io_service & io_service_;
+        
+            /**
+             * The std::mutex.
+             */
+            std::mutex mutex_;
+        
+            /**
+             * The asio timer.
+             */
+            asio::basic_waitable_timer<std::chrono::steady_clock> timer_;
+    };
+    
+    /**
+     * Implements a timer driven by the timing_wheel of it's
+     * asio::io_service, used in place of an asio::basic_waitable_timer (with
+     * the same semantics) by objects that exist in large numbers.
+     */
+    class wheel_timer
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param ios The asio::io_service.
+             */
+            explicit wheel_timer(asio::io_service & ios);
+        
+            /**
+             * Destructor
+             */
+            ~wheel_timer();
+        
+            /**
+             * Sets the expiry time relative to now, cancelling any pending
+             * wait.
+             * @param val The value.
+             */
+            std::size_t expires_from_now(const std::chrono::milliseconds & val);
+        
+            /**
+             * Starts an asynchronous wait, the handler is posted with an
+             * empty std::error_code on expiry or with
+             * asio::error::operation_aborted when cancelled. A wait started
+             * while another is pending completes with it.
+             * @param f The handler.
+             */
+            void async_wait(const std::function<void (std::error_code)> & f);
+        
+            /**
+             * Cancels any pending wait.
+             * @ret The number of handlers cancelled.
+             */
+            std::size_t cancel();
+        
+        private:
+        
+            friend class timing_wheel;
+        
+            /**
+             * The expiry time relative to the wait.
+             */
+            std::chrono::milliseconds m_expires;
+        
+            /**
+             * The handlers.
+             */
+            std::vector< std::function<void (std::error_code)> > m_handlers;
+        
+            /**
+             * The previous timer in the slot.
+             */
+            wheel_timer * m_previous;
+        
+            /**
+             * The next timer in the slot.
+             */
+            wheel_timer * m_next;
+        
+            /**
+             * The slot.
+             */
+            std::size_t m_slot;
+        
+            /**
+             * The number of turns of the wheel left before expiry.
+             */
+            std::uint64_t m_rounds;
+        
+            /**
+             * If true the timer is linked into a slot.
+             */
+            bool m_pending;
+        
+        protected:
+        
+            /**
+             * The timing_wheel.
+             */
+            timing_wheel & timing_wheel_;
+    };
+
+} // namespace opensentinel
@@ -23,6 +23,8 @@
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #define ASIO_STANDALONE 1
 
@@ -30,6 +32,8 @@
 
 namespace opensentinel {
 
+    class socket_filter;
+    
     /**
      * Implements a UDP listener.
      */
@@ -37,6 +41,19 @@ namespace opensentinel {
     {
         public:
         
+            /**
+             * A datagram within a batch, the data points into the leased
+             * receive buffer and is only valid during the handler.
+             */
+            typedef struct datagram_s
+            {
+                asio::ip::udp::endpoint endpoint;
+                asio::ip::address destination_address;
+                std::uint16_t destination_port;
+                const char * data;
+                std::size_t length;
+            } datagram_t;
+        
             /**
              * Constructor
              * @param ios The asio::io_service.
@@ -75,15 +92,92 @@ namespace opensentinel {
                 const std::size_t &)> & f
             );
         
+            /**
+             * Set the asynchronous batch receive handler, if set (on Linux)
+             * up to the batch size datagrams are received per wakeup along
+             * with their destination.
+             * @note The handler is called synchronously, the datagrams are
+             * not copied out of the receive buffers.
+             * @param f The std::function.
+             */
+            void set_on_async_receive_batch(
+                const std::function<void (
+                const datagram_t *, const std::size_t &)> & f
+            );
+        
+            /**
+             * Sets the maximum number of datagrams received per wakeup.
+             * @param val The value.
+             */
+            void set_batch_size(const std::size_t & val);
+        
+            /**
+             * If set to true (before open) the sockets are opened with
+             * IP_TRANSPARENT so datagrams redirected by a TPROXY rule are
+             * received along with the port they were sent to.
+             * @param val The value.
+             */
+            void set_transparent(const bool & val);
+        
+            /**
+             * If set to true (before open) a single ipv6 socket with
+             * IPV6_V6ONLY disabled receives both ipv4 (as v4-mapped) and
+             * ipv6 datagrams.
+             * @param val The value.
+             */
+            void set_dual_stack(const bool & val);
+        
+            /**
+             * Sets the socket_filter attached by open.
+             * @param val The socket_filter.
+             */
+            void set_socket_filter(const std::shared_ptr<socket_filter> & val);
+        
         private:
         
             /**
-             * Handles an asynchronous receive from operation.
+             * Starts an asynchronous wait for the socket to become readable.
+             * @param s The socket.
+             */
+            void async_receive_from(asio::ip::udp::socket & s);
+        
+            /**
+             * Handles the socket becoming readable by receiving a datagram
+             * into a buffer leased from the buffer_pool.
              * @param ec The std::error_code.
-             * @param len The length of bytes received.
+             * @param s The socket.
              */
             void handle_async_receive_from(
-                const std::error_code & ec, const std::size_t & len
+                const std::error_code & ec, asio::ip::udp::socket & s
+            );
+        
+            /**
+             * Sets IP_TRANSPARENT on the socket.
+             * @param s The socket.
+             */
+            void set_transparent_options(asio::ip::udp::socket & s);
+        
+            /**
+             * Sets IP_RECVORIGDSTADDR on the socket so each datagram of a
+             * batch carries it's destination.
+             * @param s The socket.
+             */
+            void set_destination_options(asio::ip::udp::socket & s);
+        
+            /**
+             * Starts an asynchronous wait for the socket to become readable.
+             * @param s The socket.
+             */
+            void async_receive_batch(asio::ip::udp::socket & s);
+        
+            /**
+             * Handles the socket becoming readable by receiving a batch of
+             * datagrams.
+             * @param ec The std::error_code.
+             * @param s The socket.
+             */
+            void handle_async_receive_batch(
+                const std::error_code & ec, asio::ip::udp::socket & s
             );
         
             /**
@@ -100,6 +194,38 @@ namespace opensentinel {
                 const std::size_t &)
             > m_on_async_receive_from;
         
+            /**
+             * The asynchronous batch receive handler.
+             */
+            std::function<
+                void (const datagram_t *, const std::size_t &)
+            > m_on_async_receive_batch;
+        
+            /**
+             * The maximum number of datagrams received per wakeup.
+             */
+            std::size_t m_batch_size;
+        
+            /**
+             * If true the sockets are transparent.
+             */
+            bool m_transparent;
+        
+            /**
+             * If true only the (dual-stack) ipv6 socket is opened.
+             */
+            bool m_dual_stack;
+        
+            /**
+             * The port bound to.
+             */
+            std::uint16_t m_port;
+        
+            /**
+             * The socket_filter.
+             */
+            std::shared_ptr<socket_filter> m_socket_filter;
+        
         protected:
         
             /**
@@ -107,6 +233,11 @@ namespace opensentinel {
              */
             enum { max_length = 65535 };
         
+            /**
+             * The maximum batch size.
+             */
+            enum { max_batch_size = 32 };
+        
             /**
              * The asio::io_service::stand.
              */
@@ -121,16 +252,6 @@ namespace opensentinel {
              * The ipv6 socket.
              */
             asio::ip::udp::socket socket_ipv6_;
-            
-            /**
-             * The remote endpoint.
-             */
-            asio::ip::udp::endpoint remote_endpoint_;
-            
-            /**
-             * The receive buffer.
-             */
-            char receive_buffer_[max_length];;
     };
     
 } // namespace database
@@ -28,8 +28,12 @@
 
 #include <asio.hpp>
 
+#include <opensentinel/io_service_pool.hpp>
+#include <opensentinel/timing_wheel.hpp>
+
 namespace opensentinel {
 
+    class socket_filter;
     class stack_impl;
     class udp_listener;
     
@@ -42,9 +46,11 @@ namespace opensentinel {
              * @param owner The stack_impl.
              * @param ios The asio::io_service.
              * @param s The asio::strand.
+             * @param pool The io_service_pool the sockets are spread across.
              */
             explicit udp_manager(
-                stack_impl & owner, asio::io_service & ios, asio::strand & s
+                stack_impl & owner, asio::io_service & ios, asio::strand & s,
+                io_service_pool & pool
             );
         
             /**
@@ -72,15 +78,35 @@ namespace opensentinel {
              * Opens udp_listener objects.
              * @param port_begin The port to start at.
              * @param port_end The port to end at.
+             * @param transparent If true the listeners are transparent.
              */
             void open_udp_listener(
-                const std::uint16_t & port_begin, const std::uint16_t & port_end
+                const std::uint16_t & port_begin,
+                const std::uint16_t & port_end, const bool & transparent
             );
         
             /**
              * Closes udp_listener objects.
              */
             void close_udp_listeners();
+        
+            /**
+             * Handles a datagram received by a udp_listener.
+             * @note Called on the udp_listener's strand, it must not touch
+             * the udp_manager's state.
+             * @param ep The remote endpoint.
+             * @param destination_address The address the datagram was sent
+             * to (unspecified if not known).
+             * @param destination_port The port the datagram was sent to.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_datagram(
+                const asio::ip::udp::endpoint & ep,
+                const asio::ip::address & destination_address,
+                const std::uint16_t & destination_port, const char * buf,
+                const std::size_t & len
+            );
     
         protected:
         
@@ -114,14 +140,23 @@ namespace opensentinel {
             /**
              * The timer.
              */
-            asio::basic_waitable_timer<
-                std::chrono::steady_clock
-            > timer_;
+            wheel_timer timer_;
         
             /**
              * The udp_listener object's
              */
             std::vector< std::weak_ptr<udp_listener> > udp_listeners_;
+        
+            /**
+             * The io_service_pool the udp_listener objects are spread
+             * across.
+             */
+            io_service_pool & io_service_pool_;
+        
+            /**
+             * The socket_filter shared by all udp_listener object's.
+             */
+            std::shared_ptr<socket_filter> socket_filter_;
     };
     
 } // opensentinel
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/socket_filter.hpp>
+
+struct io_uring_buf_ring;
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace opensentinel {
+
+    class stack_impl;
+    
+    /**
+     * Implements an io_uring (Linux 6.0+) backend that replaces the
+     * tcp_manager, udp_manager and icmp_manager. The honeyport sockets are
+     * registered with the ring and served by multishot accept and multishot
+     * receives into a provided buffer ring so a wakeup reaps any number of
+     * events without a system call per event.
+     */
+    class uring_manager
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             */
+            explicit uring_manager(stack_impl & owner);
+        
+            /**
+             * Destructor
+             */
+            ~uring_manager();
+        
+            /**
+             * Starts, throws if the kernel does not support the required
+             * io_uring features.
+             */
+            void start();
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+        private:
+        
+            /**
+             * The operations (the top byte of the user data).
+             */
+            typedef enum op_s
+            {
+                op_accept = 1,
+                op_recvmsg,
+                op_recv,
+                op_tick,
+                op_wakeup,
+            } op_t;
+        
+            /**
+             * A registered (fixed file) socket.
+             */
+            typedef struct socket_s
+            {
+                int fd;
+                int type;
+                std::uint16_t port;
+                std::uint32_t failures;
+                bool is_backed_off;
+                bool is_retired;
+            } socket_t;
+        
+            /**
+             * An accepted connection.
+             */
+            typedef struct connection_s
+            {
+                int fd;
+                asio::ip::address address;
+                std::uint16_t port;
+                asio::ip::address destination_address;
+                std::uint16_t destination_port;
+                std::chrono::steady_clock::time_point time_accepted;
+                bool is_shutdown;
+            } connection_t;
+        
+            /**
+             * Sets up the ring, the provided buffer ring and the wakeup.
+             */
+            void setup_ring();
+        
+            /**
+             * Opens the honeyport sockets.
+             */
+            void open_sockets();
+        
+            /**
+             * Opens a socket.
+             * @param family AF_INET or AF_INET6.
+             * @param type SOCK_STREAM, SOCK_DGRAM or SOCK_RAW.
+             * @param port The port.
+             * @param transparent If true set IP_TRANSPARENT.
+             * @ret False if out of file descriptors.
+             */
+            bool open_socket(
+                const int & family, const int & type,
+                const std::uint16_t & port, const bool & transparent
+            );
+        
+            /**
+             * The thread loop.
+             */
+            void run();
+        
+            /**
+             * The timer handler.
+             */
+            void on_tick();
+        
+            /**
+             * Gets the next submission queue entry.
+             */
+            io_uring_sqe * get_sqe();
+        
+            /**
+             * Submits the queued entries.
+             * @param wait If true wait for at least one completion.
+             */
+            void submit(const bool & wait);
+        
+            /**
+             * Handles a completion queue entry.
+             * @param cqe The io_uring_cqe.
+             */
+            void handle_cqe(const io_uring_cqe & cqe);
+        
+            /**
+             * Arms the multishot accept or recvmsg of a registered socket
+             * again after it has ended. Persistent errors are retried on the
+             * next tick and the socket is retired after max_failures in a
+             * row.
+             * @param index The index.
+             * @param res The result of the last completion.
+             */
+            void rearm(const std::uint32_t & index, const std::int32_t & res);
+        
+            /**
+             * Arms a multishot accept on a registered socket.
+             * @param index The index.
+             */
+            void arm_accept(const std::uint32_t & index);
+        
+            /**
+             * Arms a multishot recvmsg on a registered socket.
+             * @param index The index.
+             */
+            void arm_recvmsg(const std::uint32_t & index);
+        
+            /**
+             * Arms a multishot recv on a connection.
+             * @param id The connection id.
+             */
+            void arm_recv(const std::uint64_t & id);
+        
+            /**
+             * Arms the timer.
+             */
+            void arm_tick();
+        
+            /**
+             * Arms the wakeup.
+             */
+            void arm_wakeup();
+        
+            /**
+             * Returns a buffer to the provided buffer ring.
+             * @param bid The buffer id.
+             */
+            void recycle_buffer(const std::uint16_t & bid);
+        
+            /**
+             * Handles an accepted connection.
+             * @param fd The file descriptor.
+             */
+            void handle_accept(const int & fd);
+        
+            /**
+             * Handles a datagram (UDP) or packet (ICMP).
+             * @param index The index.
+             * @param buf The buffer (struct io_uring_recvmsg_out).
+             * @param len The length.
+             */
+            void handle_recvmsg(
+                const std::uint32_t & index, const std::uint8_t * buf,
+                const std::size_t & len
+            );
+        
+            /**
+             * Handles data read from a connection.
+             * @param id The connection id.
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_recv(
+                const std::uint64_t & id, const char * buf,
+                const std::size_t & len
+            );
+        
+            /**
+             * Closes a connection.
+             * @param id The connection id.
+             */
+            void close_connection(const std::uint64_t & id);
+        
+            /**
+             * The ring file descriptor.
+             */
+            int m_ring_fd;
+        
+            /**
+             * The wakeup (eventfd) file descriptor.
+             */
+            int m_wakeup_fd;
+        
+            /**
+             * The mapped rings.
+             */
+            void * m_ring;
+        
+            /**
+             * The size of the mapped rings.
+             */
+            std::size_t m_ring_size;
+        
+            /**
+             * The mapped submission queue entries.
+             */
+            io_uring_sqe * m_sqes;
+        
+            /**
+             * The number of submission queue entries.
+             */
+            std::uint32_t m_sq_entries;
+        
+            /**
+             * The submission queue head, tail, mask and array.
+             */
+            std::uint32_t * m_sq_head;
+            std::uint32_t * m_sq_tail;
+            std::uint32_t m_sq_mask;
+            std::uint32_t * m_sq_array;
+        
+            /**
+             * The local submission queue tail.
+             */
+            std::uint32_t m_sq_tail_local;
+        
+            /**
+             * The completion queue head, tail, mask and entries.
+             */
+            std::uint32_t * m_cq_head;
+            std::uint32_t * m_cq_tail;
+            std::uint32_t m_cq_mask;
+            io_uring_cqe * m_cqes;
+        
+            /**
+             * The provided buffer ring.
+             */
+            io_uring_buf_ring * m_buffer_ring;
+        
+            /**
+             * The provided buffers.
+             */
+            std::uint8_t * m_buffers;
+        
+            /**
+             * The local provided buffer ring tail.
+             */
+            std::uint16_t m_buffer_tail;
+        
+            /**
+             * The registered sockets.
+             */
+            std::vector<socket_t> m_sockets;
+        
+            /**
+             * The accepted connections.
+             */
+            std::map<std::uint64_t, connection_t> m_connections;
+        
+            /**
+             * The next connection id.
+             */
+            std::uint64_t m_connection_id;
+        
+            /**
+             * The recvmsg template (struct msghdr).
+             */
+            std::vector<std::uint8_t> m_msghdr;
+        
+            /**
+             * The timer interval (struct __kernel_timespec).
+             */
+            std::int64_t m_tick_timespec[2];
+        
+            /**
+             * The wakeup counter read by the ring.
+             */
+            std::uint64_t m_wakeup_value;
+        
+            /**
+             * If true the sockets are transparent.
+             */
+            bool m_transparent;
+        
+        protected:
+        
+            /**
+             * The number of submission queue entries.
+             */
+            enum { ring_entries = 4096 };
+        
+            /**
+             * The number of failed ticks in a row after which a socket is
+             * retired.
+             */
+            enum { max_failures = 60 };
+        
+            /**
+             * The number and size of provided buffers.
+             */
+            enum
+            {
+                buffer_count = 4096,
+                buffer_size = 4096,
+                buffer_group = 0,
+            };
+        
+            /**
+             * The state.
+             */
+            enum
+            {
+                state_none,
+                state_starting,
+                state_started,
+                state_stopped,
+                state_stopping,
+            } state_;
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The std::thread.
+             */
+            std::thread thread_;
+        
+            /**
+             * The socket_filter attached to the UDP sockets.
+             */
+            socket_filter socket_filter_udp_;
+        
+            /**
+             * The socket_filter attached to the ICMP socket.
+             */
+            socket_filter socket_filter_icmp_;
+    };
+
+} // namespace opensentinel
@@ -24,6 +24,10 @@
 #include <string>
 #include <vector>
 
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
 namespace opensentinel {
 
     class utility
@@ -88,6 +92,29 @@ namespace opensentinel {
                 const bool & spaces = false
             );
         
+            /**
+             * Mixes a value (splitmix64).
+             * @param val The value.
+             */
+            static inline std::uint64_t mix(std::uint64_t val)
+            {
+                val += 0x9e3779b97f4a7c15ULL;
+                val = (val ^ (val >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                val = (val ^ (val >> 27)) * 0x94d049bb133111ebULL;
+                
+                return val ^ (val >> 31);
+            }
+        
+            /**
+             * Hashes an address as 16 (v4-mapped) bytes so an ipv4 source
+             * and it's v4-mapped form hash the same.
+             * @param addr The address.
+             * @param bytes If not null the 16 bytes are copied to it.
+             */
+            static std::uint64_t hash_address(
+                const asio::ip::address & addr, std::uint8_t * bytes = nullptr
+            );
+        
         private:
         
             // ...
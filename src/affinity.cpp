@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if (defined __linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/logger.hpp>
+
+using namespace opensentinel;
+
+#if (defined __linux__)
+/**
+ * The set_mempolicy modes (from numaif.h, libnuma is not required).
+ */
+#define OPENSENTINEL_MPOL_DEFAULT 0
+#define OPENSENTINEL_MPOL_PREFERRED 1
+#endif // __linux__
+
+std::vector<std::uint32_t> affinity::parse_cpu_list(const std::string & val)
+{
+    std::vector<std::uint32_t> ret;
+    
+    std::stringstream ss(val);
+    
+    std::string range;
+    
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        
+        auto dash = range.find('-');
+        
+        auto first = static_cast<std::uint32_t> (
+            std::stoul(range.substr(0, dash))
+        );
+        
+        auto last = first;
+        
+        if (dash != std::string::npos)
+        {
+            last = static_cast<std::uint32_t> (
+                std::stoul(range.substr(dash + 1))
+            );
+        }
+        
+        if (last < first)
+        {
+            throw std::runtime_error("invalid cpu range");
+        }
+        
+        for (auto i = first; i <= last; i++)
+        {
+            ret.push_back(i);
+        }
+    }
+    
+    return ret;
+}
+
+void affinity::pin(std::thread & t, const std::vector<std::uint32_t> & cpus)
+{
+    if (cpus.empty())
+    {
+        return;
+    }
+    
+#if (defined __linux__)
+    cpu_set_t set;
+    
+    CPU_ZERO(&set);
+    
+    for (auto & i : cpus)
+    {
+        if (i < CPU_SETSIZE)
+        {
+            CPU_SET(i, &set);
+        }
+    }
+    
+    auto ret = pthread_setaffinity_np(
+        t.native_handle(), sizeof(cpu_set_t), &set
+    );
+    
+    if (ret != 0)
+    {
+        log_error(
+            "Affinity failed to pin thread, what = " << std::strerror(ret) <<
+            "."
+        );
+    }
+#else
+    log_debug("Affinity is not supported on this platform.");
+#endif // __linux__
+}
+
+std::int32_t affinity::interface_node(const std::string & name)
+{
+    std::int32_t ret = -1;
+    
+#if (defined __linux__)
+    std::ifstream ifs("/sys/class/net/" + name + "/device/numa_node");
+    
+    if (ifs.is_open())
+    {
+        ifs >> ret;
+        
+        if (ifs.fail())
+        {
+            ret = -1;
+        }
+    }
+#endif // __linux__
+
+    return ret;
+}
+
+std::vector<std::uint32_t> affinity::node_cpus(const std::int32_t & node)
+{
+    std::vector<std::uint32_t> ret;
+    
+#if (defined __linux__)
+    if (node >= 0)
+    {
+        std::ifstream ifs(
+            "/sys/devices/system/node/node" + std::to_string(node) +
+            "/cpulist"
+        );
+        
+        std::string val;
+        
+        if (ifs.is_open() && std::getline(ifs, val))
+        {
+            try
+            {
+                ret = parse_cpu_list(val);
+            }
+            catch (std::exception & e)
+            {
+                log_error(
+                    "Affinity failed to parse cpulist of node " << node <<
+                    ", what = " << e.what() << "."
+                );
+            }
+        }
+    }
+#endif // __linux__
+
+    return ret;
+}
+
+bool affinity::set_preferred_node(const std::int32_t & node)
+{
+#if (defined __linux__)
+    long ret;
+    
+    if (node < 0)
+    {
+        ret = syscall(
+            SYS_set_mempolicy, OPENSENTINEL_MPOL_DEFAULT, nullptr, 0
+        );
+    }
+    else
+    {
+        enum { max_node = sizeof(unsigned long) * 8 };
+        
+        if (node >= max_node)
+        {
+            log_error("Affinity node " << node << " is out of range.");
+            
+            return false;
+        }
+        
+        unsigned long mask = 1UL << node;
+        
+        ret = syscall(
+            SYS_set_mempolicy, OPENSENTINEL_MPOL_PREFERRED, &mask,
+            max_node + 1
+        );
+    }
+    
+    if (ret != 0)
+    {
+        log_error(
+            "Affinity failed to set memory policy, what = " <<
+            std::strerror(errno) << "."
+        );
+        
+        return false;
+    }
+    
+    return true;
+#else
+    return false;
+#endif // __linux__
+}
@@ -45,6 +45,12 @@ const std::string alert::to_string() const
     ss << m_threat->level_string();
     ss << ",";
     
+    if (m_threat->scan_type() != threat::scan_type_none)
+    {
+        ss << m_threat->scan_type_string();
+        ss << ",";
+    }
+    
     if (m_threat->buffer().size() > 0)
     {
         enum { maximum_sample_length = 1536 };
@@ -113,6 +119,8 @@ const std::string alert::fingerprint() const
     ss << ":";
     ss << m_threat->level();
     ss << ":";
+    ss << m_threat->scan_type();
+    ss << ":";
     ss << (m_threat->buffer().size() > 0);
     
     return ss.str();
@@ -20,7 +20,10 @@
 
 #include <cstdio>
 #include <fstream>
+#include <functional>
+#include <future>
 
+#include <opensentinel/affinity.hpp>
 #include <opensentinel/alert.hpp>
 #include <opensentinel/alert_manager.hpp>
 #include <opensentinel/filesystem.hpp>
@@ -31,9 +34,15 @@ using namespace opensentinel;
 
 alert_manager::alert_manager()
     : m_file_threat_alert("threat_alert.sh")
+    , m_execute_threat_alert(true)
+    , m_threats_dropped_logged(0)
     , state_(state_none)
     , strand_(io_service_)
     , timer_(io_service_)
+    , alerts_(0)
+    , queue_(queue_size)
+    , stage_signal_(io_service_, strand_)
+    , executing_(0)
 {
     // ...
 }
@@ -83,8 +92,15 @@ void alert_manager::start()
         }
     }));
     
+    /**
+     * Drain the queue when signalled.
+     */
+    stage_signal_.start(std::bind(&alert_manager::drain, this));
+    
     thread_ = std::thread(&alert_manager::run, this);
     
+    affinity::pin(thread_, m_cpus);
+    
     state_ = state_started;
     
     log_info("Alert manager has started.");
@@ -101,11 +117,43 @@ void alert_manager::stop()
      */
     timer_.cancel();
     
+    /**
+     * Release the threat_manager if it is blocked on a full queue.
+     */
+    backpressure_.close();
+    
+    stage_signal_.stop();
+    
     if (thread_.joinable() == true)
     {
         thread_.join();
     }
     
+    /**
+     * Handle the threats still queued, the thread has exited so this is
+     * the only consumer.
+     */
+    std::size_t handled = 0;
+    std::size_t count = 0;
+    
+    do
+    {
+        count = queue_.consume(
+            [this](threat & val) { handle_threat(val); }, max_batch_size
+        );
+        
+        handled += count;
+    }
+    while (count > 0);
+    
+    if (handled > 0)
+    {
+        log_info(
+            "Alert manager handled " << handled << " queued threats while "
+            "stopping."
+        );
+    }
+    
     state_ = state_stopped;
     
     log_info("Alert manager has stopped.");
@@ -113,9 +161,37 @@ void alert_manager::stop()
 
 void alert_manager::on_threat(const threat & threat_data)
 {
-    io_service_.post(strand_.wrap([this, threat_data]()
+    if (backpressure_.push(queue_, threat_data) == true)
+    {
+        stage_signal_.notify();
+    }
+}
+
+void alert_manager::drain()
+{
+    /**
+     * Clear before draining so a threat queued from here on signals again.
+     */
+    stage_signal_.clear();
+    
+    auto count = queue_.consume(
+        [this](threat & val) { handle_threat(val); }, max_batch_size
+    );
+    
+    /**
+     * Yield to the timer before handling the rest.
+     */
+    if (count == max_batch_size)
+    {
+        io_service_.post(strand_.wrap(std::bind(&alert_manager::drain, this)));
+    }
+}
+
+void alert_manager::handle_threat(const threat & val)
+{
+    try
     {
-        alert alert_data(threat_data);
+        alert alert_data(val);
         
         /**
          * Check for (recent) duplicate alerts.
@@ -136,7 +212,30 @@ void alert_manager::on_threat(const threat & threat_data)
         {
             alert_cache_[alert_data.fingerprint()] = std::time(0);
         }
+        
+        alerts_++;
+        
+        if (m_execute_threat_alert == false)
+        {
+            return;
+        }
 
+        /**
+         * Bound the number of threat alert files executing during a storm.
+         */
+        if (executing_ >= max_executing)
+        {
+            log_error(
+                "Alert manager is executing " << executing_ << " threat alert "
+                "files, not executing for alert fingerprint = " <<
+                alert_data.fingerprint() << "."
+            );
+            
+            return;
+        }
+        
+        executing_++;
+        
         std::thread([this, alert_data]()
         {
             /**
@@ -150,15 +249,75 @@ void alert_manager::on_threat(const threat & threat_data)
             log_info(
                 "Alert manager is executing system command = " << command
             );
-        
+            
             auto ret = system(command.c_str());
-        
+            
             log_info(
                 "Alert manager called system command, ret = " << ret << "."
             );
             
+            executing_--;
         }).detach();
+    }
+    catch (std::exception & e)
+    {
+        log_error(
+            "Alert manager failed to handle threat, what = " << e.what() <<
+            "."
+        );
+    }
+}
+
+void alert_manager::flush()
+{
+    std::promise<void> done;
+    
+    io_service_.post(strand_.wrap([this, &done]()
+    {
+        while (
+            queue_.consume([this](threat & val) { handle_threat(val); },
+            max_batch_size) > 0
+            )
+        {
+            // ...
+        }
+        
+        done.set_value();
     }));
+    
+    done.get_future().wait();
+}
+
+void alert_manager::set_execute_threat_alert(const bool & val)
+{
+    m_execute_threat_alert = val;
+}
+
+void alert_manager::set_backpressure(
+    const backpressure::policy_t & val, const std::uint32_t & sample_rate
+    )
+{
+    backpressure_.set_policy(val, sample_rate);
+}
+
+void alert_manager::set_cpus(const std::vector<std::uint32_t> & val)
+{
+    m_cpus = val;
+}
+
+std::uint64_t alert_manager::alerts() const
+{
+    return alerts_;
+}
+
+std::size_t alert_manager::queue_depth() const
+{
+    return queue_.size();
+}
+
+std::uint64_t alert_manager::threats_dropped() const
+{
+    return backpressure_.dropped();
 }
 
 void alert_manager::on_tick()
@@ -193,6 +352,18 @@ void alert_manager::on_tick()
                 }
             }
             
+            auto dropped = backpressure_.dropped();
+            
+            if (dropped != m_threats_dropped_logged)
+            {
+                log_error(
+                    "Alert manager queue is full, queue depth = " <<
+                    queue_depth() << ", threats dropped = " << dropped << "."
+                );
+                
+                m_threats_dropped_logged = dropped;
+            }
+            
             on_tick();
         }
     }));
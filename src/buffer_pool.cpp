@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+
+#include <opensentinel/buffer_pool.hpp>
+
+using namespace opensentinel;
+
+buffer_pool::lease::lease()
+{
+    // ...
+}
+
+buffer_pool::lease::lease(std::unique_ptr<char[]> && buf)
+    : m_buffer(std::move(buf))
+{
+    // ...
+}
+
+buffer_pool::lease::lease(lease && other)
+    : m_buffer(std::move(other.m_buffer))
+{
+    // ...
+}
+
+buffer_pool::lease & buffer_pool::lease::operator = (lease && other)
+{
+    if (this != &other)
+    {
+        if (m_buffer)
+        {
+            buffer_pool::release(std::move(m_buffer));
+        }
+        
+        m_buffer = std::move(other.m_buffer);
+    }
+    
+    return *this;
+}
+
+buffer_pool::lease::~lease()
+{
+    if (m_buffer)
+    {
+        buffer_pool::release(std::move(m_buffer));
+    }
+}
+
+char * buffer_pool::lease::data()
+{
+    return m_buffer.get();
+}
+
+std::size_t buffer_pool::lease::size() const
+{
+    return m_buffer ? buffer_length : 0;
+}
+
+buffer_pool::lease buffer_pool::acquire()
+{
+    auto & buffers = free_list();
+    
+    if (buffers.size() > 0)
+    {
+        auto buf = std::move(buffers.back());
+        
+        buffers.pop_back();
+        
+        return lease(std::move(buf));
+    }
+    
+    return lease(std::unique_ptr<char[]> (new char[buffer_length]));
+}
+
+void buffer_pool::release(std::unique_ptr<char[]> && buf)
+{
+    auto & buffers = free_list();
+    
+    /**
+     * Free the buffer rather than keep a burst's worth around.
+     */
+    if (buffers.size() < max_free)
+    {
+        buffers.push_back(std::move(buf));
+    }
+    else
+    {
+        buf.reset();
+    }
+}
+
+std::vector< std::unique_ptr<char[]> > & buffer_pool::free_list()
+{
+    static thread_local std::vector< std::unique_ptr<char[]> > buffers;
+    
+    return buffers;
+}
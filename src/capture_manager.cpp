@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#if (defined __linux__)
+#include <unistd.h>
+#endif // __linux__
+
+#include <opensentinel/capture_manager.hpp>
+#include <opensentinel/capture_worker.hpp>
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/socket_filter.hpp>
+#include <opensentinel/stack_impl.hpp>
+
+using namespace opensentinel;
+
+capture_manager::capture_manager(stack_impl & owner)
+    : state_(state_none)
+    , stack_impl_(owner)
+{
+    // ...
+}
+
+void capture_manager::start()
+{
+    log_info("Capture manager is starting...");
+    
+    state_ = state_starting;
+    
+    auto threads = std::max(
+        static_cast<std::uint32_t> (1),
+        stack_impl_.get_configuration().capture_threads()
+    );
+    
+    /**
+     * Every worker joins the same fanout group (unique to this process) so
+     * the kernel shards the sources across them.
+     */
+    std::uint16_t fanout_group = 0;
+    
+    if (threads > 1)
+    {
+#if (defined __linux__)
+        fanout_group = static_cast<std::uint16_t> (getpid() & 0xffff);
+#endif // __linux__
+        
+        if (fanout_group == 0)
+        {
+            fanout_group = 1;
+        }
+    }
+    
+    /**
+     * Compile the socket_filter shared by all workers, the kernel only
+     * passes up possible scan probes to monitored ports.
+     */
+    auto filter = std::make_shared<socket_filter> ();
+    
+    try
+    {
+        filter->compile(
+            stack_impl_.get_configuration(), socket_filter::type_capture
+        );
+    }
+    catch (std::exception & e)
+    {
+        log_error(
+            "Capture manager failed to compile socket filter, what = " <<
+            e.what() << "."
+        );
+        
+        filter = nullptr;
+    }
+    
+    try
+    {
+        for (std::uint32_t i = 0; i < threads; i++)
+        {
+            auto worker = std::make_shared<capture_worker> (stack_impl_, i);
+            
+            worker->start(fanout_group, filter);
+            
+            capture_workers_.push_back(worker);
+        }
+    }
+    catch (std::exception & e)
+    {
+        for (auto & i : capture_workers_)
+        {
+            i->stop();
+        }
+        
+        capture_workers_.clear();
+        
+        state_ = state_none;
+        
+        throw;
+    }
+    
+    state_ = state_started;
+    
+    log_info(
+        "Capture manager has started " << capture_workers_.size() <<
+        " workers."
+    );
+}
+
+void capture_manager::stop()
+{
+    log_info("Capture manager is stopping...");
+    
+    state_ = state_stopping;
+    
+    std::uint64_t frames_received = 0;
+    std::uint64_t frames_dropped = 0;
+    std::uint64_t threats = 0;
+    
+    for (auto & i : capture_workers_)
+    {
+        i->stop();
+        
+        frames_received += i->frames_received();
+        frames_dropped += i->frames_dropped();
+        threats += i->threats();
+    }
+    
+    capture_workers_.clear();
+    
+    log_info(
+        "Capture manager received " << frames_received <<
+        " frames, dropped " << frames_dropped <<
+        " frames, detected " << threats << " threats."
+    );
+    
+    state_ = state_stopped;
+    
+    log_info("Capture manager has stopped.");
+}
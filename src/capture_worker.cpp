@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/capture_worker.hpp>
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/icmp.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/packet_view.hpp>
+#include <opensentinel/stack_impl.hpp>
+#include <opensentinel/threat.hpp>
+
+using namespace opensentinel;
+
+capture_worker::capture_worker(
+    stack_impl & owner, const std::uint32_t & index
+    )
+    : state_(state_none)
+    , stack_impl_(owner)
+    , index_(index)
+    , threats_(0)
+    , packet_(nullptr)
+    , packet_length_(0)
+    , time_(std::chrono::system_clock::now())
+{
+    /**
+     * Dispatch classified scans to the threat_manager.
+     */
+    scan_detector_.set_on_scan([this](const threat & threat_data)
+    {
+        log_debug(
+            "Capture worker " << index_ << " has detected a possible "
+            "threat (" << threat_data.scan_type_string() << ") from " <<
+            threat_data.address() << ", dispatching to threat_manager."
+        );
+        
+        threats_++;
+        
+        /**
+         * Attach the segment being classified as evidence.
+         */
+        auto threat_evidence = threat_data;
+        
+        threat_evidence.set_packet(packet_, packet_length_);
+        
+        stack_impl_.on_threat(threat_evidence);
+    });
+    
+    const auto & config = stack_impl_.get_configuration();
+    
+    /**
+     * The sources are sharded across the workers.
+     */
+    scan_correlator_.start(
+        config.correlation_sources() / std::max(
+        static_cast<std::uint32_t> (1), config.capture_threads()),
+        config.correlation_window()
+    );
+    
+    /**
+     * Dispatch correlated scans to the threat_manager.
+     */
+    scan_correlator_.set_on_threat([this](threat & val)
+    {
+        log_info(
+            "Capture worker " << index_ << " correlated " << val.address() <<
+            " as " << val.scan_type_string() << " at " << val.rate() <<
+            " events per second."
+        );
+        
+        /**
+         * A single probe's threat was already reported on it's own, it is
+         * only logged.
+         */
+        if (val.scan_type() == threat::scan_type_probe)
+        {
+            return;
+        }
+        
+        threats_++;
+        
+        stack_impl_.on_threat(val);
+    });
+}
+
+void capture_worker::start(
+    const std::uint16_t & fanout_group,
+    const std::shared_ptr<socket_filter> & filter
+    )
+{
+    state_ = state_starting;
+    
+    const auto & config = stack_impl_.get_configuration();
+    
+    try
+    {
+        packet_ring_.set_socket_filter(filter);
+        
+        /**
+         * Open the packet_ring joining the fanout group.
+         */
+        packet_ring_.open(
+            config.capture_interface(), config.capture_block_size(),
+            config.capture_block_count(), fanout_group
+        );
+    }
+    catch (std::exception & e)
+    {
+        state_ = state_none;
+        
+        throw;
+    }
+    
+    thread_ = std::thread(&capture_worker::run, this);
+    
+    auto cpus = config.cpus("capture");
+    
+    if (cpus.empty())
+    {
+        /**
+         * Keep the worker on the NUMA node of the capture interface.
+         */
+        affinity::pin(
+            thread_, affinity::node_cpus(
+            affinity::interface_node(config.capture_interface()))
+        );
+    }
+    else
+    {
+        /**
+         * One CPU per worker, wrapping around the list.
+         */
+        affinity::pin(
+            thread_, std::vector<std::uint32_t> (
+            1, cpus[index_ % cpus.size()])
+        );
+    }
+    
+    state_ = state_started;
+}
+
+void capture_worker::stop()
+{
+    state_ = state_stopping;
+    
+    if (thread_.joinable() == true)
+    {
+        thread_.join();
+    }
+    
+    /**
+     * Collect the kernel drop counter before the socket goes away.
+     */
+    packet_ring_.frames_dropped();
+    
+    packet_ring_.close();
+    
+    state_ = state_stopped;
+}
+
+std::uint64_t capture_worker::frames_received() const
+{
+    return packet_ring_.frames_received();
+}
+
+std::uint64_t capture_worker::frames_dropped()
+{
+    return packet_ring_.frames_dropped();
+}
+
+void capture_worker::set_time(
+    const std::chrono::system_clock::time_point & val
+    )
+{
+    time_ = val;
+    
+    /**
+     * A replay advances the correlation window on the recorded time.
+     */
+    scan_correlator_.on_tick(time_);
+}
+
+std::uint64_t capture_worker::threats() const
+{
+    return threats_;
+}
+
+void capture_worker::run()
+{
+    while (state_ == state_starting || state_ == state_started)
+    {
+        try
+        {
+            /**
+             * Consume one block at a time waking up at least every 100
+             * milliseconds to check the state.
+             */
+            packet_ring_.poll(100, [this](
+                const std::uint8_t * buf, const std::size_t & len
+                )
+            {
+                time_ = std::chrono::system_clock::now();
+                
+                handle_frame(buf, len);
+            });
+            
+            scan_correlator_.on_tick(std::chrono::system_clock::now());
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Capture worker " << index_ << " thread caught exception, "
+                "what = " << e.what() << "."
+            );
+        }
+    }
+    
+    log_info("Capture worker " << index_ << " thread has stopped.");
+}
+
+void capture_worker::handle_frame(
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    enum { ethernet_header_length = 14 };
+    
+    if (len < ethernet_header_length)
+    {
+        return;
+    }
+    
+    std::size_t offset = 12;
+    
+    std::uint16_t ether_type = (buf[offset] << 8) + buf[offset + 1];
+    
+    /**
+     * Skip (stacked) 802.1Q VLAN tags.
+     */
+    while (
+        (ether_type == 0x8100 || ether_type == 0x88a8) && len >= offset + 6
+        )
+    {
+        offset += 4;
+        
+        ether_type = (buf[offset] << 8) + buf[offset + 1];
+    }
+    
+    offset += 2;
+    
+    if (ether_type == 0x0800)
+    {
+        handle_ipv4(buf + offset, len - offset);
+    }
+    else if (ether_type == 0x86dd)
+    {
+        handle_ipv6(buf + offset, len - offset);
+    }
+}
+
+void capture_worker::handle_ipv4(
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    ipv4_view ipv4_hdr(buf, len);
+    
+    if (ipv4_hdr.valid() == false)
+    {
+        return;
+    }
+    
+    /**
+     * Only the first fragment carries the transport header.
+     */
+    if (ipv4_hdr.fragment_offset() != 0)
+    {
+        return;
+    }
+    
+    const auto & config = stack_impl_.get_configuration();
+    
+    /**
+     * Trim any ethernet padding.
+     */
+    auto packet_length = ipv4_hdr.packet_length();
+    
+    if (packet_length < ipv4_hdr.header_length())
+    {
+        return;
+    }
+    
+    auto ptr = ipv4_hdr.payload();
+    auto remaining = ipv4_hdr.payload_length();
+    
+    packet_ = buf;
+    packet_length_ = packet_length;
+    
+    switch (ipv4_hdr.protocol())
+    {
+        case IPPROTO_TCP:
+        {
+            tcp_view tcp_hdr(ptr, remaining);
+            
+            if (tcp_hdr.valid() == true)
+            {
+                auto type = scan_detector_.on_tcp_segment(
+                    ipv4_hdr.source_address(), ipv4_hdr.destination_address(),
+                    tcp_hdr,
+                    config.is_monitored_port(tcp_hdr.destination_port()),
+                    time_
+                );
+                
+                /**
+                 * Correlate every probe, the scan_detector only reports
+                 * a source once per window.
+                 */
+                if (type != threat::scan_type_none)
+                {
+                    scan_correlator_.on_probe(
+                        threat::protocol_tcp, ipv4_hdr.source_address(),
+                        ipv4_hdr.destination_address(),
+                        tcp_hdr.destination_port(), time_
+                    );
+                }
+            }
+        }
+        break;
+        case IPPROTO_UDP:
+        {
+            udp_view udp_hdr(ptr, remaining);
+            
+            if (udp_hdr.valid() == false)
+            {
+                break;
+            }
+            
+            std::uint16_t port_source = udp_hdr.source_port();
+            std::uint16_t port_destination = udp_hdr.destination_port();
+            
+            if (config.is_monitored_port(port_destination))
+            {
+                threat threat_data(
+                    threat::protocol_udp, ipv4_hdr.source_address(),
+                    port_source,
+                    reinterpret_cast<const char *> (udp_hdr.payload()),
+                    udp_hdr.payload_length()
+                );
+                
+                threat_data.set_destination_address(
+                    ipv4_hdr.destination_address()
+                );
+                threat_data.set_destination_port(port_destination);
+                
+                /**
+                 * Set the threat::level_t.
+                 */
+                threat_data.set_level(threat::level_3);
+                
+                log_debug(
+                    "Capture worker " << index_ << " has detected a "
+                    "possible threat (UDP Receive) from " <<
+                    ipv4_hdr.source_address() <<
+                    ":" << port_source << ", dispatching to threat_manager."
+                );
+                
+                threat_data.set_packet(buf, packet_length);
+                threat_data.set_timestamp(time_);
+                
+                threats_++;
+                
+                stack_impl_.on_threat(threat_data);
+            }
+        }
+        break;
+        case IPPROTO_ICMP:
+        {
+            icmp_view icmp_hdr(ptr, remaining);
+            
+            if (icmp_hdr.valid() == false)
+            {
+                break;
+            }
+            
+            /**
+             * Consider a PING to be a threat.
+             */
+            if (icmp_hdr.type() == icmp::header::type_echo_request)
+            {
+                threat threat_data(
+                    threat::protocol_icmp, ipv4_hdr.source_address(), 0, 0, 0
+                );
+                
+                threat_data.set_destination_address(
+                    ipv4_hdr.destination_address()
+                );
+                
+                /**
+                 * Set the level to threat::level_3.
+                 */
+                threat_data.set_level(threat::level_3);
+                
+                log_debug(
+                    "Capture worker " << index_ << " has detected a "
+                    "possible threat (ICMP Receive) from " <<
+                    ipv4_hdr.source_address() <<
+                    ", dispatching to threat_manager."
+                );
+                
+                threat_data.set_packet(buf, packet_length);
+                threat_data.set_timestamp(time_);
+                
+                threats_++;
+                
+                stack_impl_.on_threat(threat_data);
+            }
+        }
+        break;
+        default:
+        break;
+    }
+}
+
+void capture_worker::handle_ipv6(
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    ipv6_view ipv6_hdr(buf, len);
+    
+    if (ipv6_hdr.valid() == false)
+    {
+        return;
+    }
+    
+    auto address_source = ipv6_hdr.source_address();
+    
+    /**
+     * Trim any ethernet padding.
+     */
+    auto packet_length = ipv6_hdr.packet_length();
+    
+    const auto & config = stack_impl_.get_configuration();
+    
+    auto ptr = ipv6_hdr.payload();
+    auto remaining = ipv6_hdr.payload_length();
+    
+    packet_ = buf;
+    packet_length_ = packet_length;
+    
+    switch (ipv6_hdr.next_header())
+    {
+        case IPPROTO_TCP:
+        {
+            tcp_view tcp_hdr(ptr, remaining);
+            
+            if (tcp_hdr.valid() == true)
+            {
+                auto type = scan_detector_.on_tcp_segment(
+                    address_source, ipv6_hdr.destination_address(), tcp_hdr,
+                    config.is_monitored_port(tcp_hdr.destination_port()),
+                    time_
+                );
+                
+                /**
+                 * Correlate every probe, the scan_detector only reports
+                 * a source once per window.
+                 */
+                if (type != threat::scan_type_none)
+                {
+                    scan_correlator_.on_probe(
+                        threat::protocol_tcp, address_source,
+                        ipv6_hdr.destination_address(),
+                        tcp_hdr.destination_port(), time_
+                    );
+                }
+            }
+        }
+        break;
+        case IPPROTO_UDP:
+        {
+            udp_view udp_hdr(ptr, remaining);
+            
+            if (udp_hdr.valid() == false)
+            {
+                break;
+            }
+            
+            std::uint16_t port_source = udp_hdr.source_port();
+            std::uint16_t port_destination = udp_hdr.destination_port();
+            
+            if (config.is_monitored_port(port_destination))
+            {
+                threat threat_data(
+                    threat::protocol_udp, address_source, port_source,
+                    reinterpret_cast<const char *> (udp_hdr.payload()),
+                    udp_hdr.payload_length()
+                );
+                
+                threat_data.set_destination_address(
+                    ipv6_hdr.destination_address()
+                );
+                threat_data.set_destination_port(port_destination);
+                
+                threat_data.set_level(threat::level_3);
+                
+                threat_data.set_packet(buf, packet_length);
+                threat_data.set_timestamp(time_);
+                
+                threats_++;
+                
+                stack_impl_.on_threat(threat_data);
+            }
+        }
+        break;
+        case IPPROTO_ICMPV6:
+        {
+            icmp_view icmp_hdr(ptr, remaining);
+            
+            if (icmp_hdr.valid() == false)
+            {
+                break;
+            }
+            
+            /**
+             * Consider a PING to be a threat.
+             */
+            if (icmp_hdr.type() == icmp::header::type_echo_request_v6)
+            {
+                threat threat_data(
+                    threat::protocol_icmp, address_source, 0, 0, 0
+                );
+                
+                threat_data.set_destination_address(
+                    ipv6_hdr.destination_address()
+                );
+                
+                /**
+                 * Set the level to threat::level_3.
+                 */
+                threat_data.set_level(threat::level_3);
+                
+                log_debug(
+                    "Capture worker " << index_ << " has detected a "
+                    "possible threat (ICMPv6 Receive) from " <<
+                    address_source << ", dispatching to threat_manager."
+                );
+                
+                threat_data.set_packet(buf, packet_length);
+                threat_data.set_timestamp(time_);
+                
+                threats_++;
+                
+                stack_impl_.on_threat(threat_data);
+            }
+        }
+        break;
+        default:
+        break;
+    }
+}
@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/filesystem.hpp>
+#include <opensentinel/logger.hpp>
+
+using namespace opensentinel;
+
+configuration::configuration()
+    : m_capture_block_size(1 << 20)
+    , m_capture_block_count(32)
+    , m_capture_threads(1)
+    , m_replay_realtime(false)
+    , m_evidence_segment_size(64 << 20)
+    , m_evidence_segment_count(8)
+    , m_udp_batch_size(32)
+    , m_transparent_port(0)
+    , m_network_threads(1)
+    , m_io_uring(false)
+    , m_dual_stack(false)
+    , m_threat_policy(backpressure::policy_drop)
+    , m_alert_policy(backpressure::policy_block)
+    , m_sample_rate(16)
+    , m_numa_node(-1)
+    , m_correlation_window(60)
+    , m_correlation_sources(1 << 18)
+    , m_flood_threshold(1000)
+    , m_flood_interval(10)
+{
+    /**
+     * The default monitored port ranges.
+     * @note Skip NetBios, bootps and bootpc.
+     */
+    m_port_ranges.push_back(std::make_pair(1 /* tcpmux */, 66 /* sql-net */));
+    m_port_ranges.push_back(std::make_pair(69 /* tftp */, 136 /* profile */));
+    m_port_ranges.push_back(
+        std::make_pair(140 /* emfis-data */, 2028 /* dls-monitor */)
+    );
+    m_port_ranges.push_back(
+        std::make_pair(8080 /* http-alt */, 8280 /* synapse-nhttp */)
+    );
+}
+
+void configuration::load(const std::map<std::string, std::string> & args)
+{
+    for (auto & i : args)
+    {
+        try
+        {
+            if (i.first == "capture")
+            {
+                m_capture_interface = i.second;
+            }
+            else if (i.first == "capture-block-size")
+            {
+                m_capture_block_size = std::stoul(i.second);
+            }
+            else if (i.first == "capture-block-count")
+            {
+                m_capture_block_count = std::stoul(i.second);
+            }
+            else if (i.first == "capture-threads")
+            {
+                m_capture_threads = std::stoul(i.second);
+            }
+            else if (i.first == "replay")
+            {
+                m_replay_file = i.second;
+            }
+            else if (i.first == "replay-realtime")
+            {
+                m_replay_realtime = i.second != "0";
+            }
+            else if (i.first == "evidence")
+            {
+                /**
+                 * Either a directory or 1 for the default one.
+                 */
+                if (i.second == "1")
+                {
+                    m_evidence_path = filesystem::data_path() + "evidence/";
+                }
+                else if (i.second.empty() == false)
+                {
+                    m_evidence_path = i.second;
+                    
+                    if (m_evidence_path.back() != '/')
+                    {
+                        m_evidence_path += "/";
+                    }
+                }
+            }
+            else if (i.first == "evidence-segment-size")
+            {
+                m_evidence_segment_size = std::stoul(i.second);
+            }
+            else if (i.first == "evidence-segment-count")
+            {
+                m_evidence_segment_count = std::stoul(i.second);
+            }
+            else if (i.first == "udp-batch-size")
+            {
+                m_udp_batch_size = std::stoul(i.second);
+            }
+            else if (i.first == "io-uring")
+            {
+                m_io_uring = i.second != "0";
+            }
+            else if (i.first == "dual-stack")
+            {
+                m_dual_stack = i.second != "0";
+            }
+            else if (i.first == "threat-policy")
+            {
+                m_threat_policy = backpressure::policy_from_string(i.second);
+            }
+            else if (i.first == "alert-policy")
+            {
+                m_alert_policy = backpressure::policy_from_string(i.second);
+            }
+            else if (i.first == "sample-rate")
+            {
+                m_sample_rate = std::stoul(i.second);
+            }
+            else if (
+                i.first.size() > 5 &&
+                i.first.compare(i.first.size() - 5, 5, "-cpus") == 0
+                )
+            {
+                /**
+                 * A CPU list per thread role (--capture-cpus=8-11).
+                 */
+                set_cpus(
+                    i.first.substr(0, i.first.size() - 5),
+                    affinity::parse_cpu_list(i.second)
+                );
+            }
+            else if (i.first == "numa-node")
+            {
+                m_numa_node = std::stoi(i.second);
+            }
+            else if (i.first == "signatures")
+            {
+                m_signature_file = i.second;
+            }
+            else if (i.first == "correlation-window")
+            {
+                m_correlation_window = std::stoul(i.second);
+            }
+            else if (i.first == "correlation-sources")
+            {
+                m_correlation_sources = std::stoul(i.second);
+            }
+            else if (i.first == "flood-threshold")
+            {
+                m_flood_threshold = std::stoul(i.second);
+            }
+            else if (i.first == "flood-interval")
+            {
+                m_flood_interval = std::max(1ul, std::stoul(i.second));
+            }
+            else if (i.first == "network-threads")
+            {
+                m_network_threads = std::stoul(i.second);
+            }
+            else if (i.first == "transparent")
+            {
+                m_transparent_port = static_cast<std::uint16_t> (
+                    std::stoul(i.second)
+                );
+            }
+            else if (i.first == "allow")
+            {
+                /**
+                 * A comma separated list of addresses with an optional
+                 * prefix length (10.0.0.5,192.168.10.0/24,fd00::/8).
+                 */
+                std::stringstream ss(i.second);
+                
+                std::string source;
+                
+                while (std::getline(ss, source, ','))
+                {
+                    if (source.empty())
+                    {
+                        continue;
+                    }
+                    
+                    auto slash = source.find('/');
+                    
+                    auto addr = asio::ip::address::from_string(
+                        source.substr(0, slash)
+                    );
+                    
+                    std::uint32_t prefix_length = addr.is_v4() ? 32 : 128;
+                    
+                    if (slash != std::string::npos)
+                    {
+                        prefix_length = std::min(
+                            prefix_length, static_cast<std::uint32_t> (
+                            std::stoul(source.substr(slash + 1)))
+                        );
+                    }
+                    
+                    m_allowed_sources.push_back(
+                        std::make_pair(addr, prefix_length)
+                    );
+                }
+            }
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Configuration failed to parse argument " << i.first <<
+                " = " << i.second << ", what = " << e.what() << "."
+            );
+        }
+    }
+}
+
+void configuration::set_capture_interface(const std::string & val)
+{
+    m_capture_interface = val;
+}
+
+const std::string & configuration::capture_interface() const
+{
+    return m_capture_interface;
+}
+
+void configuration::set_capture_block_size(const std::uint32_t & val)
+{
+    m_capture_block_size = val;
+}
+
+const std::uint32_t & configuration::capture_block_size() const
+{
+    return m_capture_block_size;
+}
+
+void configuration::set_capture_block_count(const std::uint32_t & val)
+{
+    m_capture_block_count = val;
+}
+
+const std::uint32_t & configuration::capture_block_count() const
+{
+    return m_capture_block_count;
+}
+
+void configuration::set_capture_threads(const std::uint32_t & val)
+{
+    m_capture_threads = val;
+}
+
+const std::uint32_t & configuration::capture_threads() const
+{
+    return m_capture_threads;
+}
+
+void configuration::set_replay_file(const std::string & val)
+{
+    m_replay_file = val;
+}
+
+const std::string & configuration::replay_file() const
+{
+    return m_replay_file;
+}
+
+void configuration::set_replay_realtime(const bool & val)
+{
+    m_replay_realtime = val;
+}
+
+const bool & configuration::replay_realtime() const
+{
+    return m_replay_realtime;
+}
+
+void configuration::set_evidence_path(const std::string & val)
+{
+    m_evidence_path = val;
+}
+
+const std::string & configuration::evidence_path() const
+{
+    return m_evidence_path;
+}
+
+void configuration::set_evidence_segment_size(const std::uint32_t & val)
+{
+    m_evidence_segment_size = val;
+}
+
+const std::uint32_t & configuration::evidence_segment_size() const
+{
+    return m_evidence_segment_size;
+}
+
+void configuration::set_evidence_segment_count(const std::uint32_t & val)
+{
+    m_evidence_segment_count = val;
+}
+
+const std::uint32_t & configuration::evidence_segment_count() const
+{
+    return m_evidence_segment_count;
+}
+
+void configuration::set_udp_batch_size(const std::uint32_t & val)
+{
+    m_udp_batch_size = val;
+}
+
+const std::uint32_t & configuration::udp_batch_size() const
+{
+    return m_udp_batch_size;
+}
+
+void configuration::set_transparent_port(const std::uint16_t & val)
+{
+    m_transparent_port = val;
+}
+
+const std::uint16_t & configuration::transparent_port() const
+{
+    return m_transparent_port;
+}
+
+void configuration::set_network_threads(const std::uint32_t & val)
+{
+    m_network_threads = val;
+}
+
+const std::uint32_t & configuration::network_threads() const
+{
+    return m_network_threads;
+}
+
+void configuration::set_io_uring(const bool & val)
+{
+    m_io_uring = val;
+}
+
+const bool & configuration::io_uring() const
+{
+    return m_io_uring;
+}
+
+void configuration::set_dual_stack(const bool & val)
+{
+    m_dual_stack = val;
+}
+
+const bool & configuration::dual_stack() const
+{
+    return m_dual_stack;
+}
+
+void configuration::set_threat_policy(const backpressure::policy_t & val)
+{
+    m_threat_policy = val;
+}
+
+const backpressure::policy_t & configuration::threat_policy() const
+{
+    return m_threat_policy;
+}
+
+void configuration::set_alert_policy(const backpressure::policy_t & val)
+{
+    m_alert_policy = val;
+}
+
+const backpressure::policy_t & configuration::alert_policy() const
+{
+    return m_alert_policy;
+}
+
+void configuration::set_sample_rate(const std::uint32_t & val)
+{
+    m_sample_rate = val;
+}
+
+const std::uint32_t & configuration::sample_rate() const
+{
+    return m_sample_rate;
+}
+
+void configuration::set_cpus(
+    const std::string & role, const std::vector<std::uint32_t> & val
+    )
+{
+    static const std::array<std::string, 7> g_roles =
+    {
+        {
+            "network", "capture", "threat", "alert", "icmp", "evidence",
+            "uring"
+        }
+    };
+    
+    if (std::find(g_roles.begin(), g_roles.end(), role) == g_roles.end())
+    {
+        throw std::runtime_error("unknown thread role");
+    }
+    
+    m_cpus[role] = val;
+}
+
+std::vector<std::uint32_t> configuration::cpus(const std::string & role) const
+{
+    auto it = m_cpus.find(role);
+    
+    if (it != m_cpus.end())
+    {
+        return it->second;
+    }
+    
+    return std::vector<std::uint32_t> ();
+}
+
+void configuration::set_numa_node(const std::int32_t & val)
+{
+    m_numa_node = val;
+}
+
+const std::int32_t & configuration::numa_node() const
+{
+    return m_numa_node;
+}
+
+void configuration::set_signature_file(const std::string & val)
+{
+    m_signature_file = val;
+}
+
+const std::string & configuration::signature_file() const
+{
+    return m_signature_file;
+}
+
+void configuration::set_correlation_window(const std::uint32_t & val)
+{
+    m_correlation_window = val;
+}
+
+const std::uint32_t & configuration::correlation_window() const
+{
+    return m_correlation_window;
+}
+
+void configuration::set_correlation_sources(const std::uint32_t & val)
+{
+    m_correlation_sources = val;
+}
+
+const std::uint32_t & configuration::correlation_sources() const
+{
+    return m_correlation_sources;
+}
+
+void configuration::set_flood_threshold(const std::uint32_t & val)
+{
+    m_flood_threshold = val;
+}
+
+const std::uint32_t & configuration::flood_threshold() const
+{
+    return m_flood_threshold;
+}
+
+void configuration::set_flood_interval(const std::uint32_t & val)
+{
+    m_flood_interval = val;
+}
+
+const std::uint32_t & configuration::flood_interval() const
+{
+    return m_flood_interval;
+}
+
+const std::vector<
+    std::pair<std::uint16_t, std::uint16_t>
+> & configuration::port_ranges() const
+{
+    return m_port_ranges;
+}
+
+bool configuration::is_monitored_port(const std::uint16_t & port) const
+{
+    for (auto & i : m_port_ranges)
+    {
+        if (port >= i.first && port <= i.second)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+const std::vector<
+    std::pair<asio::ip::address, std::uint8_t>
+> & configuration::allowed_sources() const
+{
+    return m_allowed_sources;
+}
+
+bool configuration::is_allowed_source(const asio::ip::address & addr) const
+{
+    for (auto & i : m_allowed_sources)
+    {
+        if (addr.is_v4() != i.first.is_v4())
+        {
+            continue;
+        }
+        
+        std::array<std::uint8_t, 16> a, b;
+        
+        std::size_t len;
+        
+        if (addr.is_v4())
+        {
+            auto bytes_a = addr.to_v4().to_bytes();
+            auto bytes_b = i.first.to_v4().to_bytes();
+            
+            std::copy(bytes_a.begin(), bytes_a.end(), a.begin());
+            std::copy(bytes_b.begin(), bytes_b.end(), b.begin());
+            
+            len = bytes_a.size();
+        }
+        else
+        {
+            a = addr.to_v6().to_bytes();
+            b = i.first.to_v6().to_bytes();
+            
+            len = a.size();
+        }
+        
+        /**
+         * Compare whole bytes then the remaining bits of the prefix.
+         */
+        std::size_t bits = i.second;
+        
+        bool matched = true;
+        
+        for (std::size_t j = 0; j < len && bits > 0; j++)
+        {
+            std::uint8_t mask = static_cast<std::uint8_t> (
+                bits >= 8 ? 0xff : 0xff << (8 - bits)
+            );
+            
+            if ((a[j] & mask) != (b[j] & mask))
+            {
+                matched = false;
+                
+                break;
+            }
+            
+            bits -= std::min(bits, static_cast<std::size_t> (8));
+        }
+        
+        if (matched == true)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
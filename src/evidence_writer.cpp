@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if (! defined _MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _MSC_VER
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/evidence_writer.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/threat.hpp>
+
+using namespace opensentinel;
+
+/**
+ * The pcapng block types.
+ */
+enum
+{
+    block_type_interface_description = 0x00000001,
+    block_type_enhanced_packet = 0x00000006,
+    block_type_section_header = 0x0a0d0d0a,
+};
+
+/**
+ * The interfaces, raw (ip) packets and bare payloads.
+ */
+enum
+{
+    interface_packet,
+    interface_payload,
+};
+
+/**
+ * The maximum number of bytes recorded per threat.
+ */
+enum { maximum_capture_length = 65535 };
+
+/**
+ * Rounds up to a multiple of 4 bytes.
+ */
+static std::size_t pad4(const std::size_t & len)
+{
+    return (len + 3) & ~static_cast<std::size_t> (3);
+}
+
+evidence_writer::evidence_writer()
+    : m_segment_size(0)
+    , m_segment_count(0)
+    , m_segments_opened(0)
+    , m_file(-1)
+    , m_segment(nullptr)
+    , m_offset(0)
+    , state_(state_none)
+    , strand_(io_service_)
+    , timer_(io_service_)
+    , pending_(0)
+    , records_written_(0)
+    , records_dropped_(0)
+{
+    // ...
+}
+
+evidence_writer::~evidence_writer()
+{
+    close_segment();
+}
+
+void evidence_writer::start(
+    const std::string & path, const std::uint32_t & segment_size,
+    const std::uint32_t & segment_count
+    )
+{
+    log_info("Evidence writer is starting...");
+    
+    state_ = state_starting;
+    
+    m_path = path;
+    m_segment_size = segment_size;
+    m_segment_count = std::max(static_cast<std::uint32_t> (1), segment_count);
+    
+    try
+    {
+        open_segment();
+    }
+    catch (std::exception & e)
+    {
+        state_ = state_none;
+        
+        throw;
+    }
+    
+    /**
+     * Starts the timer.
+     */
+    timer_.expires_from_now(std::chrono::seconds(1));
+    timer_.async_wait(strand_.wrap([this](std::error_code ec)
+    {
+        if (ec)
+        {
+            // ...
+        }
+        else
+        {
+            on_tick();
+        }
+    }));
+    
+    thread_ = std::thread(&evidence_writer::run, this);
+    
+    affinity::pin(thread_, m_cpus);
+    
+    state_ = state_started;
+    
+    log_info("Evidence writer has started.");
+}
+
+void evidence_writer::stop()
+{
+    log_info("Evidence writer is stopping...");
+    
+    state_ = state_stopping;
+    
+    /**
+     * Cancel the timer, the thread exits once the queue has been written.
+     */
+    timer_.cancel();
+    
+    if (thread_.joinable() == true)
+    {
+        thread_.join();
+    }
+    
+    close_segment();
+    
+    state_ = state_stopped;
+    
+    log_info(
+        "Evidence writer has stopped, records written = " <<
+        records_written_ << ", records dropped = " << records_dropped_ << "."
+    );
+}
+
+void evidence_writer::write(const threat & threat_data)
+{
+    if (state_ != state_started)
+    {
+        return;
+    }
+    
+    /**
+     * Under a flood drop evidence rather than letting the queue grow.
+     */
+    if (pending_ >= maximum_pending)
+    {
+        records_dropped_++;
+        
+        return;
+    }
+    
+    pending_++;
+    
+    io_service_.post(strand_.wrap([this, threat_data]()
+    {
+        pending_--;
+        
+        append(threat_data);
+    }));
+}
+
+std::uint64_t evidence_writer::records_written() const
+{
+    return records_written_;
+}
+
+std::uint64_t evidence_writer::records_dropped() const
+{
+    return records_dropped_;
+}
+
+void evidence_writer::set_cpus(const std::vector<std::uint32_t> & val)
+{
+    m_cpus = val;
+}
+
+void evidence_writer::on_tick()
+{
+#if (! defined _MSC_VER)
+    /**
+     * Schedule the dirty pages to be written back without waiting.
+     */
+    if (m_segment != nullptr)
+    {
+        msync(m_segment, m_segment_size, MS_ASYNC);
+    }
+#endif // _MSC_VER
+
+    /**
+     * Starts the timer.
+     */
+    timer_.expires_from_now(std::chrono::seconds(1));
+    timer_.async_wait(strand_.wrap([this](std::error_code ec)
+    {
+        if (ec)
+        {
+            // ...
+        }
+        else
+        {
+            on_tick();
+        }
+    }));
+}
+
+void evidence_writer::run()
+{
+    while (state_ == state_starting || state_ == state_started)
+    {
+        try
+        {
+            io_service_.run();
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Evidence writer thread caught exception, what = " <<
+                e.what() << "."
+            );
+        }
+    }
+    
+    log_info("Evidence writer thread has stopped.");
+}
+
+void evidence_writer::open_segment()
+{
+#if (defined _MSC_VER)
+    throw std::runtime_error("not supported");
+#else
+    std::stringstream ss;
+    
+    ss <<
+        m_path << "evidence-" << std::time(0) << "-" << m_segments_opened++ <<
+        ".pcapng"
+    ;
+    
+    auto path = ss.str();
+    
+    m_file = ::open(
+        path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR
+    );
+    
+    if (m_file < 0)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    /**
+     * Reserve the whole segment up front so appending never has to extend
+     * the file.
+     */
+#if (defined __linux__)
+    auto ret = posix_fallocate(m_file, 0, m_segment_size);
+#else
+    auto ret = ftruncate(m_file, m_segment_size) == 0 ? 0 : errno;
+#endif // __linux__
+
+    if (ret != 0)
+    {
+        ::close(m_file);
+        
+        m_file = -1;
+        
+        throw std::runtime_error(std::strerror(ret));
+    }
+    
+    auto ptr = mmap(
+        0, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0
+    );
+    
+    if (ptr == MAP_FAILED)
+    {
+        ::close(m_file);
+        
+        m_file = -1;
+        
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_segment = static_cast<std::uint8_t *> (ptr);
+    m_offset = 0;
+    
+    m_segment_paths.push_back(path);
+    
+    /**
+     * Only keep the most recent segments.
+     */
+    while (m_segment_paths.size() > m_segment_count)
+    {
+        std::remove(m_segment_paths.front().c_str());
+        
+        m_segment_paths.pop_front();
+    }
+    
+    /**
+     * The section header block (written in host byte order).
+     */
+    std::uint8_t shb[28];
+    
+    std::uint32_t val32 = block_type_section_header;
+    std::memcpy(shb, &val32, 4);
+    val32 = sizeof(shb);
+    std::memcpy(shb + 4, &val32, 4);
+    val32 = 0x1a2b3c4d;
+    std::memcpy(shb + 8, &val32, 4);
+    std::uint16_t val16 = 1;
+    std::memcpy(shb + 12, &val16, 2);
+    val16 = 0;
+    std::memcpy(shb + 14, &val16, 2);
+    std::int64_t section_length = -1;
+    std::memcpy(shb + 16, &section_length, 8);
+    val32 = sizeof(shb);
+    std::memcpy(shb + 24, &val32, 4);
+    
+    append_block(shb, sizeof(shb));
+    
+    /**
+     * The interface description blocks, LINKTYPE_RAW for packets and
+     * LINKTYPE_USER0 for bare payloads.
+     */
+    for (auto link_type : { 101, 147 })
+    {
+        std::uint8_t idb[20];
+        
+        val32 = block_type_interface_description;
+        std::memcpy(idb, &val32, 4);
+        val32 = sizeof(idb);
+        std::memcpy(idb + 4, &val32, 4);
+        val16 = static_cast<std::uint16_t> (link_type);
+        std::memcpy(idb + 8, &val16, 2);
+        val16 = 0;
+        std::memcpy(idb + 10, &val16, 2);
+        val32 = maximum_capture_length;
+        std::memcpy(idb + 12, &val32, 4);
+        val32 = sizeof(idb);
+        std::memcpy(idb + 16, &val32, 4);
+        
+        append_block(idb, sizeof(idb));
+    }
+    
+    log_debug("Evidence writer opened segment " << path << ".");
+#endif // _MSC_VER
+}
+
+void evidence_writer::close_segment()
+{
+#if (! defined _MSC_VER)
+    if (m_segment != nullptr)
+    {
+        munmap(m_segment, m_segment_size);
+        
+        m_segment = nullptr;
+    }
+    
+    if (m_file >= 0)
+    {
+        /**
+         * Give back the unused tail so readers see a well formed file.
+         */
+        if (ftruncate(m_file, m_offset) != 0)
+        {
+            log_error(
+                "Evidence writer failed to trim segment, message = " <<
+                std::strerror(errno) << "."
+            );
+        }
+        
+        ::close(m_file);
+        
+        m_file = -1;
+    }
+#endif // _MSC_VER
+}
+
+void evidence_writer::append(const threat & threat_data)
+{
+    if (m_segment == nullptr)
+    {
+        return;
+    }
+    
+    /**
+     * Prefer the packet, fall back to the payload.
+     */
+    auto has_packet = threat_data.packet().size() > 0;
+    
+    const std::uint8_t * data = has_packet ?
+        threat_data.packet().data() :
+        reinterpret_cast<const std::uint8_t *> (threat_data.buffer().data())
+    ;
+    
+    std::size_t captured_length = std::min(
+        static_cast<std::size_t> (maximum_capture_length),
+        has_packet ? threat_data.packet().size() : threat_data.buffer().size()
+    );
+    
+    std::stringstream ss;
+    
+    ss <<
+        threat_data.protocol_string() << " " << threat_data.level_string() <<
+        " from " << threat_data.address() << ":" << threat_data.port()
+    ;
+    
+    if (threat_data.destination_port() > 0)
+    {
+        ss << " to port " << threat_data.destination_port();
+    }
+    
+    if (threat_data.scan_type() != threat::scan_type_none)
+    {
+        ss << " " << threat_data.scan_type_string();
+    }
+    
+    auto comment = ss.str();
+    
+    std::size_t block_length =
+        28 + pad4(captured_length) + 4 + pad4(comment.size()) + 4 + 4
+    ;
+    
+    if (block_length > m_segment_size / 2)
+    {
+        records_dropped_++;
+        
+        return;
+    }
+    
+    /**
+     * Rotate when the block does not fit.
+     */
+    if (m_offset + block_length > m_segment_size)
+    {
+        close_segment();
+        
+        open_segment();
+    }
+    
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds> (
+        threat_data.timestamp().time_since_epoch()
+    ).count();
+    
+    auto ptr = m_segment + m_offset;
+    
+    std::memset(ptr, 0, block_length);
+    
+    std::uint32_t val32 = block_type_enhanced_packet;
+    std::memcpy(ptr, &val32, 4);
+    val32 = static_cast<std::uint32_t> (block_length);
+    std::memcpy(ptr + 4, &val32, 4);
+    val32 = has_packet ? interface_packet : interface_payload;
+    std::memcpy(ptr + 8, &val32, 4);
+    val32 = static_cast<std::uint32_t> (microseconds >> 32);
+    std::memcpy(ptr + 12, &val32, 4);
+    val32 = static_cast<std::uint32_t> (microseconds);
+    std::memcpy(ptr + 16, &val32, 4);
+    val32 = static_cast<std::uint32_t> (captured_length);
+    std::memcpy(ptr + 20, &val32, 4);
+    std::memcpy(ptr + 24, &val32, 4);
+    
+    if (captured_length > 0)
+    {
+        std::memcpy(ptr + 28, data, captured_length);
+    }
+    
+    /**
+     * The opt_comment option followed by opt_endofopt.
+     */
+    auto options = ptr + 28 + pad4(captured_length);
+    
+    std::uint16_t val16 = 1;
+    std::memcpy(options, &val16, 2);
+    val16 = static_cast<std::uint16_t> (comment.size());
+    std::memcpy(options + 2, &val16, 2);
+    std::memcpy(options + 4, comment.data(), comment.size());
+    
+    val32 = static_cast<std::uint32_t> (block_length);
+    std::memcpy(ptr + block_length - 4, &val32, 4);
+    
+    m_offset += block_length;
+    
+    records_written_++;
+}
+
+void evidence_writer::append_block(
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    if (m_offset + len <= m_segment_size)
+    {
+        std::memcpy(m_segment + m_offset, buf, len);
+        
+        m_offset += len;
+    }
+}
@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <opensentinel/heavy_hitters.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/utility.hpp>
+
+using namespace opensentinel;
+
+/**
+ * Formats a source key.
+ * @param key The key.
+ */
+static std::string source_string(const std::uint8_t * key)
+{
+    asio::ip::address_v6::bytes_type bytes;
+    
+    std::memcpy(bytes.data(), key, bytes.size());
+    
+    asio::ip::address_v6 addr(bytes);
+    
+    if (addr.is_v4_mapped())
+    {
+        return addr.to_v4().to_string();
+    }
+    
+    return addr.to_string();
+}
+
+/**
+ * Formats a port key (protocol followed by the port).
+ * @param key The key.
+ */
+static std::string port_string(const std::uint8_t * key)
+{
+    std::string ret;
+    
+    switch (key[0])
+    {
+        case threat::protocol_tcp:
+        {
+            ret = "TCP/";
+        }
+        break;
+        case threat::protocol_udp:
+        {
+            ret = "UDP/";
+        }
+        break;
+        case threat::protocol_icmp:
+        {
+            ret = "ICMP/";
+        }
+        break;
+        default:
+        {
+            ret = "NONE/";
+        }
+        break;
+    }
+    
+    return ret + std::to_string((key[1] << 8) + key[2]);
+}
+
+/**
+ * Orders the heap by the lowest estimate first.
+ */
+template<typename T>
+static bool greater_count(const T & a, const T & b)
+{
+    return a.count > b.count;
+}
+
+heavy_hitters::sketch::sketch()
+    : m_counters(sketch_depth * sketch_width, 0)
+{
+    m_heap.reserve(top_k);
+}
+
+std::uint32_t heavy_hitters::sketch::add(
+    const std::uint64_t & hash, const std::uint8_t * key
+    )
+{
+    /**
+     * Each row is indexed by double hashing the one hash.
+     */
+    auto h1 = static_cast<std::uint32_t> (hash);
+    auto h2 = static_cast<std::uint32_t> (hash >> 32) | 1;
+    
+    std::uint32_t * counters[sketch_depth];
+    
+    auto estimate = std::numeric_limits<std::uint32_t>::max();
+    
+    for (std::uint32_t i = 0; i < sketch_depth; i++)
+    {
+        counters[i] = &m_counters[
+            i * sketch_width + ((h1 + i * h2) & (sketch_width - 1))
+        ];
+        
+        estimate = std::min(estimate, *counters[i]);
+    }
+    
+    if (estimate < std::numeric_limits<std::uint32_t>::max())
+    {
+        ++estimate;
+    }
+    
+    /**
+     * Conservative update, only the counters below the new estimate grow.
+     */
+    for (auto & i : counters)
+    {
+        *i = std::max(*i, estimate);
+    }
+    
+    /**
+     * Update the heap, the estimate only grows so an entry already in it
+     * is sifted back into place.
+     */
+    for (auto & i : m_heap)
+    {
+        if (i.hash == hash)
+        {
+            i.count = estimate;
+            
+            std::make_heap(
+                m_heap.begin(), m_heap.end(), greater_count<entry_t>
+            );
+            
+            return estimate;
+        }
+    }
+    
+    if (m_heap.size() < top_k || estimate > m_heap.front().count)
+    {
+        if (m_heap.size() == top_k)
+        {
+            std::pop_heap(
+                m_heap.begin(), m_heap.end(), greater_count<entry_t>
+            );
+            
+            m_heap.pop_back();
+        }
+        
+        entry_t entry;
+        
+        entry.hash = hash;
+        entry.count = estimate;
+        
+        std::memcpy(entry.key, key, sizeof(entry.key));
+        
+        m_heap.push_back(entry);
+        
+        std::push_heap(m_heap.begin(), m_heap.end(), greater_count<entry_t>);
+    }
+    
+    return estimate;
+}
+
+std::vector<heavy_hitters::entry_t> heavy_hitters::sketch::top() const
+{
+    auto ret = m_heap;
+    
+    std::sort(ret.begin(), ret.end(), greater_count<entry_t>);
+    
+    return ret;
+}
+
+void heavy_hitters::sketch::clear()
+{
+    std::fill(m_counters.begin(), m_counters.end(), 0);
+    
+    m_heap.clear();
+}
+
+std::size_t heavy_hitters::sketch::memory() const
+{
+    return
+        m_counters.size() * sizeof(std::uint32_t) +
+        m_heap.capacity() * sizeof(entry_t)
+    ;
+}
+
+heavy_hitters::heavy_hitters()
+    : m_threshold(0)
+    , m_interval(0)
+    , m_time_start()
+    , m_time_interval(0)
+    , m_events(0)
+    , m_summarized(0)
+    , m_unsummarized(0)
+{
+    m_summaries.reserve(top_k);
+}
+
+void heavy_hitters::start(
+    const std::uint32_t & threshold, const std::uint32_t & interval
+    )
+{
+    m_sources.clear();
+    m_ports.clear();
+    m_summaries.clear();
+    
+    m_threshold = threshold;
+    m_interval = std::max(1u, interval);
+    m_time_start = std::chrono::system_clock::time_point();
+    m_time_interval = 0;
+    m_events = 0;
+    m_summarized = 0;
+    m_unsummarized = 0;
+    
+    log_info(
+        "Heavy hitters are reported every " << m_interval << " seconds, "
+        "summarizing sources of " << m_threshold << " threats or more, in " <<
+        memory() / 1024 << " KiB."
+    );
+}
+
+void heavy_hitters::set_on_threat(const std::function<void (threat &)> & f)
+{
+    m_on_threat = f;
+}
+
+bool heavy_hitters::on_threat(const threat & val)
+{
+    /**
+     * Skip the flood threats this stage reported.
+     */
+    if (m_interval == 0 || val.scan_type() == threat::scan_type_flood)
+    {
+        return false;
+    }
+    
+    ++m_events;
+    
+    std::uint8_t address[16];
+    
+    auto hash = utility::hash_address(val.address(), address);
+    
+    auto estimate = m_sources.add(hash, address);
+    
+    std::uint8_t port[16] = { 0 };
+    
+    port[0] = static_cast<std::uint8_t> (val.protocol());
+    port[1] = static_cast<std::uint8_t> (val.destination_port() >> 8);
+    port[2] = static_cast<std::uint8_t> (val.destination_port());
+    
+    m_ports.add(
+        utility::mix(static_cast<std::uint64_t> (val.protocol()) << 16 |
+        val.destination_port()), port
+    );
+    
+    if (m_threshold == 0)
+    {
+        return false;
+    }
+    
+    summary_t * summary = nullptr;
+    
+    for (auto & i : m_summaries)
+    {
+        if (i.hash == hash)
+        {
+            summary = &i;
+            
+            break;
+        }
+    }
+    
+    if (summary == nullptr)
+    {
+        if (estimate < m_threshold)
+        {
+            return false;
+        }
+        else if (m_summaries.size() == top_k)
+        {
+            if (m_unsummarized++ == 0)
+            {
+                log_error(
+                    "Heavy hitters are summarizing " << top_k << " sources, "
+                    "the threats from " << val.address() << " are reported "
+                    "as usual."
+                );
+            }
+            
+            return false;
+        }
+        
+        log_info(
+            "Heavy hitters are summarizing the threats from " <<
+            val.address() << " after " << estimate << " threats."
+        );
+        
+        summary_t entry;
+        
+        std::memset(&entry, 0, sizeof(entry));
+        
+        entry.hash = hash;
+        
+        std::memcpy(entry.address, address, sizeof(address));
+        
+        m_summaries.push_back(entry);
+        
+        summary = &m_summaries.back();
+    }
+    
+    summary->events++;
+    summary->port = val.destination_port();
+    summary->protocol = static_cast<std::uint8_t> (val.protocol());
+    summary->level = std::max(
+        summary->level, static_cast<std::uint8_t> (val.level())
+    );
+    
+    ++m_summarized;
+    
+    return true;
+}
+
+void heavy_hitters::on_tick(
+    const std::chrono::system_clock::time_point & time
+    )
+{
+    if (m_interval == 0)
+    {
+        return;
+    }
+    
+    auto t = now(time);
+    
+    if (t >= m_time_interval + m_interval)
+    {
+        end_interval(t);
+    }
+}
+
+const std::uint64_t & heavy_hitters::summarized() const
+{
+    return m_summarized;
+}
+
+std::size_t heavy_hitters::memory() const
+{
+    return
+        m_sources.memory() + m_ports.memory() +
+        m_summaries.capacity() * sizeof(summary_t)
+    ;
+}
+
+std::uint32_t heavy_hitters::now(
+    const std::chrono::system_clock::time_point & time
+    )
+{
+    /**
+     * The clock starts at the first time seen, a replay runs on the
+     * recorded time.
+     */
+    if (m_time_start == std::chrono::system_clock::time_point())
+    {
+        m_time_start = time;
+    }
+    
+    if (time <= m_time_start)
+    {
+        return 0;
+    }
+    
+    return static_cast<std::uint32_t> (
+        std::chrono::duration_cast<std::chrono::seconds> (
+        time - m_time_start).count()
+    );
+}
+
+void heavy_hitters::end_interval(const std::uint32_t & time)
+{
+    auto elapsed = std::max(1u, time - m_time_interval);
+    
+    auto events = m_events;
+    auto unsummarized = m_unsummarized;
+    
+    /**
+     * Start the next interval first, reporting re-enters on_tick.
+     */
+    m_time_interval = time;
+    m_events = 0;
+    m_unsummarized = 0;
+    
+    if (unsummarized > 0)
+    {
+        log_error(
+            "Heavy hitters could not summarize " << unsummarized <<
+            " threats over the last " << elapsed << " seconds, at most " <<
+            top_k << " sources are summarized."
+        );
+    }
+    
+    if (events > 0)
+    {
+        std::stringstream ss;
+        
+        ss << "Heavy hitters over the last " << elapsed << " seconds (" <<
+            events << " threats), sources =";
+        
+        for (auto & i : m_sources.top())
+        {
+            ss << " " << source_string(i.key) << " (" << i.count << ")";
+        }
+        
+        ss << ", ports =";
+        
+        for (auto & i : m_ports.top())
+        {
+            ss << " " << port_string(i.key) << " (" << i.count << ")";
+        }
+        
+        log_info(ss.str() << ".");
+    }
+    
+    /**
+     * Report each summarized source once, a source that went quiet is
+     * reported on it's own again.
+     */
+    auto it = m_summaries.begin();
+    
+    while (it != m_summaries.end())
+    {
+        if (it->events == 0)
+        {
+            log_info(
+                "Heavy hitters stopped summarizing the threats from " <<
+                source_string(it->address) << "."
+            );
+            
+            it = m_summaries.erase(it);
+            
+            continue;
+        }
+        
+        asio::ip::address_v6::bytes_type bytes;
+        
+        std::memcpy(bytes.data(), it->address, bytes.size());
+        
+        threat threat_data(
+            static_cast<threat::protocol_t> (it->protocol),
+            asio::ip::address_v6(bytes), 0, 0, 0
+        );
+        
+        threat_data.set_destination_port(it->port);
+        threat_data.set_scan_type(threat::scan_type_flood);
+        threat_data.set_timestamp(m_time_start + std::chrono::seconds(time));
+        
+        threat_data.set_rate(
+            static_cast<double> (it->events) / elapsed
+        );
+        
+        threat_data.set_level(static_cast<threat::level_t> (it->level));
+        
+        it->events = 0;
+        it->level = 0;
+        
+        ++it;
+        
+        if (m_on_threat)
+        {
+            m_on_threat(threat_data);
+        }
+    }
+    
+    m_sources.clear();
+    m_ports.clear();
+}
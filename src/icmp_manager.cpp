@@ -18,10 +18,20 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if (defined __linux__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif // __linux__
+
+#include <cerrno>
+#include <cstring>
+
+#include <opensentinel/affinity.hpp>
 #include <opensentinel/icmp.hpp>
 #include <opensentinel/icmp_manager.hpp>
-#include <opensentinel/ipv4_header.hpp>
 #include <opensentinel/logger.hpp>
+#include <opensentinel/packet_view.hpp>
+#include <opensentinel/socket_filter.hpp>
 #include <opensentinel/stack_impl.hpp>
 #include <opensentinel/threat.hpp>
 
@@ -31,8 +41,10 @@ icmp_manager::icmp_manager(stack_impl & owner)
     : state_(state_none)
     , stack_impl_(owner)
     , strand_(io_service_)
-    , timer_(io_service_)
     , socket_ipv4_(io_service_)
+    , socket_ipv6_(io_service_)
+    , read_buffers_ipv4_(max_batch_size * max_length)
+    , read_buffers_ipv6_(max_batch_size * max_length)
 {
     // ...
 }
@@ -62,26 +74,101 @@ void icmp_manager::start()
     }
     else
     {
-        async_receive_ipv4();
-        
+#if (defined __linux__)
         /**
-         * Starts the timer.
+         * Drop every ICMP type other than echo requests and replies as
+         * the packet is queued so our own unreachables and the replies to
+         * other programs never wake the thread.
          */
-        timer_.expires_from_now(std::chrono::seconds(1));
-        timer_.async_wait(strand_.wrap([this](std::error_code ec)
+        socket_filter::attach_icmp_types(
+            socket_ipv4_.native_handle(), {
+            icmp::header::type_echo_request, icmp::header::type_echo_reply },
+            ec
+        );
+        
+        if (ec)
+        {
+            log_error(
+                "ICMP manager failed to set ICMP filter, message = " <<
+                ec.message() << "."
+            );
+        }
+        
+        try
         {
+            /**
+             * Only echo requests and replies from sources that are not
+             * allow-listed ever reach the reactor.
+             */
+            socket_filter_.compile(
+                stack_impl_.get_configuration(), socket_filter::type_icmp
+            );
+            
+            socket_filter_.attach(socket_ipv4_.native_handle(), ec);
+            
             if (ec)
             {
-                // ...
+                log_error(
+                    "ICMP manager failed to attach socket filter, "
+                    "message = " << ec.message() << "."
+                );
             }
-            else
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "ICMP manager failed to compile socket filter, what = " <<
+                e.what() << "."
+            );
+        }
+#endif // __linux__
+        
+        async_receive(socket_ipv4_);
+        
+        /**
+         * The ipv6 socket is optional, the host may not have ipv6.
+         */
+        socket_ipv6_.open(asio::ip::icmp::v6(), ec);
+        
+        if (ec)
+        {
+            log_error(
+                "ICMP manager failed to open ipv6 socket, message = " <<
+                ec.message() << "."
+            );
+        }
+        else
+        {
+#if (defined __linux__)
+            socket_filter::attach_icmpv6_types(
+                socket_ipv6_.native_handle(), {
+                icmp::header::type_echo_request_v6,
+                icmp::header::type_echo_reply_v6 }, ec
+            );
+            
+            if (ec)
             {
-                on_tick();
+                log_error(
+                    "ICMP manager failed to set ICMPv6 filter, message = " <<
+                    ec.message() << "."
+                );
             }
-        }));
-    
+#endif // __linux__
+            
+            async_receive(socket_ipv6_);
+        }
+        
+        /**
+         * Keep the std::thread running while the sockets are idle.
+         */
+        work_ = std::make_shared<asio::io_service::work> (io_service_);
+        
         thread_ = std::thread(&icmp_manager::run, this);
         
+        affinity::pin(
+            thread_, stack_impl_.get_configuration().cpus("icmp")
+        );
+        
         state_ = state_started;
         
         log_info("ICMP manager has started.");
@@ -95,15 +182,20 @@ void icmp_manager::stop()
     state_ = state_stopping;
     
     /**
-     * Cancel the timer.
+     * Let the std::thread exit once the sockets are closed.
      */
-    timer_.cancel();
+    work_ = nullptr;
     
     if (socket_ipv4_.is_open() == true)
     {
         socket_ipv4_.close();
     }
     
+    if (socket_ipv6_.is_open() == true)
+    {
+        socket_ipv6_.close();
+    }
+    
     if (thread_.joinable() == true)
     {
         thread_.join();
@@ -114,25 +206,6 @@ void icmp_manager::stop()
     log_info("ICMP manager has stopped.");
 }
 
-void icmp_manager::on_tick()
-{
-    /**
-     * Starts the timer.
-     */
-    timer_.expires_from_now(std::chrono::seconds(1));
-    timer_.async_wait(strand_.wrap([this](std::error_code ec)
-    {
-        if (ec)
-        {
-            // ...
-        }
-        else
-        {
-            on_tick();
-        }
-    }));
-}
-
 void icmp_manager::run()
 {
     while (state_ == state_starting || state_ == state_started)
@@ -153,81 +226,250 @@ void icmp_manager::run()
     log_info("ICMP manager thread has stopped.");
 }
 
-void icmp_manager::async_receive_ipv4()
+void icmp_manager::async_receive(asio::ip::icmp::socket & s)
 {
     if (state_ == state_starting || state_ == state_started)
     {
-        read_streambuf_ipv4_.consume(read_streambuf_ipv4_.size());
-
-        asio::ip::icmp::endpoint ep_ipv4;
+#if (defined __linux__)
+        /**
+         * Wait for readability only, the packets are read by recvmmsg.
+         */
+        s.async_receive(
+            asio::null_buffers(), strand_.wrap(
+            std::bind(&icmp_manager::handle_receive, this,
+            std::placeholders::_1, std::placeholders::_2, std::ref(s)))
+        );
+#else
+        auto is_v4 = &s == &socket_ipv4_;
         
-        socket_ipv4_.async_receive_from(
-            read_streambuf_ipv4_.prepare(65536), ep_ipv4,
-            strand_.wrap(std::bind(&icmp_manager::handle_receive_ipv4, this,
-            std::placeholders::_2))
+        s.async_receive_from(
+            asio::buffer(
+            is_v4 ? &read_buffers_ipv4_[0] : &read_buffers_ipv6_[0],
+            max_length), is_v4 ? remote_endpoint_ipv4_ : remote_endpoint_ipv6_,
+            strand_.wrap(std::bind(&icmp_manager::handle_receive, this,
+            std::placeholders::_1, std::placeholders::_2, std::ref(s)))
         );
+#endif // __linux__
     }
 }
 
-void icmp_manager::handle_receive_ipv4(const std::size_t & len)
+void icmp_manager::handle_receive(
+    const std::error_code & ec, const std::size_t & len,
+    asio::ip::icmp::socket & s
+    )
 {
     if (state_ == state_starting || state_ == state_started)
     {
-        read_streambuf_ipv4_.commit(len);
-
-        std::istream is(&read_streambuf_ipv4_);
-
-        ipv4_header ipv4_hdr;
-        icmp::header icmp_hdr;
-        is >> ipv4_hdr >> icmp_hdr;
-
-        log_info(
-            "ICMP manager got " << (len - ipv4_hdr.header_length()) <<
-            " bytes from " << ipv4_hdr.source_address() << ", seq = " <<
-            icmp_hdr.sequence_number() << ", ttl = " <<
-            ipv4_hdr.time_to_live() << ", code = " <<
-            static_cast<std::int32_t> (icmp_hdr.code()) << ", type = " <<
-            icmp_hdr.type_string()
-        );
+        auto is_v4 = &s == &socket_ipv4_;
         
-        /**
-         * Consider a PING to be a threat.
-         */
-        if (
-            icmp_hdr.type() == icmp::header::type_echo_request ||
-            icmp_hdr.type() == icmp::header::type_echo_reply
-            )
+        auto & buffers = is_v4 ? read_buffers_ipv4_ : read_buffers_ipv6_;
+        
+        if (ec)
         {
-            auto remote_endpoint =
-                asio::ip::tcp::endpoint(ipv4_hdr.source_address(), 0)
-            ;
-
-            /**
-             * Allocate the threat.
-             */
-            threat threat_data(
-                threat::protocol_icmp, remote_endpoint.address(),
-                remote_endpoint.port(), 0, 0
-            );
+            // ...
+        }
+        else
+        {
+#if (defined __linux__)
+            (void)len;
+            
+            struct mmsghdr msgs[max_batch_size];
+            struct iovec iovecs[max_batch_size];
+            struct sockaddr_in6 addrs[max_batch_size];
+            
+            std::memset(msgs, 0, sizeof(msgs));
+            
+            for (std::size_t i = 0; i < max_batch_size; i++)
+            {
+                iovecs[i].iov_base = &buffers[i * max_length];
+                iovecs[i].iov_len = max_length;
+                
+                msgs[i].msg_hdr.msg_iov = &iovecs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                
+                /**
+                 * The ipv6 packets arrive without the ipv6 header so the
+                 * source comes from the address.
+                 */
+                if (is_v4 == false)
+                {
+                    msgs[i].msg_hdr.msg_name = &addrs[i];
+                    msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+                }
+            }
             
             /**
-             * Set the level to threat::level_3.
+             * Drain up to max_batch_size packets per wakeup, only the
+             * headers are parsed so truncated packets are kept.
              */
-            threat_data.set_level(threat::level_3);
-
-            log_info(
-                "ICMP manager has detected a possible threat "
-                "(ICMP Receive) from " << remote_endpoint <<
-                ", dispatching to threat_manager."
+            auto count = recvmmsg(
+                s.native_handle(), msgs, max_batch_size, MSG_DONTWAIT, 0
             );
-
-            /**
-             * Callback
-             */
-            stack_impl_.on_threat(threat_data);
+            
+            for (auto i = 0; i < count; i++)
+            {
+                if (is_v4 == true)
+                {
+                    handle_packet_ipv4(
+                        &buffers[i * max_length], msgs[i].msg_len
+                    );
+                }
+                else
+                {
+                    asio::ip::address_v6::bytes_type bytes;
+                    
+                    std::memcpy(
+                        bytes.data(), &addrs[i].sin6_addr, bytes.size()
+                    );
+                    
+                    handle_packet_ipv6(
+                        asio::ip::address_v6(bytes, addrs[i].sin6_scope_id),
+                        &buffers[i * max_length], msgs[i].msg_len
+                    );
+                }
+            }
+            
+            if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                log_debug(
+                    "ICMP manager batch receive failed, message = " <<
+                    std::strerror(errno) << "."
+                );
+            }
+#else
+            if (is_v4 == true)
+            {
+                handle_packet_ipv4(&buffers[0], len);
+            }
+            else
+            {
+                handle_packet_ipv6(
+                    remote_endpoint_ipv6_.address().to_v6(), &buffers[0], len
+                );
+            }
+#endif // __linux__
         }
         
-        async_receive_ipv4();
+        async_receive(s);
+    }
+}
+
+void icmp_manager::handle_packet_ipv4(
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    /**
+     * Parse the headers in place from the receive buffer.
+     */
+    ipv4_view ipv4_hdr(buf, len);
+    
+    if (ipv4_hdr.valid() == false)
+    {
+        return;
+    }
+    
+    icmp_view icmp_hdr(ipv4_hdr.payload(), len - ipv4_hdr.header_length());
+    
+    if (icmp_hdr.valid() == false)
+    {
+        return;
+    }
+    
+    log_info(
+        "ICMP manager got " << (len - ipv4_hdr.header_length()) <<
+        " bytes from " << ipv4_hdr.source_address() << ", seq = " <<
+        icmp_hdr.sequence_number() << ", ttl = " <<
+        static_cast<std::int32_t> (ipv4_hdr.time_to_live()) <<
+        ", code = " << static_cast<std::int32_t> (icmp_hdr.code()) <<
+        ", type = " << icmp::header::type_string(icmp_hdr.type())
+    );
+    
+    /**
+     * Consider a PING to be a threat.
+     */
+    if (
+        icmp_hdr.type() == icmp::header::type_echo_request ||
+        icmp_hdr.type() == icmp::header::type_echo_reply
+        )
+    {
+        auto remote_endpoint =
+            asio::ip::tcp::endpoint(ipv4_hdr.source_address(), 0)
+        ;
+        
+        /**
+         * Allocate the threat.
+         */
+        threat threat_data(
+            threat::protocol_icmp, remote_endpoint.address(),
+            remote_endpoint.port(), 0, 0
+        );
+        
+        /**
+         * Set the level to threat::level_3.
+         */
+        threat_data.set_level(threat::level_3);
+        
+        threat_data.set_destination_address(ipv4_hdr.destination_address());
+
+        log_info(
+            "ICMP manager has detected a possible threat "
+            "(ICMP Receive) from " << remote_endpoint <<
+            ", dispatching to threat_manager."
+        );
+
+        /**
+         * Callback
+         */
+        stack_impl_.on_threat(threat_data);
     }
 }
 
+void icmp_manager::handle_packet_ipv6(
+    const asio::ip::address_v6 & addr, const std::uint8_t * buf,
+    const std::size_t & len
+    )
+{
+    icmp_view icmp_hdr(buf, len);
+    
+    if (icmp_hdr.valid() == false)
+    {
+        return;
+    }
+    
+    log_info(
+        "ICMP manager got " << len << " bytes from " << addr <<
+        ", seq = " << icmp_hdr.sequence_number() << ", code = " <<
+        static_cast<std::int32_t> (icmp_hdr.code()) << ", type = " <<
+        icmp::header::type_string(icmp_hdr.type())
+    );
+    
+    /**
+     * Consider a PING to be a threat.
+     */
+    if (
+        icmp_hdr.type() == icmp::header::type_echo_request_v6 ||
+        icmp_hdr.type() == icmp::header::type_echo_reply_v6
+        )
+    {
+        /**
+         * Allocate the threat.
+         */
+        threat threat_data(threat::protocol_icmp, addr, 0, 0, 0);
+        
+        /**
+         * Set the level to threat::level_3.
+         */
+        threat_data.set_level(threat::level_3);
+        
+        log_info(
+            "ICMP manager has detected a possible threat "
+            "(ICMPv6 Receive) from " << addr <<
+            ", dispatching to threat_manager."
+        );
+        
+        /**
+         * Callback
+         */
+        stack_impl_.on_threat(threat_data);
+    }
+}
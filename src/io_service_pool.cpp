@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/io_service_pool.hpp>
+#include <opensentinel/logger.hpp>
+
+using namespace opensentinel;
+
+io_service_pool::io_service_pool()
+    : state_(state_none)
+{
+    // ...
+}
+
+void io_service_pool::start(
+    const std::size_t & size, const std::vector<std::uint32_t> & cpus
+    )
+{
+    state_ = state_starting;
+    
+    for (std::size_t i = 0; i < size; i++)
+    {
+        auto ios = std::make_shared<asio::io_service> ();
+        
+        io_services_.push_back(ios);
+        
+        io_service_works_.push_back(
+            std::make_shared<asio::io_service::work> (*ios)
+        );
+    }
+    
+    for (std::size_t i = 0; i < size; i++)
+    {
+        threads_.push_back(std::thread(&io_service_pool::run, this, i));
+        
+        if (cpus.empty() == false)
+        {
+            affinity::pin(
+                threads_.back(), std::vector<std::uint32_t> (
+                1, cpus[i % cpus.size()])
+            );
+        }
+    }
+    
+    state_ = state_started;
+    
+    log_info("IO service pool started " << size << " threads.");
+}
+
+void io_service_pool::stop()
+{
+    state_ = state_stopping;
+    
+    /**
+     * Let the threads exit once the pending handlers have run.
+     */
+    io_service_works_.clear();
+    
+    for (auto & i : threads_)
+    {
+        if (i.joinable() == true)
+        {
+            i.join();
+        }
+    }
+    
+    threads_.clear();
+    
+    state_ = state_stopped;
+}
+
+std::size_t io_service_pool::size() const
+{
+    return io_services_.size();
+}
+
+asio::io_service & io_service_pool::get_io_service(const std::size_t & index)
+{
+    if (index >= io_services_.size())
+    {
+        throw std::runtime_error("invalid index");
+    }
+    
+    return *io_services_[index];
+}
+
+void io_service_pool::run(const std::size_t & index)
+{
+    while (state_ == state_starting || state_ == state_started)
+    {
+        try
+        {
+            io_services_[index]->run();
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "IO service pool thread caught exception, what = " <<
+                e.what() << "."
+            );
+        }
+    }
+    
+    log_debug("IO service pool thread " << index << " has stopped.");
+}
@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#if (defined __GNUC__ && (defined __x86_64__ || defined __i386__))
+#define USE_PREFILTER_SIMD 1
+#include <immintrin.h>
+#endif // __GNUC__
+
+#include <opensentinel/literal_prefilter.hpp>
+#include <opensentinel/logger.hpp>
+
+using namespace opensentinel;
+
+literal_prefilter::literal_prefilter()
+    : m_enabled(false)
+    , m_isa(isa_scalar)
+    , m_masked(false)
+    , m_max_offset(0)
+{
+    for (auto & i : m_masks)
+    {
+        i.fill(0);
+    }
+    
+#if (defined USE_PREFILTER_SIMD && USE_PREFILTER_SIMD)
+    __builtin_cpu_init();
+    
+    if (__builtin_cpu_supports("avx2"))
+    {
+        m_isa = isa_avx2;
+    }
+    else if (__builtin_cpu_supports("ssse3"))
+    {
+        m_isa = isa_ssse3;
+    }
+#endif // USE_PREFILTER_SIMD
+}
+
+void literal_prefilter::compile(const std::vector<std::string> & patterns)
+{
+    m_enabled = false;
+    m_masked = false;
+    m_max_offset = 0;
+    
+    for (auto & i : m_masks)
+    {
+        i.fill(0);
+    }
+    
+    m_anchors.reset();
+    m_bytes.reset();
+    
+    std::vector<std::uint16_t> anchors;
+    std::vector<std::uint8_t> bytes;
+    
+    for (auto & i : patterns)
+    {
+        /**
+         * A single byte pattern is it's own anchor.
+         */
+        if (i.size() == 1)
+        {
+            bytes.push_back(static_cast<std::uint8_t> (i[0]));
+            
+            continue;
+        }
+        else if (i.empty())
+        {
+            continue;
+        }
+        
+        /**
+         * Use the rarest byte pair, the earliest one on a tie.
+         */
+        std::size_t offset = 0;
+        
+        auto best = std::numeric_limits<std::uint32_t>::max();
+        
+        for (std::size_t j = 0; j + 1 < i.size(); j++)
+        {
+            auto score =
+                frequency(static_cast<std::uint8_t> (i[j])) +
+                frequency(static_cast<std::uint8_t> (i[j + 1]))
+            ;
+            
+            if (score < best)
+            {
+                best = score;
+                offset = j;
+            }
+        }
+        
+        m_max_offset = std::max(m_max_offset, offset);
+        
+        anchors.push_back(static_cast<std::uint16_t> (
+            static_cast<std::uint8_t> (i[offset]) << 8 |
+            static_cast<std::uint8_t> (i[offset + 1]))
+        );
+    }
+    
+    std::sort(anchors.begin(), anchors.end());
+    
+    anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+    
+    std::sort(bytes.begin(), bytes.end());
+    
+    bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+    
+    if (anchors.empty() && bytes.empty())
+    {
+        return;
+    }
+    
+    for (auto & i : anchors)
+    {
+        m_anchors.set(i);
+    }
+    
+    for (auto & i : bytes)
+    {
+        m_bytes.set(i);
+    }
+    
+    m_enabled = true;
+    
+    /**
+     * Too many anchors would set every bucket of the masks, the exact
+     * lookup of the scalar loop still skips to the first anchor.
+     */
+    m_masked = anchors.size() + bytes.size() <= max_anchors;
+    
+    if (m_masked == true)
+    {
+        for (std::size_t i = 0; i < anchors.size() + bytes.size(); i++)
+        {
+            auto bucket = static_cast<std::uint8_t> (1 << (i % 8));
+            
+            if (i < anchors.size())
+            {
+                auto first = anchors[i] >> 8;
+                auto second = anchors[i] & 0xff;
+                
+                m_masks[0][first & 0x0f] |= bucket;
+                m_masks[1][first >> 4] |= bucket;
+                m_masks[2][second & 0x0f] |= bucket;
+                m_masks[3][second >> 4] |= bucket;
+            }
+            else
+            {
+                auto first = bytes[i - anchors.size()];
+                
+                m_masks[0][first & 0x0f] |= bucket;
+                m_masks[1][first >> 4] |= bucket;
+                
+                /**
+                 * Any second byte.
+                 */
+                for (std::size_t j = 0; j < 16; j++)
+                {
+                    m_masks[2][j] |= bucket;
+                    m_masks[3][j] |= bucket;
+                }
+            }
+        }
+    }
+    
+    log_debug(
+        "Literal prefilter is using " << anchors.size() + bytes.size() <<
+        " anchors (" << isa() << ")."
+    );
+}
+
+const bool & literal_prefilter::enabled() const
+{
+    return m_enabled;
+}
+
+std::size_t literal_prefilter::find(
+    const char * buf, const std::size_t & len
+    ) const
+{
+    if (m_enabled == false)
+    {
+        return 0;
+    }
+    
+    const auto * ptr = reinterpret_cast<const std::uint8_t *> (buf);
+    
+    std::size_t ret = len;
+    
+    switch (m_masked == true ? m_isa : isa_scalar)
+    {
+        case isa_avx2:
+        {
+            ret = find_avx2(ptr, len);
+        }
+        break;
+        case isa_ssse3:
+        {
+            ret = find_ssse3(ptr, len);
+        }
+        break;
+        default:
+        {
+            ret = find_scalar(ptr, 0, len);
+        }
+        break;
+    }
+    
+    if (ret == len)
+    {
+        return len;
+    }
+    
+    /**
+     * The pattern the anchor belongs to may start before it.
+     */
+    return ret > m_max_offset ? ret - m_max_offset : 0;
+}
+
+const char * literal_prefilter::isa() const
+{
+    switch (m_masked == true ? m_isa : isa_scalar)
+    {
+        case isa_avx2:
+        {
+            return "avx2";
+        }
+        break;
+        case isa_ssse3:
+        {
+            return "ssse3";
+        }
+        break;
+        default:
+        break;
+    }
+    
+    return "scalar";
+}
+
+std::uint32_t literal_prefilter::frequency(const std::uint8_t & val)
+{
+    if ((val >= 'a' && val <= 'z') || val == ' ')
+    {
+        return 8;
+    }
+    else if (
+        val == '\r' || val == '\n' || val == '/' || val == '.' ||
+        val == ':' || val == '-' || val == '=' || val == '&' || val == 0x00 ||
+        val == 0xff
+        )
+    {
+        return 6;
+    }
+    else if ((val >= 'A' && val <= 'Z') || (val >= '0' && val <= '9'))
+    {
+        return 5;
+    }
+    else if (val >= 0x20 && val < 0x7f)
+    {
+        return 3;
+    }
+    
+    /**
+     * Any other byte is about as likely as the next in encrypted payloads.
+     */
+    return 2;
+}
+
+std::size_t literal_prefilter::find_scalar(
+    const std::uint8_t * buf, std::size_t offset, const std::size_t & len
+    ) const
+{
+    for (; offset + 1 < len; offset++)
+    {
+        if (
+            m_bytes.test(buf[offset]) ||
+            m_anchors.test(buf[offset] << 8 | buf[offset + 1])
+            )
+        {
+            return offset;
+        }
+    }
+    
+    /**
+     * The last byte can only be a single byte pattern.
+     */
+    if (offset < len && m_bytes.test(buf[offset]))
+    {
+        return offset;
+    }
+    
+    return len;
+}
+
+#if (defined USE_PREFILTER_SIMD && USE_PREFILTER_SIMD)
+__attribute__((target("ssse3")))
+#endif // USE_PREFILTER_SIMD
+std::size_t literal_prefilter::find_ssse3(
+    const std::uint8_t * buf, const std::size_t & len
+    ) const
+{
+    std::size_t offset = 0;
+    
+#if (defined USE_PREFILTER_SIMD && USE_PREFILTER_SIMD)
+    const auto lo1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[0].data())
+    );
+    const auto hi1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[1].data())
+    );
+    const auto lo2 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[2].data())
+    );
+    const auto hi2 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[3].data())
+    );
+    const auto nibble = _mm_set1_epi8(0x0f);
+    const auto zero = _mm_setzero_si128();
+    
+    /**
+     * The second anchor byte of the last lane is read from the next block.
+     */
+    for (; offset + 17 <= len; offset += 16)
+    {
+        auto v1 = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *> (buf + offset)
+        );
+        auto v2 = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *> (buf + offset + 1)
+        );
+        
+        auto r = _mm_and_si128(
+            _mm_and_si128(
+            _mm_shuffle_epi8(lo1, _mm_and_si128(v1, nibble)),
+            _mm_shuffle_epi8(hi1, _mm_and_si128(_mm_srli_epi16(v1, 4), nibble))),
+            _mm_and_si128(
+            _mm_shuffle_epi8(lo2, _mm_and_si128(v2, nibble)),
+            _mm_shuffle_epi8(hi2, _mm_and_si128(_mm_srli_epi16(v2, 4), nibble)))
+        );
+        
+        auto mask = static_cast<std::uint32_t> (
+            ~_mm_movemask_epi8(_mm_cmpeq_epi8(r, zero)) & 0xffff
+        );
+        
+        while (mask)
+        {
+            auto i = offset + __builtin_ctz(mask);
+            
+            if (
+                m_bytes.test(buf[i]) ||
+                m_anchors.test(buf[i] << 8 | buf[i + 1])
+                )
+            {
+                return i;
+            }
+            
+            mask &= mask - 1;
+        }
+    }
+#endif // USE_PREFILTER_SIMD
+
+    return find_scalar(buf, offset, len);
+}
+
+#if (defined USE_PREFILTER_SIMD && USE_PREFILTER_SIMD)
+__attribute__((target("avx2")))
+#endif // USE_PREFILTER_SIMD
+std::size_t literal_prefilter::find_avx2(
+    const std::uint8_t * buf, const std::size_t & len
+    ) const
+{
+    std::size_t offset = 0;
+    
+#if (defined USE_PREFILTER_SIMD && USE_PREFILTER_SIMD)
+    /**
+     * The shuffles work per 128-bit lane, so both lanes get the masks.
+     */
+    const auto lo1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[0].data()))
+    );
+    const auto hi1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[1].data()))
+    );
+    const auto lo2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[2].data()))
+    );
+    const auto hi2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *> (m_masks[3].data()))
+    );
+    const auto nibble = _mm256_set1_epi8(0x0f);
+    const auto zero = _mm256_setzero_si256();
+    
+    for (; offset + 33 <= len; offset += 32)
+    {
+        auto v1 = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *> (buf + offset)
+        );
+        auto v2 = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *> (buf + offset + 1)
+        );
+        
+        auto r = _mm256_and_si256(
+            _mm256_and_si256(
+            _mm256_shuffle_epi8(lo1, _mm256_and_si256(v1, nibble)),
+            _mm256_shuffle_epi8(
+            hi1, _mm256_and_si256(_mm256_srli_epi16(v1, 4), nibble))),
+            _mm256_and_si256(
+            _mm256_shuffle_epi8(lo2, _mm256_and_si256(v2, nibble)),
+            _mm256_shuffle_epi8(
+            hi2, _mm256_and_si256(_mm256_srli_epi16(v2, 4), nibble)))
+        );
+        
+        auto mask = ~static_cast<std::uint32_t> (
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(r, zero))
+        );
+        
+        while (mask)
+        {
+            auto i = offset + __builtin_ctz(mask);
+            
+            if (
+                m_bytes.test(buf[i]) ||
+                m_anchors.test(buf[i] << 8 | buf[i + 1])
+                )
+            {
+                return i;
+            }
+            
+            mask &= mask - 1;
+        }
+    }
+#endif // USE_PREFILTER_SIMD
+
+    return find_ssse3(buf + offset, len - offset) + offset;
+}
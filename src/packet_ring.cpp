@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if (defined __linux__)
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/packet_ring.hpp>
+#include <opensentinel/socket_filter.hpp>
+
+using namespace opensentinel;
+
+packet_ring::packet_ring()
+    : m_socket(-1)
+    , m_ring(nullptr)
+    , m_block_size(0)
+    , m_block_count(0)
+    , m_block_index(0)
+    , m_frames_received(0)
+    , m_frames_dropped(0)
+{
+    // ...
+}
+
+packet_ring::~packet_ring()
+{
+    close();
+}
+
+void packet_ring::open(
+    const std::string & interface_name, const std::uint32_t & block_size,
+    const std::uint32_t & block_count, const std::uint16_t & fanout_group
+    )
+{
+#if (defined __linux__)
+    assert(m_socket == -1);
+    
+    /**
+     * The frame size must divide the block size evenly.
+     */
+    enum { frame_size = 2048 };
+    
+    if (block_size < frame_size || block_size % getpagesize() != 0)
+    {
+        throw std::runtime_error("invalid block size");
+    }
+    
+    auto index = if_nametoindex(interface_name.c_str());
+    
+    if (index == 0)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_socket = ::socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    
+    if (m_socket < 0)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    try
+    {
+        int version = TPACKET_V3;
+        
+        if (
+            setsockopt(m_socket, SOL_PACKET, PACKET_VERSION, &version,
+            sizeof(version)) < 0
+            )
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        
+        /**
+         * Attach the socket_filter before binding so ignored traffic never
+         * takes up space in the ring.
+         */
+        if (m_socket_filter != nullptr)
+        {
+            std::error_code ec;
+            
+            m_socket_filter->attach(m_socket, ec);
+            
+            if (ec)
+            {
+                log_error(
+                    "Packet ring failed to attach socket filter, message = " <<
+                    ec.message() << "."
+                );
+            }
+        }
+        
+        /**
+         * Blocks are retired to user space when full or after 60
+         * milliseconds, whichever comes first.
+         */
+        struct tpacket_req3 req;
+        
+        std::memset(&req, 0, sizeof(req));
+        
+        req.tp_block_size = block_size;
+        req.tp_block_nr = block_count;
+        req.tp_frame_size = frame_size;
+        req.tp_frame_nr = (block_size * block_count) / frame_size;
+        req.tp_retire_blk_tov = 60;
+        req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+        
+        if (
+            setsockopt(m_socket, SOL_PACKET, PACKET_RX_RING, &req,
+            sizeof(req)) < 0
+            )
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        
+        auto ptr = mmap(
+            0, static_cast<std::size_t> (block_size) * block_count,
+            PROT_READ | PROT_WRITE, MAP_SHARED, m_socket, 0
+        );
+        
+        if (ptr == MAP_FAILED)
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        
+        m_ring = static_cast<std::uint8_t *> (ptr);
+        m_block_size = block_size;
+        m_block_count = block_count;
+        m_block_index = 0;
+        
+        struct sockaddr_ll addr;
+        
+        std::memset(&addr, 0, sizeof(addr));
+        
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+        addr.sll_ifindex = index;
+        
+        if (
+            bind(m_socket, reinterpret_cast<struct sockaddr *> (&addr),
+            sizeof(addr)) < 0
+            )
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        
+        /**
+         * The group can only be joined once the socket is bound.
+         */
+        if (fanout_group > 0)
+        {
+            join_fanout_group(fanout_group);
+        }
+    }
+    catch (...)
+    {
+        close();
+        
+        throw;
+    }
+    
+    log_info(
+        "Packet ring opened on " << interface_name << ", blocks = " <<
+        block_count << ", block size = " << block_size << ", fanout group = " <<
+        fanout_group << "."
+    );
+#else
+    throw std::runtime_error("packet ring is not supported on this platform");
+#endif // __linux__
+}
+
+void packet_ring::set_socket_filter(
+    const std::shared_ptr<socket_filter> & val
+    )
+{
+    m_socket_filter = val;
+}
+
+void packet_ring::close()
+{
+#if (defined __linux__)
+    if (m_ring != nullptr)
+    {
+        munmap(m_ring, static_cast<std::size_t> (m_block_size) * m_block_count);
+        
+        m_ring = nullptr;
+    }
+    
+    if (m_socket >= 0)
+    {
+        ::close(m_socket);
+        
+        m_socket = -1;
+    }
+#endif // __linux__
+}
+
+bool packet_ring::is_open() const
+{
+    return m_socket >= 0 && m_ring != nullptr;
+}
+
+std::size_t packet_ring::poll(
+    const std::int32_t & timeout_ms,
+    const std::function<void (const std::uint8_t *,
+    const std::size_t &)> & f
+    )
+{
+    std::size_t ret = 0;
+#if (defined __linux__)
+    if (is_open() == false)
+    {
+        return ret;
+    }
+    
+    auto block = reinterpret_cast<struct tpacket_block_desc *> (
+        m_ring + static_cast<std::size_t> (m_block_index) * m_block_size
+    );
+    
+    /**
+     * Only sleep in the kernel if the next block is not ready.
+     */
+    if ((block->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+    {
+        struct pollfd pfd;
+        
+        pfd.fd = m_socket;
+        pfd.events = POLLIN | POLLERR;
+        pfd.revents = 0;
+        
+        ::poll(&pfd, 1, timeout_ms);
+        
+        if ((block->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+        {
+            return ret;
+        }
+    }
+    
+    /**
+     * Make sure the frames are read after the block status.
+     */
+    __sync_synchronize();
+    
+    auto frames = block->hdr.bh1.num_pkts;
+    
+    auto hdr = reinterpret_cast<struct tpacket3_hdr *> (
+        reinterpret_cast<std::uint8_t *> (block) +
+        block->hdr.bh1.offset_to_first_pkt
+    );
+    
+    for (std::uint32_t i = 0; i < frames; i++)
+    {
+        auto ll = reinterpret_cast<struct sockaddr_ll *> (
+            reinterpret_cast<std::uint8_t *> (hdr) +
+            TPACKET_ALIGN(sizeof(struct tpacket3_hdr))
+        );
+        
+        /**
+         * Skip our own outgoing frames.
+         */
+        if (ll->sll_pkttype != PACKET_OUTGOING)
+        {
+            f(reinterpret_cast<std::uint8_t *> (hdr) + hdr->tp_mac,
+                hdr->tp_snaplen
+            );
+        }
+        
+        hdr = reinterpret_cast<struct tpacket3_hdr *> (
+            reinterpret_cast<std::uint8_t *> (hdr) + hdr->tp_next_offset
+        );
+    }
+    
+    ret = frames;
+    
+    m_frames_received += frames;
+    
+    /**
+     * Hand the block back to the kernel.
+     */
+    __sync_synchronize();
+    
+    block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    
+    m_block_index = (m_block_index + 1) % m_block_count;
+#endif // __linux__
+    return ret;
+}
+
+void packet_ring::join_fanout_group(const std::uint16_t & fanout_group)
+{
+#if (defined __linux__)
+    /**
+     * Return the (low word of the) source address so every frame from a
+     * given source lands on the same member, the kernel takes the result
+     * modulo the number of members.
+     */
+    static struct sock_filter g_source_hash[] =
+    {
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0,
+            static_cast<std::uint32_t> (SKF_AD_OFF + SKF_AD_PROTOCOL) },
+        { BPF_JMP | BPF_JEQ | BPF_K, 1, 0, ETH_P_IP },
+        { BPF_JMP | BPF_JEQ | BPF_K, 2, 4, ETH_P_IPV6 },
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0,
+            static_cast<std::uint32_t> (SKF_NET_OFF + 12) },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0,
+            static_cast<std::uint32_t> (SKF_NET_OFF + 20) },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+        { BPF_RET | BPF_K, 0, 0, 0 },
+    };
+    
+    int val = fanout_group | (PACKET_FANOUT_CBPF << 16);
+    
+    if (setsockopt(m_socket, SOL_PACKET, PACKET_FANOUT, &val, sizeof(val)) == 0)
+    {
+        struct sock_fprog prog;
+        
+        prog.len = sizeof(g_source_hash) / sizeof(g_source_hash[0]);
+        prog.filter = g_source_hash;
+        
+        if (
+            setsockopt(m_socket, SOL_PACKET, PACKET_FANOUT_DATA, &prog,
+            sizeof(prog)) < 0
+            )
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+    }
+    else
+    {
+        log_info(
+            "Packet ring failed to join fanout group " << fanout_group <<
+            " by source, falling back to flow hash, message = " <<
+            std::strerror(errno) << "."
+        );
+        
+        /**
+         * Older kernels only have the flow hash which may split the
+         * sources across members.
+         */
+        val =
+            fanout_group | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) <<
+            16)
+        ;
+        
+        if (
+            setsockopt(m_socket, SOL_PACKET, PACKET_FANOUT, &val,
+            sizeof(val)) < 0
+            )
+        {
+            throw std::runtime_error(std::strerror(errno));
+        }
+    }
+#endif // __linux__
+}
+
+const std::uint64_t & packet_ring::frames_received() const
+{
+    return m_frames_received;
+}
+
+std::uint64_t packet_ring::frames_dropped()
+{
+#if (defined __linux__)
+    if (m_socket >= 0)
+    {
+        struct tpacket_stats_v3 stats;
+        
+        socklen_t len = sizeof(stats);
+        
+        /**
+         * The kernel resets the counters on every read.
+         */
+        if (
+            getsockopt(m_socket, SOL_PACKET, PACKET_STATISTICS, &stats,
+            &len) == 0
+            )
+        {
+            m_frames_dropped += stats.tp_drops;
+        }
+    }
+#endif // __linux__
+    return m_frames_dropped;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/pcap_reader.hpp>
+
+using namespace opensentinel;
+
+/**
+ * The maximum length of a single record.
+ */
+enum { maximum_record_length = 262144 };
+
+pcap_reader::pcap_reader()
+    : m_big_endian(false)
+    , m_nanoseconds(false)
+    , m_link_type(0)
+    , m_snap_length(0)
+{
+    // ...
+}
+
+void pcap_reader::open(const std::string & path)
+{
+    m_ifstream.open(path, std::ios::in | std::ios::binary);
+    
+    if (m_ifstream.is_open() == false)
+    {
+        throw std::runtime_error("failed to open " + path);
+    }
+    
+    std::uint8_t buf[24];
+    
+    m_ifstream.read(reinterpret_cast<char *> (buf), sizeof(buf));
+    
+    if (m_ifstream.good() == false)
+    {
+        throw std::runtime_error("truncated pcap header");
+    }
+    
+    /**
+     * The magic number tells both the byte order and the timestamp
+     * resolution.
+     */
+    std::uint32_t magic =
+        buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+        (static_cast<std::uint32_t> (buf[3]) << 24)
+    ;
+    
+    switch (magic)
+    {
+        case 0xa1b2c3d4:
+        {
+            m_big_endian = false;
+            m_nanoseconds = false;
+        }
+        break;
+        case 0xd4c3b2a1:
+        {
+            m_big_endian = true;
+            m_nanoseconds = false;
+        }
+        break;
+        case 0xa1b23c4d:
+        {
+            m_big_endian = false;
+            m_nanoseconds = true;
+        }
+        break;
+        case 0x4d3cb2a1:
+        {
+            m_big_endian = true;
+            m_nanoseconds = true;
+        }
+        break;
+        default:
+        {
+            throw std::runtime_error("not a pcap file");
+        }
+        break;
+    }
+    
+    m_snap_length = read_uint32(buf + 16);
+    m_link_type = read_uint32(buf + 20) & 0xffff;
+    
+    log_debug(
+        "PCAP reader opened " << path << ", link type = " << m_link_type <<
+        ", snap length = " << m_snap_length << "."
+    );
+}
+
+void pcap_reader::close()
+{
+    if (m_ifstream.is_open() == true)
+    {
+        m_ifstream.close();
+    }
+}
+
+bool pcap_reader::read(std::chrono::nanoseconds & timestamp)
+{
+    std::uint8_t buf[16];
+    
+    m_ifstream.read(reinterpret_cast<char *> (buf), sizeof(buf));
+    
+    if (m_ifstream.good() == false)
+    {
+        return false;
+    }
+    
+    auto seconds = read_uint32(buf);
+    auto fraction = read_uint32(buf + 4);
+    auto captured_length = read_uint32(buf + 8);
+    
+    if (captured_length > maximum_record_length)
+    {
+        throw std::runtime_error("invalid pcap record length");
+    }
+    
+    timestamp =
+        std::chrono::seconds(seconds) + (m_nanoseconds ?
+        std::chrono::nanoseconds(fraction) :
+        std::chrono::nanoseconds(std::chrono::microseconds(fraction)))
+    ;
+    
+    m_data.resize(captured_length);
+    
+    if (captured_length > 0)
+    {
+        m_ifstream.read(reinterpret_cast<char *> (&m_data[0]), captured_length);
+        
+        /**
+         * A truncated last record, the capture was cut short.
+         */
+        if (m_ifstream.good() == false)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+const std::vector<std::uint8_t> & pcap_reader::data() const
+{
+    return m_data;
+}
+
+const std::uint32_t & pcap_reader::link_type() const
+{
+    return m_link_type;
+}
+
+std::uint32_t pcap_reader::read_uint32(const std::uint8_t * buf) const
+{
+    if (m_big_endian)
+    {
+        return
+            (static_cast<std::uint32_t> (buf[0]) << 24) | (buf[1] << 16) |
+            (buf[2] << 8) | buf[3]
+        ;
+    }
+    
+    return
+        (static_cast<std::uint32_t> (buf[3]) << 24) | (buf[2] << 16) |
+        (buf[1] << 8) | buf[0]
+    ;
+}
@@ -0,0 +1,1121 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+#include <opensentinel/regex_dfa.hpp>
+
+using namespace opensentinel;
+
+/**
+ * The maximum number of NFA states, bounds the copies made by nested
+ * repetitions.
+ */
+static const std::size_t g_max_nfa_states = 1 << 16;
+
+struct regex_dfa::node
+{
+    /**
+     * The types.
+     */
+    typedef enum type_s
+    {
+        type_empty,
+        type_set,
+        type_concatenation,
+        type_alternation,
+        type_repetition,
+    } type_t;
+    
+    /**
+     * Constructor
+     * @param val The type.
+     */
+    explicit node(const type_t & val)
+        : type(val)
+        , min(0)
+        , max(0)
+    {
+        // ...
+    }
+    
+    /**
+     * The type.
+     */
+    type_t type;
+    
+    /**
+     * The bytes matched (type_set).
+     */
+    std::bitset<256> set;
+    
+    /**
+     * The children.
+     */
+    std::vector< std::unique_ptr<node> > children;
+    
+    /**
+     * The minimum count (type_repetition).
+     */
+    std::uint32_t min;
+    
+    /**
+     * The maximum count, zero if unbounded (type_repetition).
+     */
+    std::uint32_t max;
+};
+
+regex_dfa::regex_dfa()
+    : m_class_count(1)
+    , m_transitions(1, 0)
+    , m_accepting(1, false)
+    , m_start(0)
+    , m_dead(0)
+    , m_anchored_start(true)
+    , m_anchored_end(false)
+{
+    /**
+     * Until compiled the start state is dead and nothing matches.
+     */
+    m_classes.fill(0);
+}
+
+void regex_dfa::compile(
+    const std::string & pattern, const bool & case_insensitive
+    )
+{
+    auto body = pattern;
+    
+    m_anchored_start = body.empty() == false && body[0] == '^';
+    
+    if (m_anchored_start == true)
+    {
+        body.erase(0, 1);
+    }
+    
+    /**
+     * A trailing $ anchors at the end unless it is escaped.
+     */
+    m_anchored_end = false;
+    
+    if (body.empty() == false && body.back() == '$')
+    {
+        std::size_t backslashes = 0;
+        
+        for (
+            auto i = body.size() - 1; i > 0 && body[i - 1] == '\\';
+            i--, backslashes++
+            )
+        {
+            // ...
+        }
+        
+        if (backslashes % 2 == 0)
+        {
+            m_anchored_end = true;
+            
+            body.pop_back();
+        }
+    }
+    
+    std::size_t pos = 0;
+    
+    auto root = parse_alternation(
+        body, pos, case_insensitive, m_anchored_start || m_anchored_end
+    );
+    
+    if (pos != body.size())
+    {
+        throw std::runtime_error(
+            "unexpected " + std::string(1, body[pos]) + " at " +
+            std::to_string(pos)
+        );
+    }
+    
+    /**
+     * Build the (Thompson) NFA.
+     */
+    std::vector<nfa_state_t> nfa;
+    std::vector< std::bitset<256> > sets;
+    
+    auto fragment = emit(*root, nfa, sets);
+    
+    auto nfa_start = fragment.first;
+    auto nfa_accept = fragment.second;
+    
+    /**
+     * Split the bytes into the classes no transition distinguishes.
+     */
+    m_classes.fill(0);
+    
+    m_class_count = 1;
+    
+    for (auto & i : sets)
+    {
+        std::map<std::pair<std::uint8_t, bool>, std::uint8_t> splits;
+        
+        std::uint32_t count = 0;
+        
+        std::array<std::uint8_t, 256> classes;
+        
+        for (auto j = 0; j < 256; j++)
+        {
+            auto key = std::make_pair(m_classes[j], i.test(j));
+            
+            auto it = splits.find(key);
+            
+            if (it == splits.end())
+            {
+                it = splits.insert(
+                    std::make_pair(key, static_cast<std::uint8_t> (count++))
+                ).first;
+            }
+            
+            classes[j] = it->second;
+        }
+        
+        m_classes = classes;
+        m_class_count = count;
+    }
+    
+    std::vector<std::uint8_t> representatives(m_class_count);
+    
+    for (auto i = 255; i >= 0; i--)
+    {
+        representatives[m_classes[i]] = static_cast<std::uint8_t> (i);
+    }
+    
+    /**
+     * The epsilon closure of a set of NFA states.
+     */
+    std::vector<std::uint32_t> stamps(nfa.size(), 0);
+    
+    std::uint32_t stamp = 0;
+    
+    auto closure = [&](std::vector<std::uint32_t> seeds)
+    {
+        ++stamp;
+        
+        std::vector<std::uint32_t> ret;
+        
+        while (seeds.empty() == false)
+        {
+            auto s = seeds.back();
+            
+            seeds.pop_back();
+            
+            if (stamps[s] == stamp)
+            {
+                continue;
+            }
+            
+            stamps[s] = stamp;
+            
+            ret.push_back(s);
+            
+            seeds.insert(
+                seeds.end(), nfa[s].epsilons.begin(), nfa[s].epsilons.end()
+            );
+        }
+        
+        std::sort(ret.begin(), ret.end());
+        
+        return ret;
+    };
+    
+    /**
+     * The subset construction, an unanchored pattern may start at any
+     * byte so the start state is part of every subset.
+     */
+    std::vector< std::vector<std::uint32_t> > subsets;
+    std::map<std::vector<std::uint32_t>, std::uint32_t> ids;
+    std::vector<std::uint32_t> transitions;
+    std::vector<bool> accepting;
+    
+    auto add_subset = [&](const std::vector<std::uint32_t> & val)
+    {
+        auto it = ids.find(val);
+        
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        
+        if (subsets.size() == max_states)
+        {
+            throw std::runtime_error(
+                "more than " + std::to_string(max_states) + " states"
+            );
+        }
+        
+        auto id = static_cast<std::uint32_t> (subsets.size());
+        
+        subsets.push_back(val);
+        
+        ids[val] = id;
+        
+        accepting.push_back(
+            std::binary_search(val.begin(), val.end(), nfa_accept)
+        );
+        
+        return id;
+    };
+    
+    add_subset(closure({ nfa_start }));
+    
+    for (std::size_t i = 0; i < subsets.size(); i++)
+    {
+        transitions.resize((i + 1) * m_class_count, 0);
+        
+        /**
+         * The search stops at the first accepting state, so it only needs
+         * to loop on itself.
+         */
+        if (accepting[i] == true && m_anchored_end == false)
+        {
+            std::fill(
+                transitions.begin() + i * m_class_count, transitions.end(),
+                static_cast<std::uint32_t> (i)
+            );
+            
+            continue;
+        }
+        
+        for (std::uint32_t c = 0; c < m_class_count; c++)
+        {
+            std::vector<std::uint32_t> seeds;
+            
+            if (m_anchored_start == false)
+            {
+                seeds.push_back(nfa_start);
+            }
+            
+            for (auto & j : subsets[i])
+            {
+                if (nfa[j].set >= 0 && sets[nfa[j].set].test(representatives[c]))
+                {
+                    seeds.push_back(nfa[j].next);
+                }
+            }
+            
+            /**
+             * The subsets vector may grow, index it again.
+             */
+            auto next = add_subset(closure(seeds));
+            
+            transitions[i * m_class_count + c] = next;
+        }
+    }
+    
+    /**
+     * Minimize by refining the accepting and non-accepting partition until
+     * no block's states disagree on the block of any transition.
+     */
+    auto state_count = subsets.size();
+    
+    std::vector<std::uint32_t> blocks(state_count);
+    
+    std::size_t block_count = 0;
+    
+    for (std::size_t i = 0; i < state_count; i++)
+    {
+        blocks[i] = accepting[i] ? 1 : 0;
+    }
+    
+    block_count = std::count(accepting.begin(), accepting.end(), true) > 0 ?
+        1 : 0;
+    block_count += std::count(accepting.begin(), accepting.end(), false) > 0 ?
+        1 : 0;
+    
+    while (true)
+    {
+        std::map<std::vector<std::uint32_t>, std::uint32_t> signatures;
+        
+        std::vector<std::uint32_t> refined(state_count);
+        
+        for (std::size_t i = 0; i < state_count; i++)
+        {
+            std::vector<std::uint32_t> signature(1, blocks[i]);
+            
+            for (std::uint32_t c = 0; c < m_class_count; c++)
+            {
+                signature.push_back(blocks[transitions[i * m_class_count + c]]);
+            }
+            
+            auto it = signatures.find(signature);
+            
+            if (it == signatures.end())
+            {
+                it = signatures.insert(
+                    std::make_pair(
+                    signature, static_cast<std::uint32_t> (signatures.size()))
+                ).first;
+            }
+            
+            refined[i] = it->second;
+        }
+        
+        blocks.swap(refined);
+        
+        if (signatures.size() == block_count)
+        {
+            break;
+        }
+        
+        block_count = signatures.size();
+    }
+    
+    m_transitions.assign(block_count * m_class_count, 0);
+    m_accepting.assign(block_count, false);
+    
+    for (std::size_t i = 0; i < state_count; i++)
+    {
+        for (std::uint32_t c = 0; c < m_class_count; c++)
+        {
+            m_transitions[blocks[i] * m_class_count + c] =
+                static_cast<std::uint16_t> (
+                blocks[transitions[i * m_class_count + c]])
+            ;
+        }
+        
+        m_accepting[blocks[i]] = accepting[i];
+    }
+    
+    m_start = static_cast<std::uint16_t> (blocks[0]);
+    
+    /**
+     * Only an anchored pattern can reach the empty subset.
+     */
+    auto it = ids.find(std::vector<std::uint32_t> ());
+    
+    m_dead = it == ids.end() ? -1 : static_cast<std::int32_t> (
+        blocks[it->second]
+    );
+}
+
+bool regex_dfa::search(const char * buf, const std::size_t & len) const
+{
+    std::uint32_t state = m_start;
+    
+    if (m_anchored_end == false && m_accepting[state] == true)
+    {
+        return true;
+    }
+    
+    const auto * transitions = m_transitions.data();
+    
+    for (std::size_t i = 0; i < len; i++)
+    {
+        state = transitions[
+            state * m_class_count + m_classes[static_cast<std::uint8_t> (buf[i])]
+        ];
+        
+        if (m_anchored_end == false && m_accepting[state] == true)
+        {
+            return true;
+        }
+        else if (static_cast<std::int32_t> (state) == m_dead)
+        {
+            return false;
+        }
+    }
+    
+    return m_accepting[state];
+}
+
+std::size_t regex_dfa::states() const
+{
+    return m_accepting.size();
+}
+
+std::size_t regex_dfa::classes() const
+{
+    return m_class_count;
+}
+
+std::size_t regex_dfa::table_size() const
+{
+    return m_transitions.size() * sizeof(std::uint16_t);
+}
+
+std::unique_ptr<regex_dfa::node> regex_dfa::parse_alternation(
+    const std::string & pattern, std::size_t & pos,
+    const bool & case_insensitive, const bool & anchored
+    )
+{
+    auto ret = parse_concatenation(pattern, pos, case_insensitive);
+    
+    if (pos < pattern.size() && pattern[pos] == '|')
+    {
+        /**
+         * The anchors bind to the whole pattern, not it's first and last
+         * alternative.
+         */
+        if (anchored == true)
+        {
+            throw std::runtime_error("anchors around | must be grouped");
+        }
+        
+        std::unique_ptr<node> alternation(new node(node::type_alternation));
+        
+        alternation->children.push_back(std::move(ret));
+        
+        while (pos < pattern.size() && pattern[pos] == '|')
+        {
+            ++pos;
+            
+            alternation->children.push_back(
+                parse_concatenation(pattern, pos, case_insensitive)
+            );
+        }
+        
+        ret = std::move(alternation);
+    }
+    
+    return ret;
+}
+
+std::unique_ptr<regex_dfa::node> regex_dfa::parse_concatenation(
+    const std::string & pattern, std::size_t & pos,
+    const bool & case_insensitive
+    )
+{
+    std::unique_ptr<node> ret(new node(node::type_concatenation));
+    
+    while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')')
+    {
+        ret->children.push_back(
+            parse_repetition(pattern, pos, case_insensitive)
+        );
+    }
+    
+    if (ret->children.empty())
+    {
+        return std::unique_ptr<node> (new node(node::type_empty));
+    }
+    else if (ret->children.size() == 1)
+    {
+        return std::move(ret->children[0]);
+    }
+    
+    return ret;
+}
+
+std::unique_ptr<regex_dfa::node> regex_dfa::parse_repetition(
+    const std::string & pattern, std::size_t & pos,
+    const bool & case_insensitive
+    )
+{
+    auto ret = parse_atom(pattern, pos, case_insensitive);
+    
+    if (pos >= pattern.size())
+    {
+        return ret;
+    }
+    
+    std::uint32_t min = 0, max = 0;
+    
+    switch (pattern[pos])
+    {
+        case '*':
+        {
+            min = 0;
+            max = 0;
+        }
+        break;
+        case '+':
+        {
+            min = 1;
+            max = 0;
+        }
+        break;
+        case '?':
+        {
+            min = 0;
+            max = 1;
+        }
+        break;
+        case '{':
+        {
+            auto end = pattern.find('}', pos);
+            
+            if (end == std::string::npos)
+            {
+                throw std::runtime_error("unterminated {");
+            }
+            
+            auto bounds = pattern.substr(pos + 1, end - pos - 1);
+            
+            auto comma = bounds.find(',');
+            
+            auto parse_count = [](const std::string & val)
+            {
+                if (
+                    val.empty() || val.size() > 3 ||
+                    std::all_of(val.begin(), val.end(), ::isdigit) == false
+                    )
+                {
+                    throw std::runtime_error("invalid repetition count");
+                }
+                
+                auto ret = static_cast<std::uint32_t> (std::stoul(val));
+                
+                if (ret > max_repeat)
+                {
+                    throw std::runtime_error("repetition count too large");
+                }
+                
+                return ret;
+            };
+            
+            if (comma == std::string::npos)
+            {
+                min = max = parse_count(bounds);
+            }
+            else
+            {
+                min = parse_count(bounds.substr(0, comma));
+                
+                max = comma + 1 == bounds.size() ? 0 :
+                    parse_count(bounds.substr(comma + 1))
+                ;
+            }
+            
+            if (max == 0 && comma == std::string::npos)
+            {
+                /**
+                 * x{0} matches the empty string only.
+                 */
+                pos = end + 1;
+                
+                return std::unique_ptr<node> (new node(node::type_empty));
+            }
+            else if (max > 0 && max < min)
+            {
+                throw std::runtime_error("invalid repetition range");
+            }
+            
+            pos = end;
+        }
+        break;
+        default:
+        {
+            return ret;
+        }
+        break;
+    }
+    
+    ++pos;
+    
+    /**
+     * A lazy quantifier matches the same set of strings.
+     */
+    if (pos < pattern.size() && pattern[pos] == '?')
+    {
+        ++pos;
+    }
+    
+    if (
+        pos < pattern.size() && (pattern[pos] == '*' ||
+        pattern[pos] == '+' || pattern[pos] == '?' || pattern[pos] == '{')
+        )
+    {
+        throw std::runtime_error("nothing to repeat");
+    }
+    
+    std::unique_ptr<node> repetition(new node(node::type_repetition));
+    
+    repetition->min = min;
+    repetition->max = max;
+    repetition->children.push_back(std::move(ret));
+    
+    return repetition;
+}
+
+std::unique_ptr<regex_dfa::node> regex_dfa::parse_atom(
+    const std::string & pattern, std::size_t & pos,
+    const bool & case_insensitive
+    )
+{
+    std::unique_ptr<node> ret(new node(node::type_set));
+    
+    auto c = pattern[pos++];
+    
+    switch (c)
+    {
+        case '(':
+        {
+            if (pos < pattern.size() && pattern[pos] == '?')
+            {
+                if (pos + 1 < pattern.size() && pattern[pos + 1] == ':')
+                {
+                    pos += 2;
+                }
+                else
+                {
+                    throw std::runtime_error("lookaround is not supported");
+                }
+            }
+            
+            ret = parse_alternation(pattern, pos, case_insensitive, false);
+            
+            if (pos >= pattern.size() || pattern[pos] != ')')
+            {
+                throw std::runtime_error("unterminated (");
+            }
+            
+            ++pos;
+            
+            return ret;
+        }
+        break;
+        case '[':
+        {
+            ret->set = parse_class(pattern, pos, case_insensitive);
+        }
+        break;
+        case '.':
+        {
+            ret->set.set();
+            ret->set.reset('\n');
+            ret->set.reset('\r');
+        }
+        break;
+        case '\\':
+        {
+            ret->set = parse_escape(pattern, pos, false);
+        }
+        break;
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+        {
+            throw std::runtime_error("nothing to repeat");
+        }
+        break;
+        case '^':
+        case '$':
+        {
+            throw std::runtime_error(
+                "anchors are only supported at the start and end"
+            );
+        }
+        break;
+        default:
+        {
+            ret->set.set(static_cast<std::uint8_t> (c));
+        }
+        break;
+    }
+    
+    if (case_insensitive == true)
+    {
+        fold_case(ret->set);
+    }
+    
+    return ret;
+}
+
+std::bitset<256> regex_dfa::parse_escape(
+    const std::string & pattern, std::size_t & pos, const bool & in_class
+    )
+{
+    std::bitset<256> ret;
+    
+    if (pos >= pattern.size())
+    {
+        throw std::runtime_error("trailing \\");
+    }
+    
+    auto c = pattern[pos++];
+    
+    switch (c)
+    {
+        case 'd':
+        case 'D':
+        {
+            for (auto i = '0'; i <= '9'; i++)
+            {
+                ret.set(i);
+            }
+        }
+        break;
+        case 'w':
+        case 'W':
+        {
+            for (auto i = 0; i < 256; i++)
+            {
+                if (std::isalnum(i) || i == '_')
+                {
+                    ret.set(i);
+                }
+            }
+        }
+        break;
+        case 's':
+        case 'S':
+        {
+            for (auto i : { ' ', '\t', '\n', '\v', '\f', '\r' })
+            {
+                ret.set(static_cast<std::uint8_t> (i));
+            }
+        }
+        break;
+        case 'x':
+        {
+            if (
+                pos + 1 < pattern.size() &&
+                std::isxdigit(static_cast<unsigned char> (pattern[pos])) &&
+                std::isxdigit(static_cast<unsigned char> (pattern[pos + 1]))
+                )
+            {
+                ret.set(std::stoul(pattern.substr(pos, 2), nullptr, 16));
+                
+                pos += 2;
+            }
+            else
+            {
+                throw std::runtime_error("invalid \\x escape");
+            }
+        }
+        break;
+        case 'r':
+        {
+            ret.set('\r');
+        }
+        break;
+        case 'n':
+        {
+            ret.set('\n');
+        }
+        break;
+        case 't':
+        {
+            ret.set('\t');
+        }
+        break;
+        case 'f':
+        {
+            ret.set('\f');
+        }
+        break;
+        case 'v':
+        {
+            ret.set('\v');
+        }
+        break;
+        case '0':
+        {
+            ret.set(0);
+        }
+        break;
+        case 'b':
+        {
+            if (in_class == false)
+            {
+                throw std::runtime_error("word boundaries are not supported");
+            }
+            
+            ret.set('\b');
+        }
+        break;
+        case 'B':
+        case 'u':
+        case 'c':
+        case 'k':
+        {
+            throw std::runtime_error(
+                "\\" + std::string(1, c) + " is not supported"
+            );
+        }
+        break;
+        default:
+        {
+            if (c >= '1' && c <= '9')
+            {
+                throw std::runtime_error("back-references are not supported");
+            }
+            
+            ret.set(static_cast<std::uint8_t> (c));
+        }
+        break;
+    }
+    
+    if (c == 'D' || c == 'W' || c == 'S')
+    {
+        ret.flip();
+    }
+    
+    return ret;
+}
+
+std::bitset<256> regex_dfa::parse_class(
+    const std::string & pattern, std::size_t & pos,
+    const bool & case_insensitive
+    )
+{
+    std::bitset<256> ret;
+    
+    auto negate = pos < pattern.size() && pattern[pos] == '^';
+    
+    if (negate == true)
+    {
+        ++pos;
+    }
+    
+    while (true)
+    {
+        if (pos >= pattern.size())
+        {
+            throw std::runtime_error("unterminated [");
+        }
+        
+        if (pattern[pos] == ']')
+        {
+            ++pos;
+            
+            break;
+        }
+        
+        /**
+         * A member is a single byte or (escaped) set of bytes.
+         */
+        auto member = [&]()
+        {
+            std::bitset<256> ret;
+            
+            if (pattern[pos] == '\\')
+            {
+                ++pos;
+                
+                ret = parse_escape(pattern, pos, true);
+            }
+            else
+            {
+                ret.set(static_cast<std::uint8_t> (pattern[pos++]));
+            }
+            
+            return ret;
+        };
+        
+        auto first = member();
+        
+        if (
+            pos + 1 < pattern.size() && pattern[pos] == '-' &&
+            pattern[pos + 1] != ']'
+            )
+        {
+            ++pos;
+            
+            auto last = member();
+            
+            /**
+             * A range between sets (\w-.) is taken literally.
+             */
+            if (first.count() != 1 || last.count() != 1)
+            {
+                ret |= first;
+                ret |= last;
+                ret.set('-');
+                
+                continue;
+            }
+            
+            std::size_t from = 0, to = 0;
+            
+            while (first.test(from) == false)
+            {
+                ++from;
+            }
+            
+            while (last.test(to) == false)
+            {
+                ++to;
+            }
+            
+            if (from > to)
+            {
+                throw std::runtime_error("invalid range in []");
+            }
+            
+            for (auto i = from; i <= to; i++)
+            {
+                ret.set(i);
+            }
+        }
+        else
+        {
+            ret |= first;
+        }
+    }
+    
+    if (case_insensitive == true)
+    {
+        fold_case(ret);
+    }
+    
+    if (negate == true)
+    {
+        ret.flip();
+    }
+    
+    return ret;
+}
+
+void regex_dfa::fold_case(std::bitset<256> & val)
+{
+    for (auto i = 'a'; i <= 'z'; i++)
+    {
+        auto upper = i - 'a' + 'A';
+        
+        if (val.test(i) || val.test(upper))
+        {
+            val.set(i);
+            val.set(upper);
+        }
+    }
+}
+
+std::pair<std::uint32_t, std::uint32_t> regex_dfa::emit(
+    const node & n, std::vector<nfa_state_t> & nfa,
+    std::vector< std::bitset<256> > & sets
+    )
+{
+    if (nfa.size() + 2 > g_max_nfa_states)
+    {
+        throw std::runtime_error("pattern is too large");
+    }
+    
+    auto add_state = [&nfa]()
+    {
+        nfa_state_t state;
+        
+        state.set = -1;
+        state.next = 0;
+        
+        nfa.push_back(state);
+        
+        return static_cast<std::uint32_t> (nfa.size() - 1);
+    };
+    
+    auto start = add_state();
+    auto end = add_state();
+    
+    switch (n.type)
+    {
+        case node::type_empty:
+        {
+            nfa[start].epsilons.push_back(end);
+        }
+        break;
+        case node::type_set:
+        {
+            nfa[start].set = static_cast<std::int32_t> (sets.size());
+            nfa[start].next = end;
+            
+            sets.push_back(n.set);
+        }
+        break;
+        case node::type_concatenation:
+        {
+            auto last = start;
+            
+            for (auto & i : n.children)
+            {
+                auto fragment = emit(*i, nfa, sets);
+                
+                nfa[last].epsilons.push_back(fragment.first);
+                
+                last = fragment.second;
+            }
+            
+            nfa[last].epsilons.push_back(end);
+        }
+        break;
+        case node::type_alternation:
+        {
+            for (auto & i : n.children)
+            {
+                auto fragment = emit(*i, nfa, sets);
+                
+                nfa[start].epsilons.push_back(fragment.first);
+                nfa[fragment.second].epsilons.push_back(end);
+            }
+        }
+        break;
+        case node::type_repetition:
+        {
+            const auto & child = *n.children[0];
+            
+            auto last = start;
+            
+            /**
+             * The required copies.
+             */
+            for (std::uint32_t i = 0; i < n.min; i++)
+            {
+                auto fragment = emit(child, nfa, sets);
+                
+                nfa[last].epsilons.push_back(fragment.first);
+                
+                last = fragment.second;
+            }
+            
+            if (n.max == 0)
+            {
+                /**
+                 * Any number of further copies.
+                 */
+                auto fragment = emit(child, nfa, sets);
+                
+                nfa[last].epsilons.push_back(fragment.first);
+                nfa[last].epsilons.push_back(end);
+                nfa[fragment.second].epsilons.push_back(last);
+            }
+            else
+            {
+                /**
+                 * The optional copies, each may be skipped to the end.
+                 */
+                for (auto i = n.min; i < n.max; i++)
+                {
+                    auto fragment = emit(child, nfa, sets);
+                    
+                    nfa[last].epsilons.push_back(fragment.first);
+                    nfa[last].epsilons.push_back(end);
+                    
+                    last = fragment.second;
+                }
+                
+                nfa[last].epsilons.push_back(end);
+            }
+        }
+        break;
+        default:
+        break;
+    }
+    
+    return std::make_pair(start, end);
+}
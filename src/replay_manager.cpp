@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/pcap_reader.hpp>
+#include <opensentinel/replay_manager.hpp>
+#include <opensentinel/stack_impl.hpp>
+
+using namespace opensentinel;
+
+replay_manager::replay_manager(stack_impl & owner)
+    : m_packets(0)
+    , stack_impl_(owner)
+    , capture_worker_(owner, 0)
+{
+    // ...
+}
+
+void replay_manager::run(const std::string & path, const bool & realtime)
+{
+    pcap_reader reader;
+    
+    reader.open(path);
+    
+    switch (reader.link_type())
+    {
+        case pcap_reader::link_type_ethernet:
+        case pcap_reader::link_type_raw:
+        case pcap_reader::link_type_linux_sll:
+        break;
+        default:
+        {
+            throw std::runtime_error(
+                "unsupported link type " + std::to_string(reader.link_type())
+            );
+        }
+        break;
+    }
+    
+    log_info(
+        "Replay manager is replaying " << path << (realtime ?
+        " at the recorded rate." : " at maximum speed.")
+    );
+    
+    auto time_start = std::chrono::steady_clock::now();
+    
+    std::chrono::nanoseconds timestamp(0), timestamp_first(0);
+    
+    /**
+     * The first packet of this run, m_packets counts every run.
+     */
+    auto first = true;
+    
+    while (reader.read(timestamp) == true)
+    {
+        const auto & data = reader.data();
+        
+        if (realtime == true)
+        {
+            if (first == true)
+            {
+                timestamp_first = timestamp;
+                
+                first = false;
+            }
+            
+            /**
+             * Sleep until the packet is due relative to the first one.
+             */
+            if (timestamp > timestamp_first)
+            {
+                std::this_thread::sleep_until(
+                    time_start + (timestamp - timestamp_first)
+                );
+            }
+        }
+        
+        m_packets++;
+        
+        if (data.empty() == true)
+        {
+            continue;
+        }
+        
+        /**
+         * Classify on the recorded time so the results do not depend on
+         * the replay speed.
+         */
+        capture_worker_.set_time(
+            std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration> (
+            timestamp))
+        );
+        
+        switch (reader.link_type())
+        {
+            case pcap_reader::link_type_ethernet:
+            {
+                capture_worker_.handle_frame(&data[0], data.size());
+            }
+            break;
+            case pcap_reader::link_type_raw:
+            {
+                if ((data[0] >> 4) == 4)
+                {
+                    capture_worker_.handle_ipv4(&data[0], data.size());
+                }
+                else if ((data[0] >> 4) == 6)
+                {
+                    capture_worker_.handle_ipv6(&data[0], data.size());
+                }
+            }
+            break;
+            case pcap_reader::link_type_linux_sll:
+            {
+                /**
+                 * The 16 byte cooked header ends with the protocol.
+                 */
+                enum { sll_header_length = 16 };
+                
+                if (data.size() < sll_header_length)
+                {
+                    break;
+                }
+                
+                std::uint16_t protocol = (data[14] << 8) + data[15];
+                
+                if (protocol == 0x0800)
+                {
+                    capture_worker_.handle_ipv4(
+                        &data[sll_header_length],
+                        data.size() - sll_header_length
+                    );
+                }
+                else if (protocol == 0x86dd)
+                {
+                    capture_worker_.handle_ipv6(
+                        &data[sll_header_length],
+                        data.size() - sll_header_length
+                    );
+                }
+            }
+            break;
+            default:
+            break;
+        }
+    }
+    
+    reader.close();
+}
+
+const std::uint64_t & replay_manager::packets() const
+{
+    return m_packets;
+}
+
+std::uint64_t replay_manager::threats() const
+{
+    return capture_worker_.threats();
+}
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/scan_correlator.hpp>
+#include <opensentinel/utility.hpp>
+
+using namespace opensentinel;
+
+/**
+ * Adds a hash to a HyperLogLog sketch of 4-bit registers.
+ * @param registers The registers.
+ * @param count The number of registers (a power of two).
+ * @param hash The hash.
+ */
+static void hll_add(
+    std::uint8_t * registers, const std::size_t & count, std::uint64_t hash
+    )
+{
+    auto index = hash & (count - 1);
+    
+    hash >>= count == 32 ? 5 : 4;
+    
+    /**
+     * The rank (position of the lowest set bit) saturates at 15.
+     */
+    std::uint8_t rank = 1;
+    
+    while ((hash & 1) == 0 && rank < 15)
+    {
+        ++rank;
+        
+        hash >>= 1;
+    }
+    
+    auto & byte = registers[index / 2];
+    
+    auto shift = (index % 2) * 4;
+    
+    if (((byte >> shift) & 0x0f) < rank)
+    {
+        byte = static_cast<std::uint8_t> (
+            (byte & ~(0x0f << shift)) | (rank << shift)
+        );
+    }
+}
+
+/**
+ * Estimates the cardinality of the union of two HyperLogLog sketches.
+ * @param a The first registers.
+ * @param b The second registers.
+ * @param count The number of registers.
+ */
+static double hll_estimate(
+    const std::uint8_t * a, const std::uint8_t * b, const std::size_t & count
+    )
+{
+    double sum = 0.0;
+    
+    std::size_t zeros = 0;
+    
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto shift = (i % 2) * 4;
+        
+        auto rank = std::max(
+            (a[i / 2] >> shift) & 0x0f, (b[i / 2] >> shift) & 0x0f
+        );
+        
+        if (rank == 0)
+        {
+            ++zeros;
+        }
+        
+        sum += std::ldexp(1.0, -rank);
+    }
+    
+    auto m = static_cast<double> (count);
+    
+    auto alpha = count == 16 ? 0.673 : 0.697;
+    
+    auto ret = alpha * m * m / sum;
+    
+    /**
+     * Small cardinalities are counted from the empty registers.
+     */
+    if (ret <= 2.5 * m && zeros > 0)
+    {
+        ret = m * std::log(m / static_cast<double> (zeros));
+    }
+    
+    return ret;
+}
+
+scan_correlator::scan_correlator()
+    : m_half_window(30)
+    , m_time_start()
+    , m_time_tick(0)
+    , m_expire_position(0)
+    , m_source_count(0)
+    , m_evictions(0)
+{
+    // ...
+}
+
+void scan_correlator::start(
+    const std::uint32_t & sources, const std::uint32_t & window
+    )
+{
+    std::size_t capacity = probe_length;
+    
+    while (capacity < sources)
+    {
+        capacity <<= 1;
+    }
+    
+    source_t empty;
+    
+    std::memset(&empty, 0, sizeof(empty));
+    
+    m_sources.assign(capacity, empty);
+    
+    m_half_window = std::max(1u, window / 2);
+    m_time_start = std::chrono::system_clock::time_point();
+    m_time_tick = 0;
+    m_expire_position = 0;
+    m_source_count = 0;
+    m_evictions = 0;
+    
+    log_info(
+        "Scan correlator is tracking up to " << capacity << " sources over " <<
+        m_half_window * 2 << " seconds in " << memory() / 1024 << " KiB."
+    );
+}
+
+void scan_correlator::set_on_threat(const std::function<void (threat &)> & f)
+{
+    m_on_threat = f;
+}
+
+void scan_correlator::on_threat(const threat & val)
+{
+    /**
+     * Skip the threats this correlator reported, the flood summaries and the
+     * (throttled) scans of the capture_workers.
+     */
+    if (val.scan_type() != threat::scan_type_none)
+    {
+        return;
+    }
+    
+    on_probe(
+        val.protocol(), val.address(), val.destination_address(),
+        val.destination_port(), val.timestamp()
+    );
+}
+
+void scan_correlator::on_probe(
+    const threat::protocol_t & protocol, const asio::ip::address & addr,
+    const asio::ip::address & destination, const std::uint16_t & port,
+    const std::chrono::system_clock::time_point & time
+    )
+{
+    if (m_sources.empty())
+    {
+        return;
+    }
+    
+    std::uint8_t address[16];
+    
+    auto key = std::max(
+        static_cast<std::uint64_t> (1),
+        utility::hash_address(addr, address)
+    );
+    
+    auto t = now(time);
+    auto half = t / m_half_window;
+    
+    /**
+     * Probe for the source, remembering a free and the least recently seen
+     * entry in case it is not found.
+     */
+    auto mask = m_sources.size() - 1;
+    
+    source_t * source = nullptr;
+    source_t * empty = nullptr;
+    source_t * oldest = nullptr;
+    
+    for (std::size_t i = 0; i < probe_length; i++)
+    {
+        auto & entry = m_sources[(key + i) & mask];
+        
+        if (entry.key == key)
+        {
+            source = &entry;
+            
+            break;
+        }
+        else if (entry.key == 0)
+        {
+            if (empty == nullptr)
+            {
+                empty = &entry;
+            }
+        }
+        else if (oldest == nullptr || entry.time_last < oldest->time_last)
+        {
+            oldest = &entry;
+        }
+    }
+    
+    if (source == nullptr)
+    {
+        if (empty)
+        {
+            source = empty;
+            
+            ++m_source_count;
+        }
+        else
+        {
+            source = oldest;
+            
+            ++m_evictions;
+        }
+        
+        std::memset(source, 0, sizeof(source_t));
+        
+        source->key = key;
+        
+        std::memcpy(source->address, address, sizeof(address));
+        
+        source->half = half;
+        source->time_first = t;
+    }
+    
+    /**
+     * Slide the window by half when needed.
+     */
+    if (half == source->half + 1)
+    {
+        source->events[0] = source->events[1];
+        source->events[1] = 0;
+        
+        std::memcpy(source->ports[0], source->ports[1], sizeof(source->ports[0]));
+        std::memset(source->ports[1], 0, sizeof(source->ports[1]));
+        std::memcpy(source->hosts[0], source->hosts[1], sizeof(source->hosts[0]));
+        std::memset(source->hosts[1], 0, sizeof(source->hosts[1]));
+        
+        source->half = half;
+        source->time_first = std::max(
+            source->time_first, (half - 1) * m_half_window
+        );
+    }
+    else if (half > source->half + 1)
+    {
+        source->events[0] = source->events[1] = 0;
+        
+        std::memset(source->ports, 0, sizeof(source->ports));
+        std::memset(source->hosts, 0, sizeof(source->hosts));
+        
+        source->half = half;
+        source->time_first = t;
+        source->scan_type = threat::scan_type_none;
+    }
+    
+    source->events[1]++;
+    source->time_last = t;
+    source->port = port;
+    source->protocol = static_cast<std::uint8_t> (protocol);
+    
+    hll_add(
+        source->ports[1], port_registers,
+        utility::mix(static_cast<std::uint64_t> (protocol) << 16 | port)
+    );
+    
+    hll_add(
+        source->hosts[1], host_registers, utility::hash_address(destination)
+    );
+    
+    /**
+     * Classify the source.
+     */
+    auto ports = hll_estimate(
+        source->ports[0], source->ports[1], port_registers
+    );
+    auto hosts = hll_estimate(
+        source->hosts[0], source->hosts[1], host_registers
+    );
+    
+    auto type = threat::scan_type_none;
+    
+    if (ports >= vertical_threshold && ports >= hosts)
+    {
+        type = threat::scan_type_vertical;
+    }
+    else if (hosts >= sweep_threshold)
+    {
+        type = threat::scan_type_sweep;
+    }
+    
+    /**
+     * Report a scan once, then again each window it lasts.
+     */
+    if (
+        type != threat::scan_type_none && (source->scan_type != type ||
+        half >= source->half_reported + 2)
+        )
+    {
+        log_debug(
+            "Scan correlator classified source with " << ports <<
+            " ports and " << hosts << " hosts (estimated)."
+        );
+        
+        report(*source, type, t);
+    }
+}
+
+void scan_correlator::on_tick(
+    const std::chrono::system_clock::time_point & time
+    )
+{
+    if (m_sources.empty())
+    {
+        return;
+    }
+    
+    auto t = now(time);
+    
+    if (t <= m_time_tick)
+    {
+        return;
+    }
+    
+    /**
+     * Visit the whole table once per window, in steps of the seconds
+     * passed since the last tick.
+     */
+    auto count = std::min(
+        m_sources.size(), (m_sources.size() / (m_half_window * 2) + 1) *
+        std::min(t - m_time_tick, m_half_window * 2)
+    );
+    
+    m_time_tick = t;
+    
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto & source = m_sources[m_expire_position];
+        
+        m_expire_position = (m_expire_position + 1) % m_sources.size();
+        
+        if (source.key == 0 || t - source.time_last < m_half_window * 2)
+        {
+            continue;
+        }
+        
+        /**
+         * A source that went quiet without scanning was a single probe.
+         */
+        if (source.scan_type == threat::scan_type_none)
+        {
+            report(source, threat::scan_type_probe, source.time_last);
+        }
+        
+        source.key = 0;
+        
+        --m_source_count;
+    }
+}
+
+const std::size_t & scan_correlator::sources() const
+{
+    return m_source_count;
+}
+
+const std::uint64_t & scan_correlator::evictions() const
+{
+    return m_evictions;
+}
+
+std::size_t scan_correlator::memory() const
+{
+    return m_sources.size() * sizeof(source_t);
+}
+
+std::uint32_t scan_correlator::now(
+    const std::chrono::system_clock::time_point & time
+    )
+{
+    /**
+     * The clock starts at the first time seen, a replay runs on the
+     * recorded time.
+     */
+    if (m_time_start == std::chrono::system_clock::time_point())
+    {
+        m_time_start = time;
+    }
+    
+    if (time <= m_time_start)
+    {
+        return 0;
+    }
+    
+    return static_cast<std::uint32_t> (
+        std::chrono::duration_cast<std::chrono::seconds> (
+        time - m_time_start).count()
+    );
+}
+
+void scan_correlator::report(
+    source_t & source, const threat::scan_type_t & type,
+    const std::uint32_t & time
+    )
+{
+    source.scan_type = static_cast<std::uint8_t> (type);
+    source.half_reported = source.half;
+    
+    asio::ip::address_v6::bytes_type bytes;
+    
+    std::memcpy(bytes.data(), source.address, bytes.size());
+    
+    threat threat_data(
+        static_cast<threat::protocol_t> (source.protocol),
+        asio::ip::address_v6(bytes), 0, 0, 0
+    );
+    
+    threat_data.set_destination_port(source.port);
+    threat_data.set_scan_type(type);
+    threat_data.set_timestamp(m_time_start + std::chrono::seconds(time));
+    
+    threat_data.set_rate(
+        static_cast<double> (source.events[0] + source.events[1]) /
+        (time - source.time_first + 1)
+    );
+    
+    threat_data.set_level(
+        type == threat::scan_type_probe ? threat::level_0 : threat::level_4
+    );
+    
+    if (m_on_threat)
+    {
+        m_on_threat(threat_data);
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bitset>
+#include <cstring>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/packet_view.hpp>
+#include <opensentinel/scan_detector.hpp>
+#include <opensentinel/tcp_header.hpp>
+
+using namespace opensentinel;
+
+/**
+ * A source is reported at most once per scan type within this window.
+ */
+enum { scan_window_seconds = 60 };
+
+/**
+ * The maximum number of sources tracked at once.
+ */
+enum { maximum_sources = 65536 };
+
+scan_detector::scan_detector()
+    : m_time_last_prune()
+{
+    // ...
+}
+
+void scan_detector::set_on_scan(
+    const std::function<void (const threat &)> & f
+    )
+{
+    m_on_scan = f;
+}
+
+threat::scan_type_t scan_detector::classify(const std::uint8_t & flags)
+{
+    enum
+    {
+        flags_mask =
+            tcp_header::flag_fin | tcp_header::flag_syn |
+            tcp_header::flag_rst | tcp_header::flag_psh |
+            tcp_header::flag_ack | tcp_header::flag_urg
+    };
+    
+    auto val = flags & flags_mask;
+    
+    /**
+     * A connection attempt, half-open scanners never complete the
+     * handshake.
+     */
+    if (val == tcp_header::flag_syn)
+    {
+        return threat::scan_type_tcp_syn;
+    }
+    
+    /**
+     * A FIN without an ACK is never part of a valid connection.
+     */
+    if (val == tcp_header::flag_fin)
+    {
+        return threat::scan_type_tcp_fin;
+    }
+    
+    /**
+     * No flags at all.
+     */
+    if (val == 0)
+    {
+        return threat::scan_type_tcp_null;
+    }
+    
+    /**
+     * FIN, PSH and URG lit up like a christmas tree.
+     */
+    if (
+        val == (tcp_header::flag_fin | tcp_header::flag_psh |
+        tcp_header::flag_urg)
+        )
+    {
+        return threat::scan_type_tcp_xmas;
+    }
+    
+    return threat::scan_type_none;
+}
+
+threat::scan_type_t scan_detector::on_tcp_segment(
+    const asio::ip::address & addr, const asio::ip::address & destination,
+    const tcp_view & hdr, const bool & monitored,
+    const std::chrono::system_clock::time_point & now
+    )
+{
+    auto type = classify(hdr.flags());
+    
+    if (type == threat::scan_type_none)
+    {
+        return type;
+    }
+    
+    /**
+     * Plain connection attempts are only interesting on monitored ports
+     * since the host may have real services.
+     */
+    if (type == threat::scan_type_tcp_syn && monitored == false)
+    {
+        return threat::scan_type_none;
+    }
+    
+    if (now - m_time_last_prune >= std::chrono::seconds(1))
+    {
+        prune(now);
+    }
+    
+    key_t key;
+    
+    if (addr.is_v4())
+    {
+        key = asio::ip::address_v6::v4_mapped(addr.to_v4()).to_bytes();
+    }
+    else
+    {
+        key = addr.to_v6().to_bytes();
+    }
+    
+    auto it = m_sources.find(key);
+    
+    if (it == m_sources.end())
+    {
+        if (m_sources.size() >= maximum_sources)
+        {
+            return type;
+        }
+        
+        source_t source;
+        
+        std::memset(source.probes, 0, sizeof(source.probes));
+        
+        for (auto & i : source.time_reported)
+        {
+            i = std::chrono::system_clock::time_point();
+        }
+        
+        source.ports = 0;
+        
+        it = m_sources.insert(std::make_pair(key, source)).first;
+    }
+    
+    auto & source = it->second;
+    
+    source.time_last_seen = now;
+    source.probes[type]++;
+    source.ports |= 1ULL << (hdr.destination_port() % 64);
+    
+    /**
+     * Report the source at most once per window for each scan type so a
+     * full speed sweep does not flood the threat_manager.
+     */
+    if (
+        source.time_reported[type] == std::chrono::system_clock::time_point() ||
+        now - source.time_reported[type] >=
+        std::chrono::seconds(scan_window_seconds)
+        )
+    {
+        source.time_reported[type] = now;
+        
+        threat threat_data(threat::protocol_tcp, addr, hdr.source_port(), 0, 0);
+        
+        threat_data.set_destination_address(destination);
+        threat_data.set_destination_port(hdr.destination_port());
+        threat_data.set_scan_type(type);
+        threat_data.set_timestamp(now);
+        
+        /**
+         * Stealth scans have no legitimate use.
+         */
+        threat_data.set_level(
+            type == threat::scan_type_tcp_syn ?
+            threat::level_3 : threat::level_4
+        );
+        
+        log_debug(
+            "Scan detector classified " << addr << " as " <<
+            threat_data.scan_type_string() << ", probes = " <<
+            source.probes[type] << ", port buckets = " <<
+            std::bitset<64> (source.ports).count() << "."
+        );
+        
+        if (m_on_scan)
+        {
+            m_on_scan(threat_data);
+        }
+    }
+    
+    return type;
+}
+
+std::size_t scan_detector::sources() const
+{
+    return m_sources.size();
+}
+
+void scan_detector::prune(const std::chrono::system_clock::time_point & now)
+{
+    m_time_last_prune = now;
+    
+    auto it = m_sources.begin();
+    
+    while (it != m_sources.end())
+    {
+        if (
+            now - it->second.time_last_seen >=
+            std::chrono::seconds(scan_window_seconds)
+            )
+        {
+            it = m_sources.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
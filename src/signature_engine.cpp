@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/signature_engine.hpp>
+
+using namespace opensentinel;
+
+signature_engine::signature_engine()
+    : m_class_count(1)
+    , m_dense_count(0)
+{
+    m_classes.fill(0);
+    
+    compile();
+}
+
+void signature_engine::load(const std::string & path)
+{
+    std::ifstream ifs(path);
+    
+    if (ifs.is_open() == false)
+    {
+        throw std::runtime_error("failed to open " + path);
+    }
+    
+    std::string line;
+    
+    std::size_t line_number = 0;
+    
+    while (std::getline(ifs, line))
+    {
+        ++line_number;
+        
+        if (line.empty() == false && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        
+        std::istringstream iss(line);
+        
+        std::uint32_t id = 0;
+        std::uint32_t level = 0;
+        
+        if (
+            !(iss >> id >> level) || level < threat::level_1 ||
+            level > threat::level_5
+            )
+        {
+            throw std::runtime_error(
+                "invalid signature on line " + std::to_string(line_number)
+            );
+        }
+        
+        /**
+         * The pattern is the rest of the line (after a single space).
+         */
+        std::string pattern;
+        
+        if (iss.get() == ' ')
+        {
+            std::getline(iss, pattern);
+        }
+        
+        /**
+         * A regex is written as regex:/<regex>/ with an optional i flag.
+         */
+        static const std::string regex_prefix = "regex:/";
+        
+        if (pattern.compare(0, regex_prefix.size(), regex_prefix) == 0)
+        {
+            auto end = pattern.rfind('/');
+            
+            auto flags = pattern.substr(end + 1);
+            
+            if (end < regex_prefix.size() || (flags != "" && flags != "i"))
+            {
+                throw std::runtime_error(
+                    "invalid regex signature on line " +
+                    std::to_string(line_number)
+                );
+            }
+            
+            try
+            {
+                add_regex(
+                    id, static_cast<threat::level_t> (level),
+                    pattern.substr(
+                    regex_prefix.size(), end - regex_prefix.size()),
+                    flags == "i"
+                );
+            }
+            catch (std::exception & e)
+            {
+                throw std::runtime_error(
+                    "invalid regex on line " + std::to_string(line_number) +
+                    ", " + e.what()
+                );
+            }
+            
+            continue;
+        }
+        
+        pattern = unescape(pattern);
+        
+        if (pattern.empty())
+        {
+            throw std::runtime_error(
+                "empty signature on line " + std::to_string(line_number)
+            );
+        }
+        
+        add(id, static_cast<threat::level_t> (level), pattern);
+    }
+    
+    compile();
+}
+
+void signature_engine::add(
+    const std::uint32_t & id, const threat::level_t & level,
+    const std::string & pattern
+    )
+{
+    if (pattern.empty() == false)
+    {
+        m_signatures.push_back({ id, level, pattern });
+    }
+}
+
+void signature_engine::add_regex(
+    const std::uint32_t & id, const threat::level_t & level,
+    const std::string & pattern, const bool & case_insensitive
+    )
+{
+    regex_dfa regex;
+    
+    regex.compile(pattern, case_insensitive);
+    
+    log_debug(
+        "Signature engine compiled regex " << id << " into " <<
+        regex.states() << " states and " << regex.classes() <<
+        " byte classes (" << regex.table_size() << " bytes)."
+    );
+    
+    m_regex_signatures.push_back({ id, level, pattern });
+    m_regexes.push_back(std::move(regex));
+}
+
+void signature_engine::compile()
+{
+    /**
+     * Every byte that occurs in a pattern gets it's own class, the rest
+     * share class zero.
+     */
+    m_classes.fill(0);
+    
+    m_class_count = 1;
+    
+    for (auto & i : m_signatures)
+    {
+        for (auto & j : i.pattern)
+        {
+            auto & c = m_classes[static_cast<std::uint8_t> (j)];
+            
+            if (c == 0 && m_class_count < 256)
+            {
+                c = static_cast<std::uint8_t> (m_class_count++);
+            }
+        }
+    }
+    
+    const auto none = std::numeric_limits<std::uint32_t>::max();
+    
+    /**
+     * Build the trie, the root is state zero and each state has the
+     * (class, state) edges of it's children.
+     */
+    std::vector<
+        std::vector< std::pair<std::uint8_t, std::uint32_t> >
+    > edges(1);
+    
+    std::vector< std::vector<std::uint32_t> > outputs(1);
+    
+    auto find_edge = [&edges, none](
+        const std::uint32_t & state, const std::uint8_t & c)
+    {
+        for (auto & i : edges[state])
+        {
+            if (i.first == c)
+            {
+                return i.second;
+            }
+        }
+        
+        return none;
+    };
+    
+    for (std::uint32_t i = 0; i < m_signatures.size(); i++)
+    {
+        std::uint32_t state = 0;
+        
+        for (auto & j : m_signatures[i].pattern)
+        {
+            auto c = m_classes[static_cast<std::uint8_t> (j)];
+            
+            auto next = find_edge(state, c);
+            
+            if (next == none)
+            {
+                next = static_cast<std::uint32_t> (edges.size());
+                
+                edges[state].push_back(std::make_pair(c, next));
+                
+                edges.resize(edges.size() + 1);
+                outputs.resize(outputs.size() + 1);
+            }
+            
+            state = next;
+        }
+        
+        outputs[state].push_back(i);
+    }
+    
+    /**
+     * Walk the trie breadth first resolving the failure links, the states
+     * are then renumbered in this order so the shallow (dense) ones come
+     * first.
+     */
+    std::vector<std::uint32_t> order(1, 0);
+    std::vector<std::uint32_t> depths(edges.size(), 0);
+    std::vector<std::uint32_t> failures(edges.size(), 0);
+    
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        auto state = order[i];
+        
+        /**
+         * The failure state is shallower so it's outputs are complete.
+         */
+        if (state != 0)
+        {
+            auto failure = failures[state];
+            
+            outputs[state].insert(
+                outputs[state].end(), outputs[failure].begin(),
+                outputs[failure].end()
+            );
+        }
+        
+        for (auto & j : edges[state])
+        {
+            depths[j.second] = depths[state] + 1;
+            
+            if (state != 0)
+            {
+                auto failure = failures[state];
+                
+                while (failure != 0 && find_edge(failure, j.first) == none)
+                {
+                    failure = failures[failure];
+                }
+                
+                auto next = find_edge(failure, j.first);
+                
+                failures[j.second] = next == none ? 0 : next;
+            }
+            
+            order.push_back(j.second);
+        }
+    }
+    
+    std::vector<std::uint32_t> ids(order.size());
+    
+    m_dense_count = 0;
+    
+    for (std::uint32_t i = 0; i < order.size(); i++)
+    {
+        ids[order[i]] = i;
+        
+        if (depths[order[i]] <= dense_depth)
+        {
+            ++m_dense_count;
+        }
+    }
+    
+    /**
+     * A dense state's row starts as the row of it's failure state (which
+     * is shallower so already filled) and is overridden by it's edges.
+     */
+    m_transitions.assign(m_dense_count * m_class_count, 0);
+    
+    for (std::uint32_t i = 0; i < m_dense_count; i++)
+    {
+        auto state = order[i];
+        
+        auto * row = &m_transitions[i * m_class_count];
+        
+        if (i > 0)
+        {
+            std::copy(
+                &m_transitions[ids[failures[state]] * m_class_count],
+                &m_transitions[ids[failures[state]] * m_class_count] +
+                m_class_count, row
+            );
+        }
+        
+        for (auto & j : edges[state])
+        {
+            row[j.first] = ids[j.second];
+        }
+    }
+    
+    /**
+     * A sparse state keeps it's edges (sorted by class) and failure link.
+     */
+    m_edge_offsets.assign(1, 0);
+    m_edge_classes.clear();
+    m_edge_states.clear();
+    m_failures.clear();
+    
+    for (auto i = m_dense_count; i < order.size(); i++)
+    {
+        auto & state_edges = edges[order[i]];
+        
+        std::sort(state_edges.begin(), state_edges.end());
+        
+        for (auto & j : state_edges)
+        {
+            m_edge_classes.push_back(j.first);
+            m_edge_states.push_back(ids[j.second]);
+        }
+        
+        m_edge_offsets.push_back(
+            static_cast<std::uint32_t> (m_edge_states.size())
+        );
+        
+        m_failures.push_back(ids[failures[order[i]]]);
+    }
+    
+    /**
+     * Flatten the outputs (in the new order).
+     */
+    m_output_offsets.assign(1, 0);
+    m_outputs.clear();
+    
+    for (auto & i : order)
+    {
+        m_outputs.insert(m_outputs.end(), outputs[i].begin(), outputs[i].end());
+        
+        m_output_offsets.push_back(static_cast<std::uint32_t> (m_outputs.size()));
+    }
+    
+    /**
+     * Anchor the prefilter on the same patterns.
+     */
+    std::vector<std::string> patterns;
+    
+    for (auto & i : m_signatures)
+    {
+        patterns.push_back(i.pattern);
+    }
+    
+    literal_prefilter_.compile(patterns);
+    
+    m_transitions.shrink_to_fit();
+    m_edge_offsets.shrink_to_fit();
+    m_edge_classes.shrink_to_fit();
+    m_edge_states.shrink_to_fit();
+    m_failures.shrink_to_fit();
+    m_output_offsets.shrink_to_fit();
+    m_outputs.shrink_to_fit();
+    
+    log_debug(
+        "Signature engine compiled " << m_signatures.size() <<
+        " signatures into " << states() << " states (" << m_dense_count <<
+        " dense) and " << m_class_count << " byte classes, " << memory() <<
+        " bytes."
+    );
+}
+
+threat::level_t signature_engine::match(
+    const char * buf, const std::size_t & len,
+    std::vector<std::uint32_t> & ids
+    ) const
+{
+    auto ret = threat::level_0;
+    
+    ids.clear();
+    
+    /**
+     * No pattern can start before the first candidate.
+     */
+    auto offset = literal_prefilter_.find(buf, len);
+    
+    const auto * offsets = m_output_offsets.data();
+    
+    std::uint32_t state = 0;
+    
+    for (auto i = offset; i < len; i++)
+    {
+        state = next_state(
+            state, m_classes[static_cast<std::uint8_t> (buf[i])]
+        );
+        
+        for (auto j = offsets[state]; j < offsets[state + 1]; j++)
+        {
+            const auto & signature = m_signatures[m_outputs[j]];
+            
+            ids.push_back(signature.id);
+            
+            ret = std::max(ret, signature.level);
+        }
+    }
+    
+    for (std::size_t i = 0; i < m_regexes.size(); i++)
+    {
+        if (m_regexes[i].search(buf, len) == true)
+        {
+            ids.push_back(m_regex_signatures[i].id);
+            
+            ret = std::max(ret, m_regex_signatures[i].level);
+        }
+    }
+    
+    if (ids.size() > 1)
+    {
+        std::sort(ids.begin(), ids.end());
+        
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+    
+    return ret;
+}
+
+std::size_t signature_engine::size() const
+{
+    return m_signatures.size() + m_regex_signatures.size();
+}
+
+std::size_t signature_engine::states() const
+{
+    return m_output_offsets.size() - 1;
+}
+
+std::size_t signature_engine::memory() const
+{
+    return
+        m_transitions.capacity() * sizeof(std::uint32_t) +
+        m_edge_offsets.capacity() * sizeof(std::uint32_t) +
+        m_edge_classes.capacity() * sizeof(std::uint8_t) +
+        m_edge_states.capacity() * sizeof(std::uint32_t) +
+        m_failures.capacity() * sizeof(std::uint32_t) +
+        m_output_offsets.capacity() * sizeof(std::uint32_t) +
+        m_outputs.capacity() * sizeof(std::uint32_t)
+    ;
+}
+
+std::uint32_t signature_engine::next_state(
+    std::uint32_t state, const std::uint8_t & c
+    ) const
+{
+    /**
+     * A sparse state follows it's failure links until it has an edge for
+     * the class or reaches a dense state, which has a transition for every
+     * class.
+     */
+    while (state >= m_dense_count)
+    {
+        auto index = state - m_dense_count;
+        
+        auto begin = m_edge_classes.begin() + m_edge_offsets[index];
+        auto end = m_edge_classes.begin() + m_edge_offsets[index + 1];
+        
+        auto it = std::lower_bound(begin, end, c);
+        
+        if (it != end && *it == c)
+        {
+            return m_edge_states[it - m_edge_classes.begin()];
+        }
+        
+        state = m_failures[index];
+    }
+    
+    return m_transitions[state * m_class_count + c];
+}
+
+std::string signature_engine::unescape(const std::string & val)
+{
+    std::string ret;
+    
+    for (std::size_t i = 0; i < val.size(); i++)
+    {
+        if (val[i] != '\\' || i + 1 == val.size())
+        {
+            ret += val[i];
+            
+            continue;
+        }
+        
+        switch (val[++i])
+        {
+            case 'r':
+            {
+                ret += '\r';
+            }
+            break;
+            case 'n':
+            {
+                ret += '\n';
+            }
+            break;
+            case 't':
+            {
+                ret += '\t';
+            }
+            break;
+            case 'x':
+            {
+                if (
+                    i + 2 < val.size() &&
+                    std::isxdigit(static_cast<unsigned char> (val[i + 1])) &&
+                    std::isxdigit(static_cast<unsigned char> (val[i + 2]))
+                    )
+                {
+                    ret += static_cast<char> (
+                        std::stoul(val.substr(i + 1, 2), nullptr, 16)
+                    );
+                    
+                    i += 2;
+                }
+                else
+                {
+                    throw std::runtime_error("invalid \\x escape");
+                }
+            }
+            break;
+            default:
+            {
+                ret += val[i];
+            }
+            break;
+        }
+    }
+    
+    return ret;
+}
@@ -0,0 +1,613 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#if (defined __linux__)
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/**
+ * From linux/icmp.h which conflicts with net/if.h.
+ */
+#ifndef ICMP_FILTER
+#define ICMP_FILTER 1
+#endif // ICMP_FILTER
+#endif // __linux__
+
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/socket_filter.hpp>
+
+using namespace opensentinel;
+
+#if (defined __linux__)
+/**
+ * The offset of the network header.
+ */
+enum { net = SKF_NET_OFF };
+
+/**
+ * The snap length returned for accepted packets (the whole packet).
+ */
+enum : std::uint32_t { accept_length = 0xffffffff };
+#endif // __linux__
+
+socket_filter::socket_filter()
+    : m_type(type_none)
+{
+    // ...
+}
+
+void socket_filter::compile(const configuration & config, const type_t & type)
+{
+    m_type = type;
+    m_instructions.clear();
+    m_labels.clear();
+    m_jumps.clear();
+    m_long_jumps.clear();
+#if (defined __linux__)
+    auto accept = new_label();
+    auto drop = new_label();
+    auto ipv4 = new_label();
+    auto ipv6 = new_label();
+    auto not_ipv4 = new_label();
+    auto is_ipv6 = new_label();
+    auto other = new_label();
+    
+    /**
+     * Dispatch on the ethernet protocol of the packet.
+     */
+    emit(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL);
+    emit_jump(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, ipv4, not_ipv4);
+    bind(not_ipv4);
+    emit_jump(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IPV6, is_ipv6, other);
+    bind(other);
+    emit(
+        BPF_RET | BPF_K,
+        type == type_udp ? static_cast<std::uint32_t> (accept_length) : 0
+    );
+    
+    /**
+     * The ipv6 code follows the ipv4 allow-list which may be longer than
+     * a conditional jump reaches.
+     */
+    bind(is_ipv6);
+    emit_long_jump(ipv6);
+    
+    bind(ipv4);
+    
+    emit_allowed_ipv4(config);
+    
+    if (type == type_udp)
+    {
+        emit(BPF_RET | BPF_K, accept_length);
+    }
+    else
+    {
+        /**
+         * The ipv4 code returns on it's own so none of it's jumps cross
+         * the ipv6 allow-list.
+         */
+        auto accept_ipv4 = new_label();
+        auto drop_ipv4 = new_label();
+        auto first_fragment = new_label();
+        auto icmp = new_label();
+        auto echo_reply = new_label();
+        
+        /**
+         * Only the first fragment carries the transport header.
+         */
+        emit(BPF_LD | BPF_H | BPF_ABS, net + 6);
+        emit_jump(
+            BPF_JMP | BPF_JSET | BPF_K, 0x1fff, drop_ipv4, first_fragment
+        );
+        bind(first_fragment);
+        
+        /**
+         * X = the ipv4 header length.
+         */
+        emit(BPF_LDX | BPF_B | BPF_MSH, net + 0);
+        emit(BPF_LD | BPF_B | BPF_ABS, net + 9);
+        
+        if (type == type_capture)
+        {
+            auto tcp = new_label();
+            auto not_tcp = new_label();
+            auto udp = new_label();
+            auto is_icmp = new_label();
+            
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, tcp, not_tcp);
+            bind(not_tcp);
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, udp, icmp);
+            
+            bind(tcp);
+            emit(BPF_LD | BPF_B | BPF_IND, net + 13);
+            emit_scan_probe(config, net + 2, true, accept_ipv4, drop_ipv4);
+            
+            /**
+             * UDP to a monitored port.
+             */
+            bind(udp);
+            emit(BPF_LD | BPF_H | BPF_IND, net + 2);
+            emit_monitored_port(config, accept_ipv4);
+            
+            bind(icmp);
+            emit_jump(
+                BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMP, is_icmp, drop_ipv4
+            );
+            bind(is_icmp);
+            
+            /**
+             * Echo requests.
+             */
+            emit(BPF_LD | BPF_B | BPF_IND, net + 0);
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, 8, accept_ipv4, drop_ipv4);
+        }
+        else
+        {
+            emit_jump(
+                BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMP, icmp, drop_ipv4
+            );
+            bind(icmp);
+            
+            /**
+             * Echo requests and replies.
+             */
+            emit(BPF_LD | BPF_B | BPF_IND, net + 0);
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, 8, accept_ipv4, echo_reply);
+            bind(echo_reply);
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, 0, accept_ipv4, drop_ipv4);
+        }
+        
+        bind(accept_ipv4);
+        emit(BPF_RET | BPF_K, accept_length);
+        
+        bind(drop_ipv4);
+        emit(BPF_RET | BPF_K, 0);
+    }
+    
+    bind(ipv6);
+    
+    emit_allowed_ipv6(config);
+    
+    if (type == type_capture)
+    {
+        auto tcp = new_label();
+        auto not_tcp = new_label();
+        auto udp = new_label();
+        auto not_udp = new_label();
+        auto icmp = new_label();
+        
+        /**
+         * Extension headers are not followed.
+         */
+        emit(BPF_LD | BPF_B | BPF_ABS, net + 6);
+        emit_jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, tcp, not_tcp);
+        bind(not_tcp);
+        emit_jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, udp, not_udp);
+        bind(not_udp);
+        emit_jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMPV6, icmp, drop);
+        
+        bind(tcp);
+        emit(BPF_LD | BPF_B | BPF_ABS, net + 40 + 13);
+        emit_scan_probe(config, net + 40 + 2, false, accept, drop);
+        
+        bind(udp);
+        emit(BPF_LD | BPF_H | BPF_ABS, net + 40 + 2);
+        emit_monitored_port(config, accept);
+        
+        /**
+         * ICMPv6 echo requests.
+         */
+        bind(icmp);
+        emit(BPF_LD | BPF_B | BPF_ABS, net + 40);
+        emit_jump(BPF_JMP | BPF_JEQ | BPF_K, 128, accept, drop);
+    }
+    else
+    {
+        emit(BPF_RET | BPF_K, accept_length);
+    }
+    
+    bind(accept);
+    emit(BPF_RET | BPF_K, accept_length);
+    
+    bind(drop);
+    emit(BPF_RET | BPF_K, 0);
+    
+    resolve();
+    
+    log_debug(
+        "Socket filter compiled " << m_instructions.size() <<
+        " instructions for type " << m_type << "."
+    );
+#endif // __linux__
+}
+
+void socket_filter::attach(const int & socket, std::error_code & ec) const
+{
+#if (defined __linux__)
+    if (m_instructions.empty())
+    {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        
+        return;
+    }
+    
+    struct sock_fprog prog;
+    
+    prog.len = static_cast<unsigned short> (m_instructions.size());
+    
+    /**
+     * The instruction_t layout matches struct sock_filter.
+     */
+    static_assert(
+        sizeof(instruction_t) == sizeof(struct sock_filter),
+        "instruction_t must match struct sock_filter"
+    );
+    
+    prog.filter = reinterpret_cast<struct sock_filter *> (
+        const_cast<instruction_t *> (m_instructions.data())
+    );
+    
+    if (
+        setsockopt(socket, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+        sizeof(prog)) < 0
+        )
+    {
+        ec = std::error_code(errno, std::generic_category());
+    }
+    else
+    {
+        ec = std::error_code();
+    }
+#else
+    ec = std::make_error_code(std::errc::operation_not_supported);
+#endif // __linux__
+}
+
+void socket_filter::attach_icmp_types(
+    const int & socket, const std::vector<std::uint8_t> & types,
+    std::error_code & ec
+    )
+{
+#if (defined __linux__)
+    /**
+     * A set bit drops the type (struct icmp_filter), types above 31 can't
+     * be filtered.
+     */
+    std::uint32_t mask = 0xffffffff;
+    
+    for (auto & i : types)
+    {
+        if (i < 32)
+        {
+            mask &= ~(1U << i);
+        }
+    }
+    
+    if (
+        setsockopt(socket, SOL_RAW, ICMP_FILTER, &mask, sizeof(mask)) < 0
+        )
+    {
+        ec = std::error_code(errno, std::generic_category());
+    }
+    else
+    {
+        ec = std::error_code();
+    }
+#else
+    ec = std::make_error_code(std::errc::operation_not_supported);
+#endif // __linux__
+}
+
+void socket_filter::attach_icmpv6_types(
+    const int & socket, const std::vector<std::uint8_t> & types,
+    std::error_code & ec
+    )
+{
+#if (defined __linux__)
+    struct icmp6_filter filter;
+    
+    ICMP6_FILTER_SETBLOCKALL(&filter);
+    
+    for (auto & i : types)
+    {
+        ICMP6_FILTER_SETPASS(i, &filter);
+    }
+    
+    if (
+        setsockopt(socket, IPPROTO_ICMPV6, ICMP6_FILTER, &filter,
+        sizeof(filter)) < 0
+        )
+    {
+        ec = std::error_code(errno, std::generic_category());
+    }
+    else
+    {
+        ec = std::error_code();
+    }
+#else
+    ec = std::make_error_code(std::errc::operation_not_supported);
+#endif // __linux__
+}
+
+const socket_filter::type_t & socket_filter::type() const
+{
+    return m_type;
+}
+
+const std::vector<socket_filter::instruction_t> &
+    socket_filter::instructions() const
+{
+    return m_instructions;
+}
+
+socket_filter::label_t socket_filter::new_label()
+{
+    m_labels.push_back(static_cast<std::size_t> (-1));
+    
+    return m_labels.size() - 1;
+}
+
+void socket_filter::bind(const label_t & label)
+{
+    m_labels[label] = m_instructions.size();
+}
+
+void socket_filter::emit(const std::uint16_t & code, const std::uint32_t & k)
+{
+    instruction_t instruction;
+    
+    instruction.code = code;
+    instruction.jt = 0;
+    instruction.jf = 0;
+    instruction.k = k;
+    
+    m_instructions.push_back(instruction);
+}
+
+void socket_filter::emit_jump(
+    const std::uint16_t & code, const std::uint32_t & k,
+    const label_t & jt, const label_t & jf
+    )
+{
+    m_jumps.push_back(
+        std::make_pair(m_instructions.size(), std::make_pair(jt, jf))
+    );
+    
+    emit(code, k);
+}
+
+void socket_filter::emit_long_jump(const label_t & label)
+{
+    m_long_jumps.push_back(std::make_pair(m_instructions.size(), label));
+    
+    emit(BPF_JMP | BPF_JA, 0);
+}
+
+void socket_filter::emit_allowed_ipv4(const configuration & config)
+{
+#if (defined __linux__)
+    bool loaded = false;
+    
+    for (auto & i : config.allowed_sources())
+    {
+        if (i.first.is_v4() == false)
+        {
+            continue;
+        }
+        
+        /**
+         * X = the source address, kept across the entries.
+         */
+        if (loaded == false)
+        {
+            emit(BPF_LD | BPF_W | BPF_ABS, net + 12);
+            emit(BPF_MISC | BPF_TAX, 0);
+            
+            loaded = true;
+        }
+        
+        std::uint32_t mask =
+            i.second == 0 ? 0 : 0xffffffff << (32 - i.second)
+        ;
+        
+        auto matched = new_label();
+        auto next = new_label();
+        
+        emit(BPF_MISC | BPF_TXA, 0);
+        emit(BPF_ALU | BPF_AND | BPF_K, mask);
+        emit_jump(
+            BPF_JMP | BPF_JEQ | BPF_K,
+            static_cast<std::uint32_t> (i.first.to_v4().to_ulong()) & mask,
+            matched, next
+        );
+        
+        /**
+         * Drop right here, a shared drop would soon be out of range.
+         */
+        bind(matched);
+        emit(BPF_RET | BPF_K, 0);
+        
+        bind(next);
+    }
+#endif // __linux__
+}
+
+void socket_filter::emit_allowed_ipv6(const configuration & config)
+{
+#if (defined __linux__)
+    for (auto & i : config.allowed_sources())
+    {
+        if (i.first.is_v6() == false)
+        {
+            continue;
+        }
+        
+        auto bytes = i.first.to_v6().to_bytes();
+        
+        auto next = new_label();
+        
+        std::size_t bits = i.second;
+        
+        /**
+         * Compare a word at a time, a full match of every word within the
+         * prefix drops the packet.
+         */
+        for (std::size_t j = 0; j < 4; j++)
+        {
+            std::uint32_t mask =
+                bits >= 32 ? 0xffffffff :
+                bits == 0 ? 0 : 0xffffffff << (32 - bits)
+            ;
+            
+            bits -= std::min(bits, static_cast<std::size_t> (32));
+            
+            if (mask == 0)
+            {
+                break;
+            }
+            
+            std::uint32_t word =
+                (static_cast<std::uint32_t> (bytes[j * 4]) << 24) | (bytes[j * 4 + 1] << 16) |
+                (bytes[j * 4 + 2] << 8) | bytes[j * 4 + 3]
+            ;
+            
+            emit(BPF_LD | BPF_W | BPF_ABS, net + 8 + j * 4);
+            
+            if (mask != 0xffffffff)
+            {
+                emit(BPF_ALU | BPF_AND | BPF_K, mask);
+            }
+            
+            auto matched = new_label();
+            
+            emit_jump(BPF_JMP | BPF_JEQ | BPF_K, word & mask, matched, next);
+            bind(matched);
+        }
+        
+        emit(BPF_RET | BPF_K, 0);
+        
+        bind(next);
+    }
+#endif // __linux__
+}
+
+void socket_filter::emit_scan_probe(
+    const configuration & config, const std::uint32_t & port_offset,
+    const bool & indirect, const label_t & accept, const label_t & drop
+    )
+{
+#if (defined __linux__)
+    auto no_ack = new_label();
+    auto syn = new_label();
+    
+    /**
+     * Anything carrying an ACK or RST is part of a real conversation.
+     */
+    emit_jump(BPF_JMP | BPF_JSET | BPF_K, 0x14, drop, no_ack);
+    bind(no_ack);
+    
+    /**
+     * FIN, NULL and XMAS probes are interesting on any port.
+     */
+    emit(BPF_ALU | BPF_AND | BPF_K, 0x3f);
+    emit_jump(BPF_JMP | BPF_JEQ | BPF_K, 0x02, syn, accept);
+    
+    /**
+     * A plain SYN only counts on a monitored port.
+     */
+    bind(syn);
+    emit(BPF_LD | BPF_H | (indirect ? BPF_IND : BPF_ABS), port_offset);
+    emit_monitored_port(config, accept);
+#endif // __linux__
+}
+
+void socket_filter::emit_monitored_port(
+    const configuration & config, const label_t & accept
+    )
+{
+#if (defined __linux__)
+    for (auto & i : config.port_ranges())
+    {
+        auto in_range = new_label();
+        auto next = new_label();
+        
+        emit_jump(BPF_JMP | BPF_JGE | BPF_K, i.first, in_range, next);
+        bind(in_range);
+        emit_jump(BPF_JMP | BPF_JGT | BPF_K, i.second, next, accept);
+        bind(next);
+    }
+    
+    emit(BPF_RET | BPF_K, 0);
+#endif // __linux__
+}
+
+void socket_filter::resolve()
+{
+#if (defined __linux__)
+    if (m_instructions.size() > BPF_MAXINSNS)
+    {
+        throw std::runtime_error("socket filter is too large");
+    }
+    
+    for (auto & i : m_jumps)
+    {
+        auto & instruction = m_instructions[i.first];
+        
+        auto jt = m_labels[i.second.first];
+        auto jf = m_labels[i.second.second];
+        
+        /**
+         * Classic BPF only jumps forward by at most 255 instructions.
+         */
+        if (
+            jt <= i.first || jf <= i.first ||
+            jt - i.first - 1 > 255 || jf - i.first - 1 > 255
+            )
+        {
+            throw std::runtime_error("socket filter jump is out of range");
+        }
+        
+        instruction.jt = static_cast<std::uint8_t> (jt - i.first - 1);
+        instruction.jf = static_cast<std::uint8_t> (jf - i.first - 1);
+    }
+    
+    for (auto & i : m_long_jumps)
+    {
+        auto target = m_labels[i.second];
+        
+        if (target <= i.first)
+        {
+            throw std::runtime_error("socket filter jump is out of range");
+        }
+        
+        m_instructions[i.first].k = static_cast<std::uint32_t> (
+            target - i.first - 1
+        );
+    }
+#endif // __linux__
+    m_jumps.clear();
+    m_long_jumps.clear();
+}
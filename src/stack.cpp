@@ -31,7 +31,7 @@ stack::stack()
     // ...
 }
 
-void stack::start()
+void stack::start(const std::map<std::string, std::string> & args)
 {
     if (stack_impl_ != nullptr)
     {
@@ -41,7 +41,7 @@ void stack::start()
     {
         stack_impl_ = new stack_impl();
         
-        stack_impl_->start();
+        stack_impl_->start(args);
     }
 }
 
@@ -58,3 +58,15 @@ void stack::stop()
         delete stack_impl_; stack_impl_ = nullptr;
     }
 }
+
+void stack::replay()
+{
+    if (stack_impl_ == nullptr)
+    {
+        assert(0);
+    }
+    else
+    {
+        stack_impl_->replay();
+    }
+}
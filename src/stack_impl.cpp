@@ -18,18 +18,24 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
+#include <opensentinel/affinity.hpp>
 #include <opensentinel/alert_manager.hpp>
+#include <opensentinel/capture_manager.hpp>
+#include <opensentinel/evidence_writer.hpp>
 #include <opensentinel/icmp_manager.hpp>
 #include <opensentinel/filesystem.hpp>
 #include <opensentinel/logger.hpp>
+#include <opensentinel/replay_manager.hpp>
 #include <opensentinel/stack_impl.hpp>
 #include <opensentinel/tcp_manager.hpp>
 #include <opensentinel/threat.hpp>
 #include <opensentinel/threat_manager.hpp>
 #include <opensentinel/udp_manager.hpp>
+#include <opensentinel/uring_manager.hpp>
 #include <opensentinel/utility.hpp>
 
 using namespace opensentinel;
@@ -37,12 +43,11 @@ using namespace opensentinel;
 stack_impl::stack_impl()
     : state_(state_none)
     , strand_network_(io_service_network_)
-    , timer_network_(io_service_network_)
 {
     // ...
 }
 
-void stack_impl::start()
+void stack_impl::start(const std::map<std::string, std::string> & args)
 {
     log_init(filesystem::data_path() + "debug.log");
     
@@ -50,6 +55,11 @@ void stack_impl::start()
     
     state_ = state_starting;
     
+    /**
+     * Load the configuration.
+     */
+    m_configuration.load(args);
+    
     /**
      * Initialize the home (application) directories.
      */
@@ -67,16 +77,23 @@ void stack_impl::start()
     );
     
     /**
-     * Allocate the tcp_manager.
+     * Prefer the NUMA node of the capture interface (unless configured)
+     * while starting, the threads started below inherit the memory policy
+     * so their rings and buffer pools are allocated on it.
      */
-    m_tcp_manager = std::make_shared<tcp_manager> (
-        *this, io_service_network_, strand_network_
-    );
+    auto numa_node = m_configuration.numa_node();
     
-    /**
-     * Start the tcp_manager.
-     */
-    m_tcp_manager->start();
+    if (numa_node < 0 && m_configuration.capture_interface().size() > 0)
+    {
+        numa_node = affinity::interface_node(
+            m_configuration.capture_interface()
+        );
+    }
+    
+    if (numa_node >= 0 && affinity::set_preferred_node(numa_node))
+    {
+        log_info("Stack is allocating on NUMA node " << numa_node << ".");
+    }
     
     /**
      * Allocate the threat_manager.
@@ -93,60 +110,204 @@ void stack_impl::start()
      */
     m_alert_manager = std::make_shared<alert_manager> ();
     
+    m_alert_manager->set_backpressure(
+        m_configuration.alert_policy(), m_configuration.sample_rate()
+    );
+    
+    m_alert_manager->set_cpus(m_configuration.cpus("alert"));
+    
     /**
      * Start the alert_manager.
      */
     m_alert_manager->start();
     
-    try
+    if (m_configuration.evidence_path().size() > 0)
     {
-        /**
-         * Allocate the icmp_manager.
-         */
-        m_icmp_manager = std::make_shared<icmp_manager> (*this);
+        try
+        {
+            filesystem::create_path(m_configuration.evidence_path());
+            
+            /**
+             * Allocate the evidence_writer.
+             */
+            m_evidence_writer = std::make_shared<evidence_writer> ();
+            
+            m_evidence_writer->set_cpus(m_configuration.cpus("evidence"));
+            
+            /**
+             * Start the evidence_writer.
+             */
+            m_evidence_writer->start(
+                m_configuration.evidence_path(),
+                m_configuration.evidence_segment_size(),
+                m_configuration.evidence_segment_count()
+            );
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Stack failed to start evidence_writer, what = " <<
+                e.what() << "."
+            );
+            
+            m_evidence_writer.reset();
+        }
+    }
+    
+    /**
+     * A replay runs without any live sockets.
+     */
+    auto is_live = m_configuration.replay_file().empty();
+    
+    if (is_live == false)
+    {
+        log_info("Stack is in replay mode, not opening any sockets.");
         
         /**
-         * Start the icmp_manager.
+         * Do not execute the threat alert file for every replayed alert.
          */
-        m_icmp_manager->start();
+        m_alert_manager->set_execute_threat_alert(false);
     }
-    catch (std::exception & e)
+    else if (m_configuration.capture_interface().size() > 0)
     {
-        log_error(
-            "Stack failed to start icmp_manager, what = " << e.what() << "."
-        );
+        try
+        {
+            /**
+             * Allocate the capture_manager.
+             */
+            m_capture_manager = std::make_shared<capture_manager> (*this);
+            
+            /**
+             * Start the capture_manager.
+             */
+            m_capture_manager->start();
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Stack failed to start capture_manager, what = " <<
+                e.what() << "."
+            );
+            
+            m_capture_manager = nullptr;
+        }
+    }
+    
+    if (
+        is_live == true && m_capture_manager == nullptr &&
+        m_configuration.io_uring() == true
+        )
+    {
+        try
+        {
+            /**
+             * Allocate the uring_manager.
+             */
+            m_uring_manager = std::make_shared<uring_manager> (*this);
+            
+            /**
+             * Start the uring_manager.
+             */
+            m_uring_manager->start();
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Stack failed to start uring_manager, falling back to asio, "
+                "what = " << e.what() << "."
+            );
+            
+            m_uring_manager = nullptr;
+        }
     }
-
-    /**
-     * Allocate the udp_manager.
-     */
-    m_udp_manager = std::make_shared<udp_manager> (
-        *this, io_service_network_, strand_network_
-    );
     
     /**
-     * Start the udp_manager.
-     */
-    m_udp_manager->start();
-
-    /**
-     * Starts the network timer.
+     * The capture_manager covers every port with a single socket, only
+     * fall back to the per port sockets if it is not running.
      */
-    timer_network_.expires_from_now(std::chrono::seconds(1));
-    timer_network_.async_wait(strand_network_.wrap([this](std::error_code ec)
+    if (
+        is_live == true && m_capture_manager == nullptr &&
+        m_uring_manager == nullptr
+        )
     {
-        if (ec)
+        /**
+         * Start the network io_service_pool, the timers of the managers
+         * stay on the network thread.
+         */
+        if (m_configuration.network_threads() > 1)
+        {
+            io_service_pool_network_.start(
+                m_configuration.network_threads(),
+                m_configuration.cpus("network")
+            );
+        }
+        
+        /**
+         * Allocate the tcp_manager.
+         */
+        m_tcp_manager = std::make_shared<tcp_manager> (
+            *this, io_service_network_, strand_network_,
+            io_service_pool_network_
+        );
+        
+        /**
+         * Start the tcp_manager.
+         */
+        m_tcp_manager->start();
+        
+        try
         {
-            // ...
+            /**
+             * Allocate the icmp_manager.
+             */
+            m_icmp_manager = std::make_shared<icmp_manager> (*this);
+            
+            /**
+             * Start the icmp_manager.
+             */
+            m_icmp_manager->start();
         }
-        else
+        catch (std::exception & e)
         {
-            on_tick_network();
+            log_error(
+                "Stack failed to start icmp_manager, what = " << e.what() <<
+                "."
+            );
         }
-    }));
+        
+        /**
+         * Allocate the udp_manager.
+         */
+        m_udp_manager = std::make_shared<udp_manager> (
+            *this, io_service_network_, strand_network_,
+            io_service_pool_network_
+        );
+        
+        /**
+         * Start the udp_manager.
+         */
+        m_udp_manager->start();
+    }
+
+    /**
+     * Keep the network std::thread running while the sockets are idle.
+     */
+    work_network_ = std::make_shared<asio::io_service::work> (
+        io_service_network_
+    );
 
     thread_network_ = std::thread(&stack_impl::network_run, this);
     
+    affinity::pin(thread_network_, m_configuration.cpus("network"));
+    
+    /**
+     * Later allocations (of this thread) are back to the default policy.
+     */
+    if (numa_node >= 0)
+    {
+        affinity::set_preferred_node(-1);
+    }
+    
     state_ = state_started;
     
     log_info("Stack has started.");
@@ -159,32 +320,32 @@ void stack_impl::stop()
     state_ = state_stopping;
 
     /**
-     * Cancel the network timer.
+     * Let the network std::thread exit once the sockets are closed.
      */
-    timer_network_.cancel();
+    work_network_ = nullptr;
     
     /**
-     * Stop the tcp_manager.
+     * Stop the capture_manager.
      */
-    if (m_tcp_manager != nullptr)
+    if (m_capture_manager != nullptr)
     {
-        m_tcp_manager->stop();
+        m_capture_manager->stop();
     }
     
     /**
-     * Stop the threat_manager.
+     * Stop the uring_manager.
      */
-    if (m_threat_manager != nullptr)
+    if (m_uring_manager != nullptr)
     {
-        m_threat_manager->stop();
+        m_uring_manager->stop();
     }
     
     /**
-     * Stop the alert_manager.
+     * Stop the tcp_manager.
      */
-    if (m_alert_manager != nullptr)
+    if (m_tcp_manager != nullptr)
     {
-        m_alert_manager->stop();
+        m_tcp_manager->stop();
     }
     
     /**
@@ -203,27 +364,138 @@ void stack_impl::stop()
         m_udp_manager->stop();
     }
     
+    /**
+     * Stop the network io_service_pool once the sockets are closed, every
+     * producer is stopped before the threat_manager drains.
+     */
+    io_service_pool_network_.stop();
+    
     if (thread_network_.joinable() == true)
     {
         thread_network_.join();
     }
     
+    /**
+     * Stop the threat_manager.
+     */
+    if (m_threat_manager != nullptr)
+    {
+        m_threat_manager->stop();
+    }
+    
+    /**
+     * Stop the evidence_writer.
+     */
+    if (m_evidence_writer != nullptr)
+    {
+        m_evidence_writer->stop();
+    }
+    
+    /**
+     * Stop the alert_manager.
+     */
+    if (m_alert_manager != nullptr)
+    {
+        m_alert_manager->stop();
+    }
+    
     m_tcp_manager = nullptr;
     
+    m_capture_manager = nullptr;
+    
+    m_uring_manager = nullptr;
+    
     state_ = state_stopped;
     
     log_info("Stack has stopped.");
 }
 
+void stack_impl::replay()
+{
+    if (m_configuration.replay_file().empty())
+    {
+        throw std::runtime_error("no replay file");
+    }
+    
+    replay_manager replayer(*this);
+    
+    auto time_start = std::chrono::steady_clock::now();
+    
+    try
+    {
+        replayer.run(
+            m_configuration.replay_file(), m_configuration.replay_realtime()
+        );
+    }
+    catch (std::exception & e)
+    {
+        log_error("Stack failed to replay, what = " << e.what() << ".");
+    }
+    
+    /**
+     * Wait for the threat_manager and then the alert_manager to drain.
+     */
+    if (m_threat_manager != nullptr)
+    {
+        m_threat_manager->flush();
+    }
+    
+    if (m_alert_manager != nullptr)
+    {
+        m_alert_manager->flush();
+    }
+    
+    auto elapsed = std::chrono::duration_cast<
+        std::chrono::duration<double>
+    > (std::chrono::steady_clock::now() - time_start).count();
+    
+    if (elapsed <= 0.0)
+    {
+        elapsed = 1e-9;
+    }
+    
+    auto alerts = m_alert_manager != nullptr ? m_alert_manager->alerts() : 0;
+    
+    auto dropped =
+        m_threat_manager != nullptr ? m_threat_manager->threats_dropped() : 0
+    ;
+    
+    if (m_alert_manager != nullptr)
+    {
+        dropped += m_alert_manager->threats_dropped();
+    }
+    
+    log_info(
+        "Stack replayed " << replayer.packets() << " packets in " <<
+        elapsed << " seconds, packets/s = " <<
+        static_cast<std::uint64_t> (replayer.packets() / elapsed) <<
+        ", threats = " << replayer.threats() << ", threats/s = " <<
+        static_cast<std::uint64_t> (replayer.threats() / elapsed) <<
+        ", alerts = " << alerts << ", alerts/s = " <<
+        static_cast<std::uint64_t> (alerts / elapsed) <<
+        ", threats dropped = " << dropped << "."
+    );
+}
+
 void stack_impl::on_threat(const threat & threat_data)
 {
-    strand_network_.dispatch([this, threat_data]()
+    /**
+     * Sources allow-listed are normally dropped in the kernel by the
+     * socket_filter, this catches platforms (and sockets) without one.
+     */
+    if (m_configuration.is_allowed_source(threat_data.address()))
     {
-        if (m_threat_manager != nullptr)
-        {
-            m_threat_manager->on_threat(threat_data);
-        }
-    });
+        return;
+    }
+    
+    /**
+     * The threat_manager queues the threat on a lock-free ring so every
+     * thread hands threats over directly.
+     */
+    if (m_threat_manager != nullptr)
+    {
+        m_threat_manager->on_threat(threat_data);
+    }
 }
 
 std::shared_ptr<alert_manager> & stack_impl::get_alert_manager()
@@ -231,23 +503,14 @@ std::shared_ptr<alert_manager> & stack_impl::get_alert_manager()
     return m_alert_manager;
 }
 
-void stack_impl::on_tick_network()
+std::shared_ptr<evidence_writer> & stack_impl::get_evidence_writer()
 {
-    /**
-     * Starts the network timer.
-     */
-    timer_network_.expires_from_now(std::chrono::seconds(1));
-    timer_network_.async_wait(strand_network_.wrap([this](std::error_code ec)
-    {
-        if (ec)
-        {
-            // ...
-        }
-        else
-        {
-            on_tick_network();
-        }
-    }));
+    return m_evidence_writer;
+}
+
+const configuration & stack_impl::get_configuration() const
+{
+    return m_configuration;
 }
 
 void stack_impl::network_run()
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if (defined __linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <opensentinel/logger.hpp>
+#include <opensentinel/stage_signal.hpp>
+
+using namespace opensentinel;
+
+stage_signal::stage_signal(asio::io_service & ios, asio::strand & s)
+    : io_service_(ios)
+    , strand_(s)
+    , pending_(false)
+#if (defined __linux__)
+    , eventfd_(ios)
+#endif // __linux__
+{
+    // ...
+}
+
+void stage_signal::start(const std::function<void ()> & f)
+{
+    m_on_signal = f;
+    
+#if (defined __linux__)
+    /**
+     * Allocate the eventfd the producers signal.
+     */
+    auto fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    eventfd_.assign(fd);
+    
+    async_wait();
+#endif // __linux__
+}
+
+void stage_signal::stop()
+{
+#if (defined __linux__)
+    /**
+     * Cancel the wait, the eventfd stays open for late producers.
+     */
+    io_service_.post(strand_.wrap([this]()
+    {
+        if (eventfd_.is_open())
+        {
+            eventfd_.cancel();
+        }
+    }));
+#endif // __linux__
+}
+
+void stage_signal::notify()
+{
+    if (pending_.exchange(true) == true)
+    {
+        return;
+    }
+    
+#if (defined __linux__)
+    std::uint64_t val = 1;
+    
+    if (write(eventfd_.native_handle(), &val, sizeof(val)) < 0)
+    {
+        log_debug(
+            "Stage signal failed to write eventfd, message = " <<
+            std::strerror(errno) << "."
+        );
+    }
+#else
+    io_service_.post(strand_.wrap(m_on_signal));
+#endif // __linux__
+}
+
+void stage_signal::clear()
+{
+    pending_ = false;
+}
+
+#if (defined __linux__)
+void stage_signal::async_wait()
+{
+    eventfd_.async_read_some(asio::null_buffers(), strand_.wrap(
+        [this](const std::error_code & ec, const std::size_t &)
+    {
+        if (ec)
+        {
+            // ...
+        }
+        else
+        {
+            /**
+             * Reset the eventfd counter.
+             */
+            std::uint64_t val;
+            
+            if (read(eventfd_.native_handle(), &val, sizeof(val)) < 0)
+            {
+                // ...
+            }
+            
+            m_on_signal();
+            
+            async_wait();
+        }
+    }));
+}
+#endif // __linux__
@@ -18,6 +18,19 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if (defined __linux__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/**
+ * From linux/netfilter_ipv4.h which conflicts with netinet/in.h.
+ */
+#ifndef SO_ORIGINAL_DST
+#define SO_ORIGINAL_DST 80
+#endif // SO_ORIGINAL_DST
+#endif // __linux__
+
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -27,8 +40,20 @@
 
 using namespace opensentinel;
 
+#if (! defined _MSC_VER)
+/**
+ * The SO_REUSEPORT socket option.
+ */
+typedef asio::detail::socket_option::boolean<
+    SOL_SOCKET, SO_REUSEPORT
+> reuse_port;
+#endif // _MSC_VER
+
 tcp_acceptor::tcp_acceptor(asio::io_service & ios)
-    : state_(state_none)
+    : m_transparent(false)
+    , m_reuse_port(false)
+    , m_dual_stack(false)
+    , state_(state_none)
     , io_service_(ios)
     , strand_(ios)
     , acceptor_ipv4_(io_service_)
@@ -50,63 +75,105 @@ std::error_code tcp_acceptor::open(const std::uint16_t & port)
     std::error_code ec;
     
     /**
-     * Allocate the ipv4 endpoint.
-     */
-    asio::ip::tcp::endpoint ipv4_endpoint(
-        asio::ip::address_v4::any(), port
-    );
-    
-    /**
-     * Open the ipv4 socket.
+     * A dual-stack acceptor receives ipv4 connections as v4-mapped.
      */
-    acceptor_ipv4_.open(asio::ip::tcp::v4(), ec);
-    
-    if (ec)
+    if (m_dual_stack == false)
     {
-        log_error("ipv4 open failed, message = " << ec.message());
+        /**
+         * Allocate the ipv4 endpoint.
+         */
+        asio::ip::tcp::endpoint ipv4_endpoint(
+            asio::ip::address_v4::any(), port
+        );
         
-        acceptor_ipv4_.close();
+        /**
+         * Open the ipv4 socket.
+         */
+        acceptor_ipv4_.open(asio::ip::tcp::v4(), ec);
         
-        return ec;
-    }
-    
-    /**
-     * Set option SO_REUSEADDR.
-     */
-    acceptor_ipv4_.set_option(
-        asio::ip::tcp::acceptor::reuse_address(true)
-    );
-    
-    /**
-     * Bind the socket.
-     */
-    acceptor_ipv4_.bind(ipv4_endpoint, ec);
-   
-    if (ec)
-    {
-        log_error("ipv4 bind failed, message = " << ec.message());
+        if (ec)
+        {
+            log_error("ipv4 open failed, message = " << ec.message());
+            
+            acceptor_ipv4_.close();
+            
+            return ec;
+        }
         
-        acceptor_ipv4_.close();
+        /**
+         * Set option SO_REUSEADDR.
+         */
+        acceptor_ipv4_.set_option(
+            asio::ip::tcp::acceptor::reuse_address(true)
+        );
+
+#if (! defined _MSC_VER)
+        /**
+         * Set option SO_REUSEPORT.
+         */
+        if (m_reuse_port == true)
+        {
+            acceptor_ipv4_.set_option(reuse_port(true));
+        }
+#endif // _MSC_VER
+
+#if (defined __linux__)
+        /**
+         * Set option IP_TRANSPARENT.
+         */
+        if (m_transparent == true)
+        {
+            int enable = 1;
+            
+            if (
+                setsockopt(acceptor_ipv4_.native_handle(), SOL_IP,
+                IP_TRANSPARENT, &enable, sizeof(enable)) != 0
+                )
+            {
+                ec = std::error_code(errno, std::generic_category());
+                
+                log_error(
+                    "ipv4 transparent failed, message = " << ec.message()
+                );
+                
+                acceptor_ipv4_.close();
+                
+                return ec;
+            }
+        }
+#endif // __linux__
+
+        /**
+         * Bind the socket.
+         */
+        acceptor_ipv4_.bind(ipv4_endpoint, ec);
         
-        return ec;
+        if (ec)
+        {
+            log_error("ipv4 bind failed, message = " << ec.message());
+            
+            acceptor_ipv4_.close();
+            
+            return ec;
+        }
+        
+        /**
+         * Listen
+         */
+        acceptor_ipv4_.listen();
+        
+        /**
+         * Accept
+         */
+        do_ipv4_accept();
     }
     
-    /**
-     * Listen
-     */
-    acceptor_ipv4_.listen();
-    
-    /**
-     * Accept
-     */
-    do_ipv4_accept();
-    
     /**
      * Allocate the ipv6 endpoint.
      */
     asio::ip::tcp::endpoint ipv6_endpoint(
-        asio::ip::address_v6::any(),
-        acceptor_ipv4_.local_endpoint().port()
+        asio::ip::address_v6::any(), acceptor_ipv4_.is_open() ?
+        acceptor_ipv4_.local_endpoint().port() : port
     );
     
     /**
@@ -125,7 +192,7 @@ std::error_code tcp_acceptor::open(const std::uint16_t & port)
     }
     
 #if defined(__linux__) || defined(__APPLE__)
-    acceptor_ipv6_.set_option(asio::ip::v6_only(true));
+    acceptor_ipv6_.set_option(asio::ip::v6_only(m_dual_stack == false));
 #endif
 
     /**
@@ -135,6 +202,41 @@ std::error_code tcp_acceptor::open(const std::uint16_t & port)
         asio::ip::tcp::acceptor::reuse_address(true)
     );
     
+#if (! defined _MSC_VER)
+    /**
+     * Set option SO_REUSEPORT.
+     */
+    if (m_reuse_port == true)
+    {
+        acceptor_ipv6_.set_option(reuse_port(true));
+    }
+#endif // _MSC_VER
+    
+#if (defined __linux__)
+    /**
+     * Set option IPV6_TRANSPARENT.
+     */
+    if (m_transparent == true)
+    {
+        int enable = 1;
+        
+        if (
+            setsockopt(acceptor_ipv6_.native_handle(), SOL_IPV6,
+            IPV6_TRANSPARENT, &enable, sizeof(enable)) != 0
+            )
+        {
+            ec = std::error_code(errno, std::generic_category());
+            
+            log_error("ipv6 transparent failed, message = " << ec.message());
+            
+            acceptor_ipv4_.close();
+            acceptor_ipv6_.close();
+            
+            return ec;
+        }
+    }
+#endif // __linux__
+    
     /**
      * Bind the socket.
      */
@@ -170,6 +272,21 @@ std::error_code tcp_acceptor::open(const std::uint16_t & port)
     return ec;
 }
 
+void tcp_acceptor::set_transparent(const bool & val)
+{
+    m_transparent = val;
+}
+
+void tcp_acceptor::set_reuse_port(const bool & val)
+{
+    m_reuse_port = val;
+}
+
+void tcp_acceptor::set_dual_stack(const bool & val)
+{
+    m_dual_stack = val;
+}
+
 void tcp_acceptor::close()
 {
     log_info(
@@ -230,6 +347,36 @@ const asio::ip::tcp::endpoint tcp_acceptor::local_endpoint() const
     ;
 }
 
+asio::ip::tcp::endpoint tcp_acceptor::original_destination(
+    asio::ip::tcp::socket & s
+    )
+{
+    std::error_code ec;
+    
+    auto ret = s.local_endpoint(ec);
+    
+#if (defined __linux__)
+    /**
+     * IP6T_SO_ORIGINAL_DST shares the value of SO_ORIGINAL_DST.
+     */
+    asio::ip::tcp::endpoint ep;
+    
+    socklen_t len = ep.capacity();
+    
+    if (
+        !ec && getsockopt(s.native_handle(), ret.address().is_v4() ?
+        SOL_IP : SOL_IPV6, SO_ORIGINAL_DST, ep.data(), &len) == 0
+        )
+    {
+        ep.resize(len);
+        
+        ret = ep;
+    }
+#endif // __linux__
+    
+    return ret;
+}
+
 void tcp_acceptor::do_ipv4_accept()
 {
     if (state_ == state_starting || state_ == state_started)
@@ -347,7 +494,7 @@ void tcp_acceptor::do_ipv6_accept()
 
 void tcp_acceptor::do_tick(const std::uint32_t & seconds)
 {
-    if (state_ == state_starting || state_ == state_starting)
+    if (state_ == state_starting || state_ == state_started)
     {
         transports_timer_.expires_from_now(std::chrono::seconds(seconds));
         transports_timer_.async_wait(strand_.wrap(
@@ -18,6 +18,9 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
+#include <opensentinel/configuration.hpp>
 #include <opensentinel/logger.hpp>
 #include <opensentinel/stack_impl.hpp>
 #include <opensentinel/tcp_acceptor.hpp>
@@ -28,13 +31,15 @@
 using namespace opensentinel;
 
 tcp_manager::tcp_manager(
-    stack_impl & owner, asio::io_service & ios, asio::strand & s
+    stack_impl & owner, asio::io_service & ios, asio::strand & s,
+    io_service_pool & pool
     )
     : state_(state_none)
     , stack_impl_(owner)
     , io_service_(ios)
     , strand_(s)
     , timer_(ios)
+    , io_service_pool_(pool)
 {
     // ...
 }
@@ -61,14 +66,25 @@ void tcp_manager::start()
         }
     }));
 
-    /**
-     * Open the tcp_acceptor objects.
-     * @note Skip NetBios, bootps and bootpc.
-     */
-    open_tcp_acceptors(1 /* tcpmux */, 66 /* sql-net */);
-    open_tcp_acceptors(69 /* tftp */, 136 /* profile */);
-    open_tcp_acceptors(140 /* emfis-data */, 2028 /* dls-monitor */);
-    open_tcp_acceptors(8080 /* http-alt */, 8280 /* synapse-nhttp */);
+    auto transparent_port = stack_impl_.get_configuration().transparent_port();
+    
+    if (transparent_port > 0)
+    {
+        /**
+         * Open a single transparent tcp_acceptor for every redirected port.
+         */
+        open_tcp_acceptors(transparent_port, transparent_port, true);
+    }
+    else
+    {
+        /**
+         * Open the tcp_acceptor objects for each monitored port range.
+         */
+        for (auto & i : stack_impl_.get_configuration().port_ranges())
+        {
+            open_tcp_acceptors(i.first, i.second, false);
+        }
+    }
 
     state_ = state_started;
     
@@ -132,12 +148,36 @@ void tcp_manager::on_tick()
 }
 
 void tcp_manager::open_tcp_acceptors(
-    const std::uint16_t & port_begin, const std::uint16_t & port_end
+    const std::uint16_t & port_begin, const std::uint16_t & port_end,
+    const bool & transparent
     )
 {
-    for (auto i = port_begin; i < (port_end + 1); i++)
+    /**
+     * When sharded each port is opened once per asio::io_service of the
+     * io_service_pool with SO_REUSEPORT.
+     */
+    std::size_t shards = std::max(
+        static_cast<std::size_t> (1), io_service_pool_.size()
+    );
+    
+    std::size_t count = (port_end - port_begin + 1) * shards;
+    
+    for (std::size_t k = 0; k < count; k++)
     {
-        auto acceptor = std::make_shared<tcp_acceptor> (io_service_);
+        std::uint16_t i = port_begin + k / shards;
+        
+        auto acceptor = std::make_shared<tcp_acceptor> (
+            shards > 1 ? io_service_pool_.get_io_service(k % shards) :
+            io_service_
+        );
+        
+        acceptor->set_transparent(transparent);
+        
+        acceptor->set_reuse_port(shards > 1);
+        
+        acceptor->set_dual_stack(
+            stack_impl_.get_configuration().dual_stack()
+        );
     
         auto ec = acceptor->open(i);
         
@@ -159,12 +199,33 @@ void tcp_manager::open_tcp_acceptors(
         else
         {
             acceptor->set_on_accept(
-                [this](std::shared_ptr<tcp_transport> transport)
+                [this, transparent](std::shared_ptr<tcp_transport> transport)
                 {
                     auto remote_endpoint =
                         transport->socket().remote_endpoint()
                     ;
                     
+                    /**
+                     * The address and port that was probed.
+                     */
+                    auto destination = tcp_acceptor::original_destination(
+                        transport->socket()
+                    );
+                    
+                    auto destination_port = destination.port();
+                    
+                    /**
+                     * A transparent acceptor may be handed ports outside of
+                     * the monitored port ranges.
+                     */
+                    if (
+                        transparent == true && stack_impl_.get_configuration(
+                        ).is_monitored_port(destination_port) == false
+                        )
+                    {
+                        return;
+                    }
+                    
                     /**
                      * Allocate the threat.
                      */
@@ -172,6 +233,9 @@ void tcp_manager::open_tcp_acceptors(
                         threat::protocol_tcp, remote_endpoint.address(),
                         remote_endpoint.port(), 0, 0
                     );
+                    
+                    threat_data.set_destination_address(destination.address());
+                    threat_data.set_destination_port(destination_port);
 
                     log_info(
                         "TCP manager has detected a possible threat (TCP Accept) "
@@ -188,7 +252,8 @@ void tcp_manager::open_tcp_acceptors(
                      * Set the transport on read handler.
                      */
                     transport->set_on_read(
-                        [this](std::shared_ptr<tcp_transport> t,
+                        [this, destination, destination_port](
+                        std::shared_ptr<tcp_transport> t,
                         const char * buf, const std::size_t & len)
                     {
                         try
@@ -202,6 +267,13 @@ void tcp_manager::open_tcp_acceptors(
                                 threat::protocol_tcp, remote_endpoint.address(),
                                 remote_endpoint.port(), buf, len
                             );
+                            
+                            threat_data.set_destination_address(
+                                destination.address()
+                            );
+                            threat_data.set_destination_port(
+                                destination_port
+                            );
         
                             log_info(
                                 "TCP manager has detected a possible threat "
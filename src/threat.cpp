@@ -29,11 +29,21 @@ threat::threat(
     )
     : m_address(addr)
     , m_port(port)
+    , m_destination_port(0)
     , m_buffer(buf, buf + len)
+    , m_timestamp(std::chrono::system_clock::now())
     , m_level(level_0)
     , m_protocol(proto)
+    , m_scan_type(scan_type_none)
+    , m_rate(0.0)
 {
-    // ...
+    /**
+     * Dual-stack sockets report ipv4 peers as v4-mapped ipv6 addresses.
+     */
+    if (m_address.is_v6() && m_address.to_v6().is_v4_mapped())
+    {
+        m_address = m_address.to_v6().to_v4();
+    }
 }
 
 const asio::ip::address & threat::address() const
@@ -46,6 +56,34 @@ const std::uint16_t & threat::port() const
     return m_port;
 }
 
+void threat::set_destination_port(const std::uint16_t & val)
+{
+    m_destination_port = val;
+}
+
+const std::uint16_t & threat::destination_port() const
+{
+    return m_destination_port;
+}
+
+void threat::set_destination_address(const asio::ip::address & val)
+{
+    m_destination_address = val;
+    
+    if (
+        m_destination_address.is_v6() &&
+        m_destination_address.to_v6().is_v4_mapped()
+        )
+    {
+        m_destination_address = m_destination_address.to_v6().to_v4();
+    }
+}
+
+const asio::ip::address & threat::destination_address() const
+{
+    return m_destination_address;
+}
+
 std::vector<char> & threat::buffer()
 {
     return m_buffer;
@@ -56,6 +94,26 @@ const std::vector<char> & threat::buffer() const
     return m_buffer;
 }
 
+void threat::set_packet(const std::uint8_t * buf, const std::size_t & len)
+{
+    m_packet.assign(buf, buf + len);
+}
+
+const std::vector<std::uint8_t> & threat::packet() const
+{
+    return m_packet;
+}
+
+void threat::set_timestamp(const std::chrono::system_clock::time_point & val)
+{
+    m_timestamp = val;
+}
+
+const std::chrono::system_clock::time_point & threat::timestamp() const
+{
+    return m_timestamp;
+}
+
 void threat::set_level(const level_t & val)
 {
     m_level = val;
@@ -147,6 +205,94 @@ const std::string threat::protocol_string() const
     return ret;
 }
 
+void threat::set_scan_type(const scan_type_t & val)
+{
+    m_scan_type = val;
+}
+
+const threat::scan_type_t & threat::scan_type() const
+{
+    return m_scan_type;
+}
+
+const std::string threat::scan_type_string() const
+{
+    std::string ret;
+    
+    switch (m_scan_type)
+    {
+        case scan_type_none:
+        {
+            ret = "NONE";
+        }
+        break;
+        case scan_type_tcp_syn:
+        {
+            ret = "SYN_SCAN";
+        }
+        break;
+        case scan_type_tcp_fin:
+        {
+            ret = "FIN_SCAN";
+        }
+        break;
+        case scan_type_tcp_null:
+        {
+            ret = "NULL_SCAN";
+        }
+        break;
+        case scan_type_tcp_xmas:
+        {
+            ret = "XMAS_SCAN";
+        }
+        break;
+        case scan_type_vertical:
+        {
+            ret = "VERTICAL_SCAN";
+        }
+        break;
+        case scan_type_sweep:
+        {
+            ret = "SWEEP";
+        }
+        break;
+        case scan_type_probe:
+        {
+            ret = "PROBE";
+        }
+        break;
+        case scan_type_flood:
+        {
+            ret = "FLOOD";
+        }
+        break;
+        default:
+        break;
+    }
+    
+    return ret;
+}
+
+void threat::set_rate(const double & val)
+{
+    m_rate = val;
+}
+
+const double & threat::rate() const
+{
+    return m_rate;
+}
+
+void threat::set_signatures(const std::vector<std::uint32_t> & val)
+{
+    m_signatures = val;
+}
+
+const std::vector<std::uint32_t> & threat::signatures() const
+{
+    return m_signatures;
+}
+
 const void threat::print() const
 {
     /**
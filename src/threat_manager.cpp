@@ -18,9 +18,13 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <functional>
+#include <future>
 #include <stdexcept>
 
+#include <opensentinel/affinity.hpp>
 #include <opensentinel/alert_manager.hpp>
+#include <opensentinel/evidence_writer.hpp>
 #include <opensentinel/logger.hpp>
 #include <opensentinel/stack_impl.hpp>
 #include <opensentinel/threat.hpp>
@@ -29,10 +33,14 @@
 using namespace opensentinel;
 
 threat_manager::threat_manager(stack_impl & owner)
-    : state_(state_none)
+    : m_threats_dropped_logged(0)
+    , m_replay(false)
+    , state_(state_none)
     , stack_impl_(owner)
     , strand_(io_service_)
     , timer_(io_service_)
+    , queue_(queue_size)
+    , stage_signal_(io_service_, strand_)
 {
     // ...
 }
@@ -59,8 +67,87 @@ void threat_manager::start()
         }
     }));
 
+    /**
+     * Compile the signatures before any threat is checked.
+     */
+    load_signatures();
+    
+    m_replay = stack_impl_.get_configuration().replay_file().empty() == false;
+    
+    /**
+     * Correlated threats are checked and dispatched like any other.
+     */
+    scan_correlator_.start(
+        stack_impl_.get_configuration().correlation_sources(),
+        stack_impl_.get_configuration().correlation_window()
+    );
+    
+    scan_correlator_.set_on_threat([this](threat & val)
+    {
+        log_info(
+            "Threat manager correlated " << val.address() << " as " <<
+            val.scan_type_string() << " at " << val.rate() <<
+            " events per second."
+        );
+        
+        /**
+         * A single probe's threat was already reported on it's own, it is
+         * only logged.
+         */
+        if (val.scan_type() == threat::scan_type_probe)
+        {
+            return;
+        }
+        
+        handle_threat(val);
+    });
+    
+    /**
+     * During a flood the heavy sources are reported once per interval.
+     */
+    heavy_hitters_.start(
+        stack_impl_.get_configuration().flood_threshold(),
+        stack_impl_.get_configuration().flood_interval()
+    );
+    
+    heavy_hitters_.set_on_threat([this](threat & val)
+    {
+        log_info(
+            "Threat manager summarized a flood from " << val.address() <<
+            " at " << val.rate() << " threats per second."
+        );
+        
+        handle_threat(val);
+    });
+    
+    auto policy = stack_impl_.get_configuration().threat_policy();
+    
+    /**
+     * A replay outruns the threat_manager, it waits for room so every run
+     * of a capture counts the same threats.
+     */
+    if (m_replay == true && policy != backpressure::policy_block)
+    {
+        log_info(
+            "Threat manager is blocking on a full queue during the replay."
+        );
+        
+        policy = backpressure::policy_block;
+    }
+    
+    backpressure_.set_policy(
+        policy, stack_impl_.get_configuration().sample_rate()
+    );
+    
+    /**
+     * Drain the queue when signalled.
+     */
+    stage_signal_.start(std::bind(&threat_manager::drain, this));
+
     thread_ = std::thread(&threat_manager::run, this);
     
+    affinity::pin(thread_, stack_impl_.get_configuration().cpus("threat"));
+    
     state_ = state_started;
     
     log_info("Threat manager has started.");
@@ -77,11 +164,43 @@ void threat_manager::stop()
      */
     timer_.cancel();
     
+    /**
+     * Release any producer blocked on a full queue.
+     */
+    backpressure_.close();
+    
+    stage_signal_.stop();
+    
     if (thread_.joinable() == true)
     {
         thread_.join();
     }
     
+    /**
+     * Handle the threats still queued, the thread has exited so this is
+     * the only consumer.
+     */
+    std::size_t handled = 0;
+    std::size_t count = 0;
+    
+    do
+    {
+        count = queue_.consume(
+            [this](threat & val) { handle_threat(val); }, max_batch_size
+        );
+        
+        handled += count;
+    }
+    while (count > 0);
+    
+    if (handled > 0)
+    {
+        log_info(
+            "Threat manager handled " << handled << " queued threats while "
+            "stopping."
+        );
+    }
+    
     state_ = state_stopped;
     
     log_info("Threat manager has stopped.");
@@ -89,51 +208,164 @@ void threat_manager::stop()
 
 void threat_manager::on_threat(const threat & threat_data)
 {
-    log_info("Threat manager got threat.");
+    if (backpressure_.push(queue_, threat_data) == true)
+    {
+        stage_signal_.notify();
+    }
+}
+
+void threat_manager::flush()
+{
+    std::promise<void> done;
+    
+    io_service_.post(strand_.wrap([this, &done]()
+    {
+        while (
+            queue_.consume([this](threat & val) { handle_threat(val); },
+            max_batch_size) > 0
+            )
+        {
+            // ...
+        }
+        
+        done.set_value();
+    }));
+    
+    done.get_future().wait();
+}
+
+std::size_t threat_manager::queue_depth() const
+{
+    return queue_.size();
+}
+
+std::uint64_t threat_manager::threats_dropped() const
+{
+    return backpressure_.dropped();
+}
+
+void threat_manager::drain()
+{
+    /**
+     * Clear before draining so a threat queued from here on signals again.
+     */
+    stage_signal_.clear();
+    
+    auto count = queue_.consume(
+        [this](threat & val) { handle_threat(val); }, max_batch_size
+    );
     
-    io_service_.post(strand_.wrap([this, threat_data]()
+    /**
+     * Yield to the timer before checking the rest.
+     */
+    if (count == max_batch_size)
     {
+        io_service_.post(
+            strand_.wrap(std::bind(&threat_manager::drain, this))
+        );
+    }
+}
+
+void threat_manager::handle_threat(threat & val)
+{
+    try
+    {
+        /**
+         * A replay advances the windows on the recorded time.
+         */
+        if (m_replay == true)
+        {
+            scan_correlator_.on_tick(val.timestamp());
+            heavy_hitters_.on_tick(val.timestamp());
+        }
+        
+        /**
+         * Relate the threat to the others of it's source.
+         */
+        scan_correlator_.on_threat(val);
+        
+        auto checked = check_threat(val);
+        
+        /**
+         * Count the threat, if it's source is flooding it is summarized
+         * instead of reported.
+         */
+        if (heavy_hitters_.on_threat(val) == true)
+        {
+            return;
+        }
+        
         /**
          * Print the threat to the console.
          */
-        threat_data.print();
+        val.print();
         
         /**
-         * Check the threat; if the threat::level_t is > 0 send it to the
-         * alert_manager.
+         * If the threat::level_t is > 0 send it to the alert_manager.
          */
-        if (
-            check_threat(*const_cast<threat *> (&threat_data)) == true &&
-            threat_data.level() > threat::level_0
-            )
+        if (checked == true && val.level() > threat::level_0)
         {
             log_info(
-                "Threat manager checked threat(" << threat_data.protocol() <<
-                ") of level " << threat_data.level() << ", dispatching to "
+                "Threat manager checked threat(" << val.protocol() <<
+                ") of level " << val.level() << ", dispatching to "
                 "the alert_manager."
             );
             
+            /**
+             * Record the evidence.
+             */
+            if (stack_impl_.get_evidence_writer() != nullptr)
+            {
+                stack_impl_.get_evidence_writer()->write(val);
+            }
+            
             /**
              * Inform the alert_manager.
              */
             if (stack_impl_.get_alert_manager() != nullptr)
             {
-                stack_impl_.get_alert_manager()->on_threat(threat_data);
+                stack_impl_.get_alert_manager()->on_threat(val);
             }
         }
         else
         {
             log_info(
-                "Threat manager is dropping threat(" <<
-                threat_data.protocol() << ") of level " <<
-                threat_data.level() << "."
+                "Threat manager is dropping threat(" << val.protocol() <<
+                ") of level " << val.level() << "."
             );
         }
-    }));
+    }
+    catch (std::exception & e)
+    {
+        log_error(
+            "Threat manager failed to handle threat, what = " << e.what() <<
+            "."
+        );
+    }
 }
 
 void threat_manager::on_tick()
 {
+    if (m_replay == false)
+    {
+        auto now = std::chrono::system_clock::now();
+        
+        scan_correlator_.on_tick(now);
+        heavy_hitters_.on_tick(now);
+    }
+    
+    auto dropped = backpressure_.dropped();
+    
+    if (dropped != m_threats_dropped_logged)
+    {
+        log_error(
+            "Threat manager queue is full, queue depth = " << queue_depth() <<
+            ", threats dropped = " << dropped << "."
+        );
+        
+        m_threats_dropped_logged = dropped;
+    }
+    
     /**
      * Starts the timer.
      */
@@ -171,6 +403,45 @@ void threat_manager::run()
     log_info("Threat manager thread has stopped.");
 }
 
+void threat_manager::load_signatures()
+{
+    const auto & path = stack_impl_.get_configuration().signature_file();
+    
+    signature_engine_ = signature_engine();
+    
+    if (path.empty() == false)
+    {
+        try
+        {
+            signature_engine_.load(path);
+            
+            log_info(
+                "Threat manager loaded " << signature_engine_.size() <<
+                " signatures (" << signature_engine_.states() <<
+                " states in " << signature_engine_.memory() / 1024 <<
+                " KiB) from " << path << "."
+            );
+            
+            return;
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Threat manager failed to load signatures from " << path <<
+                ", what = " << e.what() << ", using the built-in signatures."
+            );
+            
+            signature_engine_ = signature_engine();
+        }
+    }
+    
+    /**
+     * The built-in signatures.
+     */
+    signature_engine_.add(1, threat::level_3, "FOO");
+    signature_engine_.compile();
+}
+
 bool threat_manager::check_threat(threat & val)
 {
     const auto & buffer = val.buffer();
@@ -185,41 +456,24 @@ bool threat_manager::check_threat(threat & val)
     else
     {
         /**
-         * If we are checking the threat sample buffer from a set of known
-         * hostile fingerprints we can escalate the threat::level_t if there is
-         * a match.
-         * @note This can be a database of samples or in-memory.
+         * If the threat sample buffer matches any known hostile fingerprint
+         * the threat::level_t is escalated to the highest level of the
+         * signatures matched.
          */
-        std::vector<char> fingerprint_test;
-#if 0
-        fingerprint_test.push_back('H');
-        fingerprint_test.push_back('T');
-        fingerprint_test.push_back('T');
-        fingerprint_test.push_back('P');
-#else
-        fingerprint_test.push_back('F');
-        fingerprint_test.push_back('O');
-        fingerprint_test.push_back('O');
-#endif
-        auto it = std::search(
-            buffer.begin(), buffer.end(), fingerprint_test.begin(),
-            fingerprint_test.end()
+        auto level = signature_engine_.match(
+            &buffer[0], buffer.size(), m_signature_ids
         );
     
-        if (it != buffer.end())
+        if (level > threat::level_0)
         {
-            val.set_level(threat::level_3);
-        }
-        else if (buffer.size() > 0)
-        {
-            val.set_level(threat::level_2);
+            val.set_signatures(m_signature_ids);
+            val.set_level(level);
         }
         else
         {
-            val.set_level(threat::level_1);
+            val.set_level(threat::level_2);
         }
     }
     
     return val.level() > threat::level_0;
 }
-
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <opensentinel/timing_wheel.hpp>
+
+using namespace opensentinel;
+
+asio::io_service::id timing_wheel::id;
+
+timing_wheel::timing_wheel(asio::io_service & ios)
+    : asio::io_service::service(ios)
+    , m_slots(slot_count, nullptr)
+    , m_tick(0)
+    , m_size(0)
+    , m_armed(false)
+    , m_shutdown(false)
+    , io_service_(ios)
+    , timer_(ios)
+{
+    // ...
+}
+
+std::size_t timing_wheel::size()
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    return m_size;
+}
+
+void timing_wheel::schedule(
+    wheel_timer & t, const std::function<void (std::error_code)> & f
+    )
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    if (m_shutdown == true)
+    {
+        return;
+    }
+    
+    /**
+     * As asio does, every handler of the pending wait completes on it's
+     * expiry.
+     */
+    if (t.m_pending == true)
+    {
+        t.m_handlers.push_back(f);
+        
+        return;
+    }
+    
+    if (m_armed == false)
+    {
+        /**
+         * The wheel was idle, the ticks restart from now.
+         */
+        m_time_tick = std::chrono::steady_clock::now();
+        
+        arm();
+    }
+    
+    /**
+     * The number of ticks (at least one) until expiry, counted from the
+     * current tick so a timer never expires early.
+     */
+    auto since_tick = std::chrono::duration_cast<std::chrono::milliseconds> (
+        std::chrono::steady_clock::now() - m_time_tick
+    ).count();
+    
+    std::uint64_t ticks = std::max(
+        static_cast<std::int64_t> (1),
+        (since_tick + t.m_expires.count() + resolution - 1) / resolution
+    );
+    
+    t.m_handlers.push_back(f);
+    t.m_rounds = (ticks - 1) / slot_count;
+    
+    link(t, (m_tick + ticks) % slot_count);
+}
+
+std::size_t timing_wheel::cancel(wheel_timer & t)
+{
+    std::vector< std::function<void (std::error_code)> > handlers;
+    
+    {
+        std::lock_guard<std::mutex> l1(mutex_);
+        
+        if (t.m_pending == false)
+        {
+            return 0;
+        }
+        
+        unlink(t);
+        
+        handlers.swap(t.m_handlers);
+    }
+    
+    /**
+     * Post the handlers (as asio does) rather than invoking them, so the
+     * owner of the timer can not be destroyed while cancelling.
+     */
+    for (auto & i : handlers)
+    {
+        io_service_.post(
+            std::bind(
+            std::move(i), make_error_code(asio::error::operation_aborted))
+        );
+    }
+    
+    return handlers.size();
+}
+
+void timing_wheel::link(wheel_timer & t, const std::size_t & slot)
+{
+    t.m_slot = slot;
+    t.m_previous = nullptr;
+    t.m_next = m_slots[slot];
+    
+    if (t.m_next)
+    {
+        t.m_next->m_previous = &t;
+    }
+    
+    m_slots[slot] = &t;
+    
+    t.m_pending = true;
+    
+    ++m_size;
+}
+
+void timing_wheel::unlink(wheel_timer & t)
+{
+    if (t.m_previous)
+    {
+        t.m_previous->m_next = t.m_next;
+    }
+    else
+    {
+        m_slots[t.m_slot] = t.m_next;
+    }
+    
+    if (t.m_next)
+    {
+        t.m_next->m_previous = t.m_previous;
+    }
+    
+    t.m_previous = nullptr;
+    t.m_next = nullptr;
+    
+    t.m_pending = false;
+    
+    --m_size;
+}
+
+void timing_wheel::arm()
+{
+    m_armed = true;
+    
+    timer_.expires_at(m_time_tick + std::chrono::milliseconds(resolution));
+    timer_.async_wait(std::bind(
+        &timing_wheel::on_tick, this, std::placeholders::_1)
+    );
+}
+
+void timing_wheel::on_tick(const std::error_code & ec)
+{
+    std::vector< std::function<void (std::error_code)> > expired;
+    
+    {
+        std::lock_guard<std::mutex> l1(mutex_);
+        
+        m_armed = false;
+        
+        if (ec || m_shutdown == true)
+        {
+            return;
+        }
+        
+        /**
+         * Catch up on every tick that has elapsed (at least one).
+         */
+        auto elapsed = std::max(
+            static_cast<std::int64_t> (1),
+            static_cast<std::int64_t> (
+            std::chrono::duration_cast<std::chrono::milliseconds> (
+            std::chrono::steady_clock::now() - m_time_tick).count() /
+            resolution)
+        );
+        
+        for (std::int64_t i = 0; i < elapsed && m_size > 0; i++)
+        {
+            ++m_tick;
+            
+            auto t = m_slots[m_tick % slot_count];
+            
+            while (t)
+            {
+                auto next = t->m_next;
+                
+                if (t->m_rounds > 0)
+                {
+                    --t->m_rounds;
+                }
+                else
+                {
+                    unlink(*t);
+                    
+                    for (auto & j : t->m_handlers)
+                    {
+                        expired.push_back(std::move(j));
+                    }
+                    
+                    t->m_handlers.clear();
+                }
+                
+                t = next;
+            }
+        }
+        
+        m_time_tick += std::chrono::milliseconds(resolution * elapsed);
+        
+        /**
+         * Stay idle (so the asio::io_service can run out of work) until a
+         * timer is scheduled.
+         */
+        if (m_size > 0)
+        {
+            arm();
+        }
+    }
+    
+    for (auto & i : expired)
+    {
+        io_service_.post(std::bind(std::move(i), std::error_code()));
+    }
+}
+
+void timing_wheel::shutdown_service()
+{
+    std::vector< std::function<void (std::error_code)> > handlers;
+    
+    {
+        std::lock_guard<std::mutex> l1(mutex_);
+        
+        m_shutdown = true;
+        
+        for (auto & i : m_slots)
+        {
+            while (i)
+            {
+                auto t = i;
+                
+                unlink(*t);
+                
+                for (auto & j : t->m_handlers)
+                {
+                    handlers.push_back(std::move(j));
+                }
+                
+                t->m_handlers.clear();
+            }
+        }
+    }
+    
+    /**
+     * The handlers may own wheel_timer's, destroy them without the lock.
+     */
+    handlers.clear();
+}
+
+wheel_timer::wheel_timer(asio::io_service & ios)
+    : m_expires(0)
+    , m_previous(nullptr)
+    , m_next(nullptr)
+    , m_slot(0)
+    , m_rounds(0)
+    , m_pending(false)
+    , timing_wheel_(asio::use_service<timing_wheel> (ios))
+{
+    // ...
+}
+
+wheel_timer::~wheel_timer()
+{
+    timing_wheel_.cancel(*this);
+}
+
+std::size_t wheel_timer::expires_from_now(
+    const std::chrono::milliseconds & val
+    )
+{
+    auto ret = timing_wheel_.cancel(*this);
+    
+    m_expires = val;
+    
+    return ret;
+}
+
+void wheel_timer::async_wait(const std::function<void (std::error_code)> & f)
+{
+    timing_wheel_.schedule(*this, f);
+}
+
+std::size_t wheel_timer::cancel()
+{
+    return timing_wheel_.cancel(*this);
+}
@@ -18,17 +18,31 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if (defined __linux__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif // __linux__
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
+#include <opensentinel/buffer_pool.hpp>
 #include <opensentinel/logger.hpp>
+#include <opensentinel/socket_filter.hpp>
 #include <opensentinel/udp_listener.hpp>
 
 using namespace opensentinel;
 
 udp_listener::udp_listener(asio::io_service & ios)
-    : strand_(ios)
+    : m_batch_size(1)
+    , m_transparent(false)
+    , m_dual_stack(false)
+    , m_port(0)
+    , strand_(ios)
     , socket_ipv4_(ios)
     , socket_ipv6_(ios)
 {
@@ -40,28 +54,19 @@ void udp_listener::open(const std::uint16_t & port)
     assert(!socket_ipv4_.is_open());
     assert(!socket_ipv6_.is_open());
     
-    std::error_code ec;
+    m_port = port;
     
-    /**
-     * Allocate the ipv4 endpoint.
-     */
-    asio::ip::udp::endpoint ipv4_endpoint(
-        asio::ip::address_v4::any(), port
-    );
+    std::error_code ec;
     
+#if (defined __linux__)
     /**
-     * Open the ipv4 socket.
+     * The original destination is only available through recvmsg so the
+     * batch handler is used even for a batch of one.
      */
-    socket_ipv4_.open(ipv4_endpoint.protocol(), ec);
-    
-    if (ec)
-    {
-        throw std::runtime_error(ec.message());
-    }
-    
-    socket_ipv4_.set_option(
-        asio::ip::udp::socket::reuse_address(true)
-    );
+    auto batching = static_cast<bool> (m_on_async_receive_batch);
+#else
+    auto batching = false;
+#endif // __linux__
     
     /**
      * Non-blocking IO.
@@ -69,31 +74,93 @@ void udp_listener::open(const std::uint16_t & port)
     asio::ip::udp::socket::non_blocking_io non_blocking_io(true);
     
     /**
-     * Set the ipv4 socket to non-blocking.
+     * A dual-stack listener receives ipv4 datagrams as v4-mapped.
      */
-    socket_ipv4_.lowest_layer().io_control(non_blocking_io, ec);
-    
-    if (ec)
+    if (m_dual_stack == false)
     {
-        throw std::runtime_error(ec.message());
+        /**
+         * Allocate the ipv4 endpoint.
+         */
+        asio::ip::udp::endpoint ipv4_endpoint(
+            asio::ip::address_v4::any(), port
+        );
+        
+        /**
+         * Open the ipv4 socket.
+         */
+        socket_ipv4_.open(ipv4_endpoint.protocol(), ec);
+        
+        if (ec)
+        {
+            throw std::runtime_error(ec.message());
+        }
+        
+        socket_ipv4_.set_option(
+            asio::ip::udp::socket::reuse_address(true)
+        );
+        
+        /**
+         * Set the ipv4 socket to non-blocking.
+         */
+        socket_ipv4_.lowest_layer().io_control(non_blocking_io, ec);
+        
+        if (ec)
+        {
+            throw std::runtime_error(ec.message());
+        }
+
+#if (defined __linux__)
+        /**
+         * Attach the socket_filter to the ipv4 socket.
+         */
+        if (m_socket_filter != nullptr)
+        {
+            m_socket_filter->attach(socket_ipv4_.native_handle(), ec);
+            
+            if (ec)
+            {
+                log_error(
+                    "UDP listener failed to attach socket filter, message = " <<
+                    ec.message() << "."
+                );
+            }
+        }
+#endif // __linux__
+
+        /**
+         * Make the ipv4 socket transparent.
+         */
+        if (m_transparent == true)
+        {
+            set_transparent_options(socket_ipv4_);
+        }
+        
+        if (batching == true)
+        {
+            set_destination_options(socket_ipv4_);
+        }
+        
+        /**
+         * Bind the ipv4 socket.
+         */
+        socket_ipv4_.bind(ipv4_endpoint);
+        
+        if (batching == true)
+        {
+            /**
+             * Start an asynchronous batch receive on the ipv4 socket.
+             */
+            async_receive_batch(socket_ipv4_);
+        }
+        else
+        {
+            /**
+             * Start an asynchronous receive from on the ipv4 socket.
+             */
+            async_receive_from(socket_ipv4_);
+        }
     }
     
-    /**
-     * Bind the ipv4 socket.
-     */
-    socket_ipv4_.bind(ipv4_endpoint);
-    
-    auto self(shared_from_this());
-    
-    /**
-     * Start an asynchronous receive from on the ipv4 socket.
-     */
-    socket_ipv4_.async_receive_from(
-        asio::buffer(receive_buffer_), remote_endpoint_, strand_.wrap(
-        std::bind(&udp_listener::handle_async_receive_from, self,
-        std::placeholders::_1, std::placeholders::_2))
-    );
-    
     /**
      * Allocate the ipv6 endpoint.
      */
@@ -123,28 +190,68 @@ void udp_listener::open(const std::uint16_t & port)
     /**
      * Set the ipv6 socket to use v6 only.
      */
-    socket_ipv6_.set_option(asio::ip::v6_only(true));
+    socket_ipv6_.set_option(asio::ip::v6_only(m_dual_stack == false));
 #endif // _MSC_VER
     
+#if (defined __linux__)
     /**
-     * Bind the ipv6 socket.
+     * Attach the socket_filter to the ipv6 socket.
      */
-    socket_ipv6_.bind(ipv6_endpoint);
+    if (m_socket_filter != nullptr)
+    {
+        m_socket_filter->attach(socket_ipv6_.native_handle(), ec);
+        
+        if (ec)
+        {
+            log_error(
+                "UDP listener failed to attach socket filter, message = " <<
+                ec.message() << "."
+            );
+        }
+    }
+#endif // __linux__
     
     /**
-     * Start an asynchronous receive from on the ipv6 socket.
+     * Make the ipv6 socket transparent.
      */
-    socket_ipv6_.async_receive_from(
-        asio::buffer(receive_buffer_), remote_endpoint_, strand_.wrap(
-        std::bind(&udp_listener::handle_async_receive_from, self,
-        std::placeholders::_1, std::placeholders::_2))
-    );
+    if (m_transparent == true)
+    {
+        set_transparent_options(socket_ipv6_);
+    }
     
-    log_info(
-        "UDP listener local ipv4 endpoint = " <<
-        asio::ip::udp::endpoint(socket_ipv4_.local_endpoint().address(),
-        socket_ipv4_.local_endpoint().port()) << "."
-    );
+    if (batching == true)
+    {
+        set_destination_options(socket_ipv6_);
+    }
+    
+    /**
+     * Bind the ipv6 socket.
+     */
+    socket_ipv6_.bind(ipv6_endpoint);
+    
+    if (batching == true)
+    {
+        /**
+         * Start an asynchronous batch receive on the ipv6 socket.
+         */
+        async_receive_batch(socket_ipv6_);
+    }
+    else
+    {
+        /**
+         * Start an asynchronous receive from on the ipv6 socket.
+         */
+        async_receive_from(socket_ipv6_);
+    }
+    
+    if (socket_ipv4_.is_open())
+    {
+        log_info(
+            "UDP listener local ipv4 endpoint = " <<
+            asio::ip::udp::endpoint(socket_ipv4_.local_endpoint().address(),
+            socket_ipv4_.local_endpoint().port()) << "."
+        );
+    }
     
     log_info(
         "UDP listener local ipv6 endpoint = " <<
@@ -182,7 +289,17 @@ void udp_listener::send_to(
      */
     if (len <= max_length)
     {
-        if (ep.protocol() == asio::ip::udp::v4())
+        if (ep.protocol() == asio::ip::udp::v4() && m_dual_stack == true)
+        {
+            /**
+             * Send to the v4-mapped address over the ipv6 socket.
+             */
+            send_to(
+                asio::ip::udp::endpoint(asio::ip::address_v6::v4_mapped(
+                ep.address().to_v4()), ep.port()), buf, len
+            );
+        }
+        else if (ep.protocol() == asio::ip::udp::v4())
         {
             if (socket_ipv4_.is_open())
             {
@@ -263,8 +380,55 @@ void udp_listener::set_on_async_receive_from(
     m_on_async_receive_from = f;
 }
 
+void udp_listener::set_on_async_receive_batch(
+    const std::function<
+    void (const datagram_t *, const std::size_t &)> & f
+    )
+{
+    m_on_async_receive_batch = f;
+}
+
+void udp_listener::set_batch_size(const std::size_t & val)
+{
+    m_batch_size = std::min(
+        std::max(val, static_cast<std::size_t> (1)),
+        static_cast<std::size_t> (max_batch_size)
+    );
+}
+
+void udp_listener::set_transparent(const bool & val)
+{
+    m_transparent = val;
+}
+
+void udp_listener::set_dual_stack(const bool & val)
+{
+    m_dual_stack = val;
+}
+
+void udp_listener::set_socket_filter(
+    const std::shared_ptr<socket_filter> & val
+    )
+{
+    m_socket_filter = val;
+}
+
+void udp_listener::async_receive_from(asio::ip::udp::socket & s)
+{
+    auto self(shared_from_this());
+    
+    /**
+     * Wait for readability only, the buffer is leased once a datagram is
+     * waiting.
+     */
+    s.async_receive(asio::null_buffers(), strand_.wrap(
+        std::bind(&udp_listener::handle_async_receive_from, self,
+        std::placeholders::_1, std::ref(s)))
+    );
+}
+
 void udp_listener::handle_async_receive_from(
-    const std::error_code & ec, const std::size_t & len
+    const std::error_code & ec, asio::ip::udp::socket & s
     )
 {
     if (ec == asio::error::operation_aborted)
@@ -281,70 +445,260 @@ void udp_listener::handle_async_receive_from(
             "UDP listener receive failed, message = " << ec.message() << "."
         );
         
-        auto self(shared_from_this());
+        async_receive_from(s);
+    }
+    else
+    {
+        /**
+         * Lease a buffer from the thread's pool for this receive only.
+         */
+        auto buffer = buffer_pool::acquire();
+        
+        asio::ip::udp::endpoint remote_endpoint;
+        
+        std::error_code ec_receive;
         
-        if (remote_endpoint_.protocol() == asio::ip::udp::v4())
+        auto len = s.receive_from(
+            asio::buffer(buffer.data(), buffer.size()), remote_endpoint, 0,
+            ec_receive
+        );
+        
+        if (ec_receive)
         {
-            /**
-             * Start an asynchronous receive from on the ipv4 socket.
-             */
-            socket_ipv4_.async_receive_from(
-                asio::buffer(receive_buffer_), remote_endpoint_,
-                strand_.wrap(std::bind(
-                &udp_listener::handle_async_receive_from,
-                self, std::placeholders::_1, std::placeholders::_2))
-            );
+            if (ec_receive != asio::error::would_block)
+            {
+                log_debug(
+                    "UDP listener receive failed, message = " <<
+                    ec_receive.message() << "."
+                );
+            }
         }
-        else
+        else if (m_on_async_receive_from && len > 0)
         {
-            /**
-             * Start an asynchronous receive from on the ipv6 socket.
-             */
-            socket_ipv6_.async_receive_from(
-                asio::buffer(receive_buffer_), remote_endpoint_,
-                strand_.wrap(std::bind(
-                &udp_listener::handle_async_receive_from, self,
-                std::placeholders::_1, std::placeholders::_2))
-            );
+            m_on_async_receive_from(remote_endpoint, buffer.data(), len);
         }
+        
+        async_receive_from(s);
+    }
+}
+
+void udp_listener::set_transparent_options(asio::ip::udp::socket & s)
+{
+#if (defined __linux__)
+    int enable = 1;
+    
+    auto is_v6 = &s == &socket_ipv6_;
+    
+    if (
+        setsockopt(s.native_handle(), is_v6 ? SOL_IPV6 : SOL_IP,
+        is_v6 ? IPV6_TRANSPARENT : IP_TRANSPARENT, &enable,
+        sizeof(enable)) != 0
+        )
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+#endif // __linux__
+}
+
+void udp_listener::set_destination_options(asio::ip::udp::socket & s)
+{
+#if (defined __linux__)
+    int enable = 1;
+    
+    auto is_v6 = &s == &socket_ipv6_;
+    
+    /**
+     * The original destination of a redirected datagram, otherwise the
+     * local address it was received on.
+     */
+    if (
+        setsockopt(s.native_handle(), is_v6 ? SOL_IPV6 : SOL_IP,
+        is_v6 ? IPV6_RECVORIGDSTADDR : IP_RECVORIGDSTADDR, &enable,
+        sizeof(enable)) != 0
+        )
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    /**
+     * A dual-stack socket reports the original destination of ipv4
+     * datagrams with IP_ORIGDSTADDR.
+     */
+    if (
+        is_v6 && m_dual_stack && setsockopt(s.native_handle(), SOL_IP,
+        IP_RECVORIGDSTADDR, &enable, sizeof(enable)) != 0
+        )
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+#endif // __linux__
+}
+
+void udp_listener::async_receive_batch(asio::ip::udp::socket & s)
+{
+    auto self(shared_from_this());
+    
+    /**
+     * Wait for readability only, the datagrams are read by recvmmsg.
+     */
+    s.async_receive(asio::null_buffers(), strand_.wrap(
+        std::bind(&udp_listener::handle_async_receive_batch, self,
+        std::placeholders::_1, std::ref(s)))
+    );
+}
+
+void udp_listener::handle_async_receive_batch(
+    const std::error_code & ec, asio::ip::udp::socket & s
+    )
+{
+    if (ec == asio::error::operation_aborted)
+    {
+        // ...
+    }
+    else if (ec == asio::error::bad_descriptor)
+    {
+        // ...
+    }
+    else if (ec)
+    {
+        log_debug(
+            "UDP listener receive failed, message = " << ec.message() << "."
+        );
+        
+        async_receive_batch(s);
     }
     else
     {
+#if (defined __linux__)
+        /**
+         * The receive buffers are leased from the thread's pool and handed
+         * to the handler in place.
+         */
+        buffer_pool::lease buffers[max_batch_size];
+        
+        struct mmsghdr msgs[max_batch_size];
+        struct iovec iovecs[max_batch_size];
+        struct sockaddr_storage addrs[max_batch_size];
+        
         /**
-         * Drop packets greater than max_length.
+         * The control messages carrying the original destination.
          */
-        if (m_on_async_receive_from && (len > 0 && len <= max_length))
+        char controls[max_batch_size][CMSG_SPACE(sizeof(sockaddr_in6))];
+        
+        std::memset(msgs, 0, sizeof(msgs));
+        
+        for (std::size_t i = 0; i < m_batch_size; i++)
         {
-            m_on_async_receive_from(
-                remote_endpoint_, &receive_buffer_[0], len
-            );
+            buffers[i] = buffer_pool::acquire();
+            
+            iovecs[i].iov_base = buffers[i].data();
+            iovecs[i].iov_len = buffers[i].size();
+            
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            msgs[i].msg_hdr.msg_control = controls[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
         }
         
-        auto self(shared_from_this());
+        auto count = recvmmsg(
+            s.native_handle(), msgs, m_batch_size, MSG_DONTWAIT, 0
+        );
         
-        if (remote_endpoint_.protocol() == asio::ip::udp::v4())
+        if (count > 0)
         {
-            /**
-             * Start an asynchronous receive from on the ipv4 socket.
-             */
-            socket_ipv4_.async_receive_from(
-                asio::buffer(receive_buffer_), remote_endpoint_,
-                strand_.wrap(std::bind(
-                &udp_listener::handle_async_receive_from, self,
-                std::placeholders::_1, std::placeholders::_2))
-            );
+            datagram_t datagrams[max_batch_size];
+            
+            std::size_t received = 0;
+            
+            for (auto i = 0; i < count; i++)
+            {
+                auto len = msgs[i].msg_len;
+                
+                /**
+                 * Drop empty and truncated datagrams.
+                 */
+                if (len == 0 || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+                {
+                    continue;
+                }
+                
+                auto & datagram = datagrams[received];
+                
+                std::memcpy(
+                    datagram.endpoint.data(), &addrs[i],
+                    msgs[i].msg_hdr.msg_namelen
+                );
+                datagram.endpoint.resize(msgs[i].msg_hdr.msg_namelen);
+                datagram.destination_address = asio::ip::address();
+                datagram.destination_port = m_port;
+                
+                /**
+                 * Recover the address and port the datagram was sent to.
+                 */
+                for (
+                    auto cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+                    cmsg != nullptr;
+                    cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)
+                    )
+                {
+                    if (
+                        cmsg->cmsg_level == SOL_IP &&
+                        cmsg->cmsg_type == IP_ORIGDSTADDR
+                        )
+                    {
+                        sockaddr_in addr;
+                        
+                        std::memcpy(&addr, CMSG_DATA(cmsg), sizeof(addr));
+                        
+                        datagram.destination_address = asio::ip::address_v4(
+                            ntohl(addr.sin_addr.s_addr)
+                        );
+                        datagram.destination_port = ntohs(addr.sin_port);
+                    }
+                    else if (
+                        cmsg->cmsg_level == SOL_IPV6 &&
+                        cmsg->cmsg_type == IPV6_ORIGDSTADDR
+                        )
+                    {
+                        sockaddr_in6 addr;
+                        
+                        std::memcpy(&addr, CMSG_DATA(cmsg), sizeof(addr));
+                        
+                        asio::ip::address_v6::bytes_type bytes;
+                        
+                        std::memcpy(
+                            bytes.data(), &addr.sin6_addr, bytes.size()
+                        );
+                        
+                        datagram.destination_address =
+                            asio::ip::address_v6(bytes)
+                        ;
+                        datagram.destination_port = ntohs(addr.sin6_port);
+                    }
+                }
+                
+                datagram.data = buffers[i].data();
+                datagram.length = len;
+                
+                ++received;
+            }
+            
+            if (m_on_async_receive_batch && received > 0)
+            {
+                m_on_async_receive_batch(datagrams, received);
+            }
         }
-        else
+        else if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
         {
-            /**
-             * Start an asynchronous receive from on the ipv6 socket.
-             */
-            socket_ipv6_.async_receive_from(
-                asio::buffer(receive_buffer_), remote_endpoint_,
-                strand_.wrap(std::bind(
-                &udp_listener::handle_async_receive_from, self,
-                std::placeholders::_1, std::placeholders::_2))
+            log_debug(
+                "UDP listener batch receive failed, message = " <<
+                std::strerror(errno) << "."
             );
         }
+#endif // __linux__
+        
+        async_receive_batch(s);
     }
 }
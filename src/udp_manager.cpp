@@ -18,7 +18,9 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <opensentinel/configuration.hpp>
 #include <opensentinel/logger.hpp>
+#include <opensentinel/socket_filter.hpp>
 #include <opensentinel/stack_impl.hpp>
 #include <opensentinel/threat.hpp>
 #include <opensentinel/udp_listener.hpp>
@@ -27,13 +29,15 @@
 using namespace opensentinel;
 
 udp_manager::udp_manager(
-    stack_impl & owner, asio::io_service & ios, asio::strand & s
+    stack_impl & owner, asio::io_service & ios, asio::strand & s,
+    io_service_pool & pool
     )
     : state_(state_none)
     , stack_impl_(owner)
     , io_service_(ios)
     , strand_(s)
     , timer_(ios)
+    , io_service_pool_(pool)
 {
     // ...
 }
@@ -61,13 +65,48 @@ void udp_manager::start()
     }));
 
     /**
-     * Open the udp_listeners objects.
-     * @note Skip NetBios, bootps and bootpc.
+     * Compile the socket_filter dropping allow-listed sources in the kernel.
      */
-    open_udp_listener(1 /* tcpmux */, 66 /* sql-net */);
-    open_udp_listener(69 /* tftp */, 136 /* profile */);
-    open_udp_listener(140 /* emfis-data */, 2028 /* dls-monitor */);
-    open_udp_listener(8080 /* http-alt */, 8280 /* synapse-nhttp */);
+    if (stack_impl_.get_configuration().allowed_sources().size() > 0)
+    {
+        try
+        {
+            socket_filter_ = std::make_shared<socket_filter> ();
+            
+            socket_filter_->compile(
+                stack_impl_.get_configuration(), socket_filter::type_udp
+            );
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "UDP manager failed to compile socket filter, what = " <<
+                e.what() << "."
+            );
+            
+            socket_filter_ = nullptr;
+        }
+    }
+    
+    auto transparent_port = stack_impl_.get_configuration().transparent_port();
+    
+    if (transparent_port > 0)
+    {
+        /**
+         * Open a single transparent udp_listener for every redirected port.
+         */
+        open_udp_listener(transparent_port, transparent_port, true);
+    }
+    else
+    {
+        /**
+         * Open the udp_listener objects for each monitored port range.
+         */
+        for (auto & i : stack_impl_.get_configuration().port_ranges())
+        {
+            open_udp_listener(i.first, i.second, false);
+        }
+    }
     
     state_ = state_started;
     
@@ -131,13 +170,79 @@ void udp_manager::on_tick()
 }
 
 void udp_manager::open_udp_listener(
-    const std::uint16_t & port_begin, const std::uint16_t & port_end
+    const std::uint16_t & port_begin, const std::uint16_t & port_end,
+    const bool & transparent
     )
 {
     for (auto i = port_begin; i < (port_end + 1); i++)
     {
-        auto listener = std::make_shared<udp_listener> (io_service_);
-    
+        /**
+         * Spread the udp_listener objects across the io_service_pool, each
+         * is serialized by it's own strand only.
+         */
+        auto listener = std::make_shared<udp_listener> (
+            io_service_pool_.size() > 1 ?
+            io_service_pool_.get_io_service(i % io_service_pool_.size()) :
+            io_service_
+        );
+        
+        listener->set_socket_filter(socket_filter_);
+        
+        listener->set_transparent(transparent);
+        
+        listener->set_dual_stack(
+            stack_impl_.get_configuration().dual_stack()
+        );
+        
+        listener->set_batch_size(
+            stack_impl_.get_configuration().udp_batch_size()
+        );
+        
+        /**
+         * Listen for UDP packets.
+         */
+        listener->set_on_async_receive_from([this, i](
+            const asio::ip::udp::endpoint & ep , const char * buf,
+            const std::size_t & len
+            )
+        {
+            /**
+             * The destination address is only known with recvmsg.
+             */
+            handle_datagram(ep, asio::ip::address(), i, buf, len);
+        });
+        
+        /**
+         * Listen for batches of UDP packets.
+         */
+        listener->set_on_async_receive_batch([this, transparent](
+            const udp_listener::datagram_t * datagrams,
+            const std::size_t & count
+            )
+        {
+            for (std::size_t j = 0; j < count; j++)
+            {
+                const auto & datagram = datagrams[j];
+                
+                /**
+                 * A transparent listener may be handed ports outside of the
+                 * monitored port ranges.
+                 */
+                if (
+                    transparent == true && stack_impl_.get_configuration(
+                    ).is_monitored_port(datagram.destination_port) == false
+                    )
+                {
+                    continue;
+                }
+                
+                handle_datagram(
+                    datagram.endpoint, datagram.destination_address,
+                    datagram.destination_port, datagram.data, datagram.length
+                );
+            }
+        });
+        
         try
         {
             listener->open(i);
@@ -158,45 +263,6 @@ void udp_manager::open_udp_listener(
             }
         }
         
-        /**
-         * Listen for UDP packets.x
-         */
-        listener->set_on_async_receive_from(strand_.wrap([this](
-            const asio::ip::udp::endpoint & ep , const char * buf,
-            const std::size_t & len
-            )
-        {
-            try
-            {
-                /**
-                 * Allocate the threat.
-                 */
-                threat threat_data(
-                    threat::protocol_udp, ep.address(), ep.port(), buf, len
-                );
-                
-                /**
-                 * Set the threat::level_t.
-                 */
-                threat_data.set_level(threat::level_3);
-
-                log_info(
-                    "UDP manager has detected a possible threat "
-                    "(UDP Receive) from " << ep <<
-                    ", dispatching to threat_manager."
-                );
-                
-                /**
-                 * Callback
-                 */
-                stack_impl_.on_threat(threat_data);
-            }
-            catch (...)
-            {
-                // ...
-            }
-        }));
-        
         udp_listeners_.push_back(listener);
     }
     
@@ -206,6 +272,47 @@ void udp_manager::open_udp_listener(
     );
 }
 
+void udp_manager::handle_datagram(
+    const asio::ip::udp::endpoint & ep,
+    const asio::ip::address & destination_address,
+    const std::uint16_t & destination_port, const char * buf,
+    const std::size_t & len
+    )
+{
+    try
+    {
+        /**
+         * Allocate the threat.
+         */
+        threat threat_data(
+            threat::protocol_udp, ep.address(), ep.port(), buf, len
+        );
+        
+        /**
+         * Set the threat::level_t.
+         */
+        threat_data.set_level(threat::level_3);
+        
+        threat_data.set_destination_address(destination_address);
+        threat_data.set_destination_port(destination_port);
+        
+        log_info(
+            "UDP manager has detected a possible threat "
+            "(UDP Receive) from " << ep <<
+            ", dispatching to threat_manager."
+        );
+        
+        /**
+         * Callback
+         */
+        stack_impl_.on_threat(threat_data);
+    }
+    catch (...)
+    {
+        // ...
+    }
+}
+
 void udp_manager::close_udp_listeners()
 {
     log_info(
@@ -0,0 +1,1378 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if (defined __linux__)
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <opensentinel/affinity.hpp>
+#include <opensentinel/configuration.hpp>
+#include <opensentinel/icmp.hpp>
+#include <opensentinel/logger.hpp>
+#include <opensentinel/packet_view.hpp>
+#include <opensentinel/stack_impl.hpp>
+#include <opensentinel/threat.hpp>
+#include <opensentinel/uring_manager.hpp>
+
+using namespace opensentinel;
+
+uring_manager::uring_manager(stack_impl & owner)
+    : m_ring_fd(-1)
+    , m_wakeup_fd(-1)
+    , m_ring(nullptr)
+    , m_ring_size(0)
+    , m_sqes(nullptr)
+    , m_sq_entries(0)
+    , m_sq_head(nullptr)
+    , m_sq_tail(nullptr)
+    , m_sq_mask(0)
+    , m_sq_array(nullptr)
+    , m_sq_tail_local(0)
+    , m_cq_head(nullptr)
+    , m_cq_tail(nullptr)
+    , m_cq_mask(0)
+    , m_cqes(nullptr)
+    , m_buffer_ring(nullptr)
+    , m_buffers(nullptr)
+    , m_buffer_tail(0)
+    , m_connection_id(0)
+    , m_wakeup_value(0)
+    , m_transparent(false)
+    , state_(state_none)
+    , stack_impl_(owner)
+{
+    m_tick_timespec[0] = 1;
+    m_tick_timespec[1] = 0;
+}
+
+uring_manager::~uring_manager()
+{
+#if (defined __linux__)
+    for (auto & i : m_connections)
+    {
+        ::close(i.second.fd);
+    }
+    
+    for (auto & i : m_sockets)
+    {
+        ::close(i.fd);
+    }
+    
+    if (m_ring_fd >= 0)
+    {
+        ::close(m_ring_fd);
+    }
+    
+    if (m_wakeup_fd >= 0)
+    {
+        ::close(m_wakeup_fd);
+    }
+    
+    if (m_ring != nullptr)
+    {
+        munmap(m_ring, m_ring_size);
+    }
+    
+    if (m_sqes != nullptr)
+    {
+        munmap(m_sqes, m_sq_entries * sizeof(io_uring_sqe));
+    }
+    
+    if (m_buffer_ring != nullptr)
+    {
+        munmap(m_buffer_ring, buffer_count * sizeof(io_uring_buf));
+    }
+    
+    if (m_buffers != nullptr)
+    {
+        munmap(m_buffers, buffer_count * buffer_size);
+    }
+#endif // __linux__
+}
+
+void uring_manager::start()
+{
+#if (defined __linux__)
+    log_info("Uring manager is starting...");
+    
+    state_ = state_starting;
+    
+    try
+    {
+        setup_ring();
+    }
+    catch (std::exception & e)
+    {
+        state_ = state_none;
+        
+        throw;
+    }
+    
+    open_sockets();
+    
+    if (m_sockets.empty() == true)
+    {
+        state_ = state_none;
+        
+        throw std::runtime_error("no sockets");
+    }
+    
+    std::vector<int> fds;
+    
+    for (auto & i : m_sockets)
+    {
+        fds.push_back(i.fd);
+    }
+    
+    /**
+     * Register the sockets so every operation on them skips the file
+     * table lookup.
+     */
+    if (
+        syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES,
+        &fds[0], static_cast<unsigned> (fds.size())) < 0
+        )
+    {
+        state_ = state_none;
+        
+        throw std::runtime_error(
+            std::string("register files: ") + std::strerror(errno)
+        );
+    }
+    
+    for (std::uint32_t i = 0; i < m_sockets.size(); i++)
+    {
+        if (m_sockets[i].type == SOCK_STREAM)
+        {
+            arm_accept(i);
+        }
+        else
+        {
+            arm_recvmsg(i);
+        }
+    }
+    
+    arm_tick();
+    arm_wakeup();
+    
+    submit(false);
+    
+    thread_ = std::thread(&uring_manager::run, this);
+    
+    affinity::pin(thread_, stack_impl_.get_configuration().cpus("uring"));
+    
+    state_ = state_started;
+    
+    log_info(
+        "Uring manager has started, registered " << m_sockets.size() <<
+        " sockets."
+    );
+#else
+    throw std::runtime_error("not supported");
+#endif // __linux__
+}
+
+void uring_manager::stop()
+{
+#if (defined __linux__)
+    log_info("Uring manager is stopping...");
+    
+    state_ = state_stopping;
+    
+    /**
+     * Wake the thread.
+     */
+    std::uint64_t value = 1;
+    
+    if (::write(m_wakeup_fd, &value, sizeof(value)) < 0)
+    {
+        log_error(
+            "Uring manager failed to wakeup, message = " <<
+            std::strerror(errno) << "."
+        );
+    }
+    
+    if (thread_.joinable() == true)
+    {
+        thread_.join();
+    }
+    
+    state_ = state_stopped;
+    
+    log_info("Uring manager has stopped.");
+#endif // __linux__
+}
+
+#if (defined __linux__)
+
+void uring_manager::setup_ring()
+{
+    io_uring_params params;
+    
+    std::memset(&params, 0, sizeof(params));
+    
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = ring_entries * 4;
+    
+    m_ring_fd = static_cast<int> (
+        syscall(__NR_io_uring_setup, ring_entries, &params)
+    );
+    
+    if (m_ring_fd < 0)
+    {
+        throw std::runtime_error(
+            std::string("io_uring_setup: ") + std::strerror(errno)
+        );
+    }
+    
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+    {
+        throw std::runtime_error("kernel too old");
+    }
+    
+    m_sq_entries = params.sq_entries;
+    
+    /**
+     * The submission and completion queues share a single mapping.
+     */
+    m_ring_size = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)
+    );
+    
+    auto ring = mmap(
+        0, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        m_ring_fd, IORING_OFF_SQ_RING
+    );
+    
+    if (ring == MAP_FAILED)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_ring = ring;
+    
+    auto sqes = mmap(
+        0, m_sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES
+    );
+    
+    if (sqes == MAP_FAILED)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_sqes = static_cast<io_uring_sqe *> (sqes);
+    
+    auto base = static_cast<std::uint8_t *> (m_ring);
+    
+    m_sq_head = reinterpret_cast<std::uint32_t *> (base + params.sq_off.head);
+    m_sq_tail = reinterpret_cast<std::uint32_t *> (base + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<std::uint32_t *> (
+        base + params.sq_off.ring_mask
+    );
+    m_sq_array = reinterpret_cast<std::uint32_t *> (
+        base + params.sq_off.array
+    );
+    m_sq_tail_local = *m_sq_tail;
+    
+    /**
+     * Map every slot of the submission array to the entry at that index.
+     */
+    for (std::uint32_t i = 0; i < m_sq_entries; i++)
+    {
+        m_sq_array[i] = i;
+    }
+    
+    m_cq_head = reinterpret_cast<std::uint32_t *> (base + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<std::uint32_t *> (base + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<std::uint32_t *> (
+        base + params.cq_off.ring_mask
+    );
+    m_cqes = reinterpret_cast<io_uring_cqe *> (base + params.cq_off.cqes);
+    
+    /**
+     * Allocate and register the provided buffer ring.
+     */
+    auto buffer_ring = mmap(
+        0, buffer_count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    
+    if (buffer_ring == MAP_FAILED)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_buffer_ring = static_cast<io_uring_buf_ring *> (buffer_ring);
+    
+    auto buffers = mmap(
+        0, buffer_count * buffer_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    
+    if (buffers == MAP_FAILED)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+    
+    m_buffers = static_cast<std::uint8_t *> (buffers);
+    
+    io_uring_buf_reg reg;
+    
+    std::memset(&reg, 0, sizeof(reg));
+    
+    reg.ring_addr = reinterpret_cast<std::uint64_t> (m_buffer_ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = buffer_group;
+    
+    if (
+        syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_PBUF_RING,
+        &reg, 1) < 0
+        )
+    {
+        throw std::runtime_error(
+            std::string("register buffer ring: ") + std::strerror(errno)
+        );
+    }
+    
+    for (std::uint16_t i = 0; i < buffer_count; i++)
+    {
+        recycle_buffer(i);
+    }
+    
+    /**
+     * The wakeup used to interrupt the ring on stop.
+     */
+    m_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    
+    if (m_wakeup_fd < 0)
+    {
+        throw std::runtime_error(std::strerror(errno));
+    }
+}
+
+void uring_manager::open_sockets()
+{
+    const auto & config = stack_impl_.get_configuration();
+    
+    /**
+     * Compile the socket_filter objects.
+     */
+    try
+    {
+        if (config.allowed_sources().size() > 0)
+        {
+            socket_filter_udp_.compile(config, socket_filter::type_udp);
+        }
+        
+        socket_filter_icmp_.compile(config, socket_filter::type_icmp);
+    }
+    catch (std::exception & e)
+    {
+        log_error(
+            "Uring manager failed to compile socket filter, what = " <<
+            e.what() << "."
+        );
+    }
+    
+    m_transparent = config.transparent_port() > 0;
+    
+    std::vector< std::pair<std::uint16_t, std::uint16_t> > port_ranges;
+    
+    if (m_transparent == true)
+    {
+        port_ranges.push_back(
+            std::make_pair(config.transparent_port(), config.transparent_port())
+        );
+    }
+    else
+    {
+        port_ranges = config.port_ranges();
+    }
+    
+    auto exhausted = false;
+    
+    for (auto & i : port_ranges)
+    {
+        for (std::uint32_t j = i.first; j <= i.second && !exhausted; j++)
+        {
+            for (auto family : { AF_INET, AF_INET6 })
+            {
+                /**
+                 * A dual-stack ipv6 socket also serves ipv4.
+                 */
+                if (family == AF_INET && config.dual_stack() == true)
+                {
+                    continue;
+                }
+                
+                for (auto type : { SOCK_STREAM, SOCK_DGRAM })
+                {
+                    if (
+                        open_socket(family, type, static_cast<std::uint16_t> (
+                        j), m_transparent) == false
+                        )
+                    {
+                        exhausted = true;
+                    }
+                }
+            }
+        }
+    }
+    
+    /**
+     * The ICMP and ICMPv6 sockets.
+     */
+    open_socket(AF_INET, SOCK_RAW, 0, false);
+    open_socket(AF_INET6, SOCK_RAW, 0, false);
+    
+    /**
+     * The recvmsg template, the kernel fills in the name and the (original)
+     * destination.
+     */
+    m_msghdr.resize(sizeof(msghdr));
+    
+    auto hdr = reinterpret_cast<msghdr *> (&m_msghdr[0]);
+    
+    std::memset(hdr, 0, sizeof(msghdr));
+    
+    hdr->msg_namelen = sizeof(sockaddr_in6);
+    hdr->msg_controllen = CMSG_SPACE(sizeof(sockaddr_in6));
+}
+
+bool uring_manager::open_socket(
+    const int & family, const int & type, const std::uint16_t & port,
+    const bool & transparent
+    )
+{
+    auto protocol = 0;
+    
+    if (type == SOCK_RAW)
+    {
+        protocol = family == AF_INET6 ?
+            static_cast<int> (IPPROTO_ICMPV6) : static_cast<int> (IPPROTO_ICMP)
+        ;
+    }
+    
+    auto fd = socket(family, type | SOCK_CLOEXEC, protocol);
+    
+    if (fd < 0)
+    {
+        log_error(
+            "Uring manager failed to open socket, message = " <<
+            std::strerror(errno) << "."
+        );
+        
+        return errno != EMFILE && errno != ENFILE;
+    }
+    
+    int enable = 1;
+    
+    if (type == SOCK_STREAM)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    }
+    
+    if (family == AF_INET6)
+    {
+        int v6_only =
+            type == SOCK_RAW ||
+            stack_impl_.get_configuration().dual_stack() == false
+        ;
+        
+        setsockopt(
+            fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only)
+        );
+    }
+    
+    auto level = family == AF_INET6 ? SOL_IPV6 : SOL_IP;
+    
+    if (transparent == true)
+    {
+        if (
+            setsockopt(fd, level, family == AF_INET6 ? IPV6_TRANSPARENT :
+            IP_TRANSPARENT, &enable, sizeof(enable)) != 0
+            )
+        {
+            log_error(
+                "Uring manager failed to set transparent, message = " <<
+                std::strerror(errno) << "."
+            );
+        }
+    }
+    
+    /**
+     * Every datagram carries it's (original) destination.
+     */
+    if (type == SOCK_DGRAM)
+    {
+        setsockopt(
+            fd, level, family == AF_INET6 ? IPV6_RECVORIGDSTADDR :
+            IP_RECVORIGDSTADDR, &enable, sizeof(enable)
+        );
+        
+        /**
+         * A dual-stack socket reports ipv4 datagrams with IP_ORIGDSTADDR.
+         */
+        if (family == AF_INET6)
+        {
+            setsockopt(
+                fd, SOL_IP, IP_RECVORIGDSTADDR, &enable, sizeof(enable)
+            );
+        }
+    }
+    
+    /**
+     * Attach the socket_filter.
+     */
+    std::error_code ec;
+    
+    if (type == SOCK_RAW && family == AF_INET6)
+    {
+        /**
+         * The socket_filter expects an ipv4 header, the allow-list is
+         * applied by the stack instead.
+         */
+        socket_filter::attach_icmpv6_types(
+            fd, {
+            icmp::header::type_echo_request_v6,
+            icmp::header::type_echo_reply_v6 }, ec
+        );
+        
+        if (ec)
+        {
+            log_error(
+                "Uring manager failed to set ICMPv6 filter, message = " <<
+                ec.message() << "."
+            );
+        }
+    }
+    else if (type == SOCK_RAW)
+    {
+        socket_filter::attach_icmp_types(
+            fd, {
+            icmp::header::type_echo_request, icmp::header::type_echo_reply },
+            ec
+        );
+        
+        if (ec)
+        {
+            log_error(
+                "Uring manager failed to set ICMP filter, message = " <<
+                ec.message() << "."
+            );
+        }
+        
+        socket_filter_icmp_.attach(fd, ec);
+    }
+    else if (type == SOCK_DGRAM && socket_filter_udp_.instructions().size())
+    {
+        socket_filter_udp_.attach(fd, ec);
+    }
+    
+    if (ec)
+    {
+        log_error(
+            "Uring manager failed to attach socket filter, message = " <<
+            ec.message() << "."
+        );
+    }
+    
+    if (type != SOCK_RAW)
+    {
+        sockaddr_storage addr;
+        
+        std::memset(&addr, 0, sizeof(addr));
+        
+        socklen_t len = 0;
+        
+        if (family == AF_INET6)
+        {
+            auto addr6 = reinterpret_cast<sockaddr_in6 *> (&addr);
+            
+            addr6->sin6_family = AF_INET6;
+            addr6->sin6_addr = in6addr_any;
+            addr6->sin6_port = htons(port);
+            
+            len = sizeof(sockaddr_in6);
+        }
+        else
+        {
+            auto addr4 = reinterpret_cast<sockaddr_in *> (&addr);
+            
+            addr4->sin_family = AF_INET;
+            addr4->sin_addr.s_addr = htonl(INADDR_ANY);
+            addr4->sin_port = htons(port);
+            
+            len = sizeof(sockaddr_in);
+        }
+        
+        if (
+            bind(fd, reinterpret_cast<sockaddr *> (&addr), len) != 0 ||
+            (type == SOCK_STREAM && listen(fd, SOMAXCONN) != 0)
+            )
+        {
+            log_debug(
+                "Uring manager failed to bind port " << port <<
+                ", message = " << std::strerror(errno) << "."
+            );
+            
+            ::close(fd);
+            
+            return true;
+        }
+    }
+    
+    socket_t s;
+    
+    s.fd = fd;
+    s.type = type;
+    s.port = port;
+    s.failures = 0;
+    s.is_backed_off = false;
+    s.is_retired = false;
+    
+    m_sockets.push_back(s);
+    
+    return true;
+}
+
+void uring_manager::run()
+{
+    while (state_ == state_starting || state_ == state_started)
+    {
+        try
+        {
+            submit(true);
+            
+            /**
+             * Reap every completion available.
+             */
+            auto head = *m_cq_head;
+            auto tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            
+            while (head != tail)
+            {
+                auto cqe = m_cqes[head & m_cq_mask];
+                
+                head++;
+                
+                __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+                
+                handle_cqe(cqe);
+            }
+        }
+        catch (std::exception & e)
+        {
+            log_error(
+                "Uring manager thread caught exception, what = " <<
+                e.what() << "."
+            );
+        }
+    }
+    
+    log_info("Uring manager thread has stopped.");
+}
+
+void uring_manager::on_tick()
+{
+    enum { read_write_timeout = 5 };
+    
+    auto now = std::chrono::steady_clock::now();
+    
+    /**
+     * Shutdown connections that have been open too long, the pending
+     * receive completes and the connection is closed.
+     */
+    for (auto & i : m_connections)
+    {
+        if (
+            i.second.is_shutdown == false && now - i.second.time_accepted >
+            std::chrono::seconds(read_write_timeout)
+            )
+        {
+            shutdown(i.second.fd, SHUT_RDWR);
+            
+            i.second.is_shutdown = true;
+        }
+    }
+    
+    /**
+     * Retry the sockets that failed since the last tick.
+     */
+    for (std::uint32_t i = 0; i < m_sockets.size(); i++)
+    {
+        if (m_sockets[i].is_backed_off == true && state_ == state_started)
+        {
+            m_sockets[i].is_backed_off = false;
+            
+            if (m_sockets[i].type == SOCK_STREAM)
+            {
+                arm_accept(i);
+            }
+            else
+            {
+                arm_recvmsg(i);
+            }
+        }
+    }
+}
+
+io_uring_sqe * uring_manager::get_sqe()
+{
+    /**
+     * If the submission queue is full submit what is queued.
+     */
+    while (
+        m_sq_tail_local - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >=
+        m_sq_entries
+        )
+    {
+        submit(false);
+    }
+    
+    auto sqe = &m_sqes[m_sq_tail_local & m_sq_mask];
+    
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    
+    m_sq_tail_local++;
+    
+    return sqe;
+}
+
+void uring_manager::submit(const bool & wait)
+{
+    __atomic_store_n(m_sq_tail, m_sq_tail_local, __ATOMIC_RELEASE);
+    
+    auto to_submit =
+        m_sq_tail_local - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE)
+    ;
+    
+    auto ret = syscall(
+        __NR_io_uring_enter, m_ring_fd, to_submit, wait ? 1 : 0,
+        wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0
+    );
+    
+    if (ret < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+    {
+        throw std::runtime_error(
+            std::string("io_uring_enter: ") + std::strerror(errno)
+        );
+    }
+}
+
+void uring_manager::handle_cqe(const io_uring_cqe & cqe)
+{
+    auto op = static_cast<op_t> (cqe.user_data >> 56);
+    auto index = cqe.user_data & 0x00ffffffffffffffULL;
+    
+    auto more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    
+    std::uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    
+    /**
+     * The provided buffer (if any) is returned once handled, failed
+     * completions may carry the buffer flag without a valid buffer id.
+     */
+    auto has_buffer =
+        cqe.res >= 0 && (cqe.flags & IORING_CQE_F_BUFFER) != 0 &&
+        bid < buffer_count;
+    
+    if (cqe.res < 0 && cqe.res != -ETIME && cqe.res != -ENOBUFS)
+    {
+        log_debug(
+            "Uring manager operation " << op << " failed, message = " <<
+            std::strerror(-cqe.res) << "."
+        );
+    }
+    
+    switch (op)
+    {
+        case op_accept:
+        {
+            if (cqe.res >= 0)
+            {
+                m_sockets[index].failures = 0;
+                
+                handle_accept(cqe.res);
+            }
+            
+            if (more == false && state_ == state_started)
+            {
+                rearm(static_cast<std::uint32_t> (index), cqe.res);
+            }
+        }
+        break;
+        case op_recvmsg:
+        {
+            if (cqe.res > 0 && has_buffer)
+            {
+                m_sockets[index].failures = 0;
+                
+                handle_recvmsg(
+                    static_cast<std::uint32_t> (index),
+                    m_buffers + bid * buffer_size, cqe.res
+                );
+            }
+            
+            if (more == false && state_ == state_started)
+            {
+                rearm(static_cast<std::uint32_t> (index), cqe.res);
+            }
+        }
+        break;
+        case op_recv:
+        {
+            if (cqe.res > 0 && has_buffer)
+            {
+                handle_recv(
+                    index, reinterpret_cast<const char *> (
+                    m_buffers + bid * buffer_size), cqe.res
+                );
+            }
+            
+            if (more == false)
+            {
+                /**
+                 * Out of buffers, receive again, otherwise the peer has
+                 * closed (or the connection was shutdown).
+                 */
+                if (cqe.res == -ENOBUFS && state_ == state_started)
+                {
+                    arm_recv(index);
+                }
+                else
+                {
+                    close_connection(index);
+                }
+            }
+        }
+        break;
+        case op_tick:
+        {
+            on_tick();
+            
+            arm_tick();
+        }
+        break;
+        case op_wakeup:
+        {
+            if (state_ == state_starting || state_ == state_started)
+            {
+                arm_wakeup();
+            }
+        }
+        break;
+        default:
+        break;
+    }
+    
+    if (has_buffer == true)
+    {
+        recycle_buffer(bid);
+    }
+}
+
+void uring_manager::rearm(
+    const std::uint32_t & index, const std::int32_t & res
+    )
+{
+    auto & s = m_sockets[index];
+    
+    if (s.is_backed_off == true || s.is_retired == true)
+    {
+        return;
+    }
+    
+    /**
+     * Out of buffers or interrupted, receive again right away.
+     */
+    if (res >= 0 || res == -ENOBUFS || res == -EINTR)
+    {
+        s.failures = 0;
+        
+        if (s.type == SOCK_STREAM)
+        {
+            arm_accept(index);
+        }
+        else
+        {
+            arm_recvmsg(index);
+        }
+        
+        return;
+    }
+    
+    /**
+     * Out of file descriptors (a connect flood) clears as the connections
+     * time out, anything else failing for max_failures ticks in a row (such
+     * as a kernel without multishot recvmsg) will not.
+     */
+    if (
+        res != -EMFILE && res != -ENFILE && res != -ENOMEM &&
+        ++s.failures >= max_failures
+        )
+    {
+        log_error(
+            "Uring manager is retiring port " << s.port << " after " <<
+            s.failures << " failures, message = " << std::strerror(-res) <<
+            "."
+        );
+        
+        s.is_retired = true;
+        
+        return;
+    }
+    
+    s.is_backed_off = true;
+}
+
+void uring_manager::arm_accept(const std::uint32_t & index)
+{
+    auto sqe = get_sqe();
+    
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = static_cast<std::int32_t> (index);
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = (static_cast<std::uint64_t> (op_accept) << 56) | index;
+}
+
+void uring_manager::arm_recvmsg(const std::uint32_t & index)
+{
+    auto sqe = get_sqe();
+    
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = static_cast<std::int32_t> (index);
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->addr = reinterpret_cast<std::uint64_t> (&m_msghdr[0]);
+    sqe->len = 1;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = (static_cast<std::uint64_t> (op_recvmsg) << 56) | index;
+}
+
+void uring_manager::arm_recv(const std::uint64_t & id)
+{
+    auto it = m_connections.find(id);
+    
+    if (it == m_connections.end())
+    {
+        return;
+    }
+    
+    auto sqe = get_sqe();
+    
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = it->second.fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = (static_cast<std::uint64_t> (op_recv) << 56) | id;
+}
+
+void uring_manager::arm_tick()
+{
+    auto sqe = get_sqe();
+    
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<std::uint64_t> (m_tick_timespec);
+    sqe->len = 1;
+    sqe->user_data = static_cast<std::uint64_t> (op_tick) << 56;
+}
+
+void uring_manager::arm_wakeup()
+{
+    auto sqe = get_sqe();
+    
+    /**
+     * Read the eventfd so the next write completes again.
+     */
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wakeup_fd;
+    sqe->addr = reinterpret_cast<std::uint64_t> (&m_wakeup_value);
+    sqe->len = sizeof(m_wakeup_value);
+    sqe->user_data = static_cast<std::uint64_t> (op_wakeup) << 56;
+}
+
+void uring_manager::recycle_buffer(const std::uint16_t & bid)
+{
+    /**
+     * The entries are indexed from the start of the ring rather than
+     * through bufs which some kernel headers declare at a nonzero offset
+     * when compiled as C++.
+     */
+    auto & buf = reinterpret_cast<io_uring_buf *> (m_buffer_ring)[
+        m_buffer_tail & (buffer_count - 1)
+    ];
+    
+    buf.addr = reinterpret_cast<std::uint64_t> (m_buffers + bid * buffer_size);
+    buf.len = buffer_size;
+    buf.bid = bid;
+    
+    m_buffer_tail++;
+    
+    __atomic_store_n(&m_buffer_ring->tail, m_buffer_tail, __ATOMIC_RELEASE);
+}
+
+void uring_manager::handle_accept(const int & fd)
+{
+    sockaddr_storage remote, local;
+    
+    socklen_t remote_len = sizeof(remote), local_len = sizeof(local);
+    
+    if (
+        getpeername(fd, reinterpret_cast<sockaddr *> (&remote),
+        &remote_len) != 0 || getsockname(fd, reinterpret_cast<sockaddr *> (
+        &local), &local_len) != 0
+        )
+    {
+        ::close(fd);
+        
+        return;
+    }
+    
+    asio::ip::tcp::endpoint remote_endpoint, local_endpoint;
+    
+    std::memcpy(remote_endpoint.data(), &remote, remote_len);
+    remote_endpoint.resize(remote_len);
+    std::memcpy(local_endpoint.data(), &local, local_len);
+    local_endpoint.resize(local_len);
+    
+    /**
+     * A transparent socket may be handed ports outside of the monitored
+     * port ranges.
+     */
+    if (
+        m_transparent == true && stack_impl_.get_configuration(
+        ).is_monitored_port(local_endpoint.port()) == false
+        )
+    {
+        ::close(fd);
+        
+        return;
+    }
+    
+    auto id = m_connection_id++;
+    
+    connection_t connection;
+    
+    connection.fd = fd;
+    connection.address = remote_endpoint.address();
+    connection.port = remote_endpoint.port();
+    connection.destination_address = local_endpoint.address();
+    connection.destination_port = local_endpoint.port();
+    connection.time_accepted = std::chrono::steady_clock::now();
+    connection.is_shutdown = false;
+    
+    m_connections[id] = connection;
+    
+    /**
+     * Allocate the threat.
+     */
+    threat threat_data(
+        threat::protocol_tcp, connection.address, connection.port, 0, 0
+    );
+    
+    threat_data.set_destination_address(connection.destination_address);
+    threat_data.set_destination_port(connection.destination_port);
+    
+    log_info(
+        "Uring manager has detected a possible threat (TCP Accept) from " <<
+        remote_endpoint << ", dispatching to threat_manager."
+    );
+    
+    /**
+     * Callback
+     */
+    stack_impl_.on_threat(threat_data);
+    
+    arm_recv(id);
+}
+
+void uring_manager::handle_recvmsg(
+    const std::uint32_t & index, const std::uint8_t * buf,
+    const std::size_t & len
+    )
+{
+    auto hdr = reinterpret_cast<const msghdr *> (&m_msghdr[0]);
+    
+    io_uring_recvmsg_out out;
+    
+    if (len < sizeof(out))
+    {
+        return;
+    }
+    
+    std::memcpy(&out, buf, sizeof(out));
+    
+    /**
+     * The name and control are at fixed offsets, the payload follows.
+     */
+    auto name = buf + sizeof(out);
+    auto control = name + hdr->msg_namelen;
+    auto payload = control + hdr->msg_controllen;
+    
+    auto offset = static_cast<std::size_t> (payload - buf);
+    
+    if (len < offset)
+    {
+        return;
+    }
+    
+    auto payload_length = std::min(
+        static_cast<std::size_t> (out.payloadlen), len - offset
+    );
+    
+    asio::ip::udp::endpoint ep;
+    
+    std::memcpy(
+        ep.data(), name, std::min(out.namelen, hdr->msg_namelen)
+    );
+    ep.resize(std::min(out.namelen, hdr->msg_namelen));
+    
+    const auto & s = m_sockets[index];
+    
+    if (s.type == SOCK_RAW)
+    {
+        auto is_v6 = ep.address().is_v6();
+        
+        /**
+         * The ipv4 packets include the ipv4 header, the kernel strips the
+         * ipv6 header from ICMPv6 packets.
+         */
+        ipv4_view ipv4_hdr(payload, payload_length);
+        
+        if (is_v6 == false && ipv4_hdr.valid() == false)
+        {
+            return;
+        }
+        
+        auto icmp_hdr =
+            is_v6 ? icmp_view(payload, payload_length) :
+            icmp_view(
+            ipv4_hdr.payload(), payload_length - ipv4_hdr.header_length())
+        ;
+        
+        if (icmp_hdr.valid() == false)
+        {
+            return;
+        }
+        
+        auto is_echo =
+            is_v6 ?
+            icmp_hdr.type() == icmp::header::type_echo_request_v6 ||
+            icmp_hdr.type() == icmp::header::type_echo_reply_v6 :
+            icmp_hdr.type() == icmp::header::type_echo_request ||
+            icmp_hdr.type() == icmp::header::type_echo_reply
+        ;
+        
+        /**
+         * Consider a PING to be a threat.
+         */
+        if (is_echo == true)
+        {
+            threat threat_data(threat::protocol_icmp, ep.address(), 0, 0, 0);
+            
+            threat_data.set_level(threat::level_3);
+            
+            /**
+             * Only the ipv4 packets are complete enough to record.
+             */
+            if (is_v6 == false)
+            {
+                threat_data.set_destination_address(
+                    ipv4_hdr.destination_address()
+                );
+                
+                threat_data.set_packet(payload, payload_length);
+            }
+            
+            log_info(
+                "Uring manager has detected a possible threat "
+                "(ICMP Receive) from " << ep.address() <<
+                ", dispatching to threat_manager."
+            );
+            
+            /**
+             * Callback
+             */
+            stack_impl_.on_threat(threat_data);
+        }
+    }
+    else
+    {
+        asio::ip::address destination_address;
+        
+        auto destination_port = s.port;
+        
+        /**
+         * Recover the address and port the datagram was sent to.
+         */
+        if (out.controllen > 0)
+        {
+            msghdr msg;
+            
+            std::memset(&msg, 0, sizeof(msg));
+            
+            msg.msg_control = const_cast<std::uint8_t *> (control);
+            msg.msg_controllen = out.controllen;
+            
+            for (
+                auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                cmsg = CMSG_NXTHDR(&msg, cmsg)
+                )
+            {
+                if (
+                    cmsg->cmsg_level == SOL_IP &&
+                    cmsg->cmsg_type == IP_ORIGDSTADDR
+                    )
+                {
+                    sockaddr_in addr;
+                    
+                    std::memcpy(&addr, CMSG_DATA(cmsg), sizeof(addr));
+                    
+                    destination_address = asio::ip::address_v4(
+                        ntohl(addr.sin_addr.s_addr)
+                    );
+                    destination_port = ntohs(addr.sin_port);
+                }
+                else if (
+                    cmsg->cmsg_level == SOL_IPV6 &&
+                    cmsg->cmsg_type == IPV6_ORIGDSTADDR
+                    )
+                {
+                    sockaddr_in6 addr;
+                    
+                    std::memcpy(&addr, CMSG_DATA(cmsg), sizeof(addr));
+                    
+                    asio::ip::address_v6::bytes_type bytes;
+                    
+                    std::memcpy(bytes.data(), &addr.sin6_addr, bytes.size());
+                    
+                    destination_address = asio::ip::address_v6(bytes);
+                    destination_port = ntohs(addr.sin6_port);
+                }
+            }
+        }
+        
+        /**
+         * A transparent socket may be handed ports outside of the monitored
+         * port ranges.
+         */
+        if (
+            m_transparent == true && stack_impl_.get_configuration(
+            ).is_monitored_port(destination_port) == false
+            )
+        {
+            return;
+        }
+        
+        if (payload_length == 0)
+        {
+            return;
+        }
+        
+        /**
+         * Allocate the threat.
+         */
+        threat threat_data(
+            threat::protocol_udp, ep.address(), ep.port(),
+            reinterpret_cast<const char *> (payload), payload_length
+        );
+        
+        threat_data.set_level(threat::level_3);
+        
+        threat_data.set_destination_address(destination_address);
+        threat_data.set_destination_port(destination_port);
+        
+        log_info(
+            "Uring manager has detected a possible threat (UDP Receive) "
+            "from " << ep << ", dispatching to threat_manager."
+        );
+        
+        /**
+         * Callback
+         */
+        stack_impl_.on_threat(threat_data);
+    }
+}
+
+void uring_manager::handle_recv(
+    const std::uint64_t & id, const char * buf, const std::size_t & len
+    )
+{
+    auto it = m_connections.find(id);
+    
+    if (it == m_connections.end())
+    {
+        return;
+    }
+    
+    /**
+     * Allocate the threat.
+     */
+    threat threat_data(
+        threat::protocol_tcp, it->second.address, it->second.port, buf, len
+    );
+    
+    threat_data.set_destination_address(it->second.destination_address);
+    threat_data.set_destination_port(it->second.destination_port);
+    
+    log_info(
+        "Uring manager has detected a possible threat (TCP Read) from " <<
+        it->second.address << ":" << it->second.port <<
+        ", dispatching to threat_manager."
+    );
+    
+    /**
+     * Callback
+     */
+    stack_impl_.on_threat(threat_data);
+}
+
+void uring_manager::close_connection(const std::uint64_t & id)
+{
+    auto it = m_connections.find(id);
+    
+    if (it != m_connections.end())
+    {
+        ::close(it->second.fd);
+        
+        m_connections.erase(it);
+    }
+}
+
+#endif // __linux__
@@ -20,6 +20,7 @@
 
 #include <sys/resource.h>
 
+#include <cstring>
 #include <sstream>
 
 #include <opensentinel/utility.hpp>
@@ -64,3 +65,36 @@ std::string utility::hex_string(
 {
     return hex_string(bytes.begin(), bytes.end(), spaces);
 }
+
+std::uint64_t utility::hash_address(
+    const asio::ip::address & addr, std::uint8_t * bytes
+    )
+{
+    asio::ip::address_v6::bytes_type val;
+    
+    if (addr.is_v4())
+    {
+        val = asio::ip::address_v6::v4_mapped(addr.to_v4()).to_bytes();
+    }
+    else
+    {
+        val = addr.to_v6().to_bytes();
+    }
+    
+    /**
+     * FNV-1a
+     */
+    std::uint64_t ret = 14695981039346656037ULL;
+    
+    for (auto & i : val)
+    {
+        ret = (ret ^ i) * 1099511628211ULL;
+    }
+    
+    if (bytes)
+    {
+        std::memcpy(bytes, val.data(), val.size());
+    }
+    
+    return mix(ret);
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define ASIO_STANDALONE 1
+
+#include <asio.hpp>
+
+#include <opensentinel/packet_view.hpp>
+#include <opensentinel/pcap_reader.hpp>
+#include <opensentinel/regex_dfa.hpp>
+
+/**
+ * Benchmarks the regex_dfa signatures against std::regex over the TCP and
+ * UDP payloads of a capture file.
+ * Usage: benchmark_regex <signatures> <capture.pcap> [iterations]
+ */
+
+/**
+ * Appends the TCP or UDP payload of an ip packet.
+ * @param buf The buffer.
+ * @param len The length.
+ * @param payloads The payloads.
+ */
+static void add_payload(
+    const std::uint8_t * buf, std::size_t len,
+    std::vector<std::string> & payloads
+    )
+{
+    std::uint8_t protocol = 0;
+    
+    if (len > 0 && (buf[0] >> 4) == 4)
+    {
+        opensentinel::ipv4_view ip(buf, len);
+        
+        if (ip.valid() == false)
+        {
+            return;
+        }
+        
+        protocol = ip.protocol();
+        buf = ip.payload();
+        len = ip.payload_length();
+    }
+    else if (len > 0 && (buf[0] >> 4) == 6)
+    {
+        opensentinel::ipv6_view ip(buf, len);
+        
+        if (ip.valid() == false)
+        {
+            return;
+        }
+        
+        protocol = ip.next_header();
+        buf = ip.payload();
+        len = ip.payload_length();
+    }
+    
+    if (protocol == 6)
+    {
+        opensentinel::tcp_view tcp(buf, len);
+        
+        if (tcp.valid() == true && tcp.payload_length() > 0)
+        {
+            payloads.push_back(
+                std::string(reinterpret_cast<const char *> (tcp.payload()),
+                tcp.payload_length())
+            );
+        }
+    }
+    else if (protocol == 17)
+    {
+        opensentinel::udp_view udp(buf, len);
+        
+        if (udp.valid() == true && udp.payload_length() > 0)
+        {
+            payloads.push_back(
+                std::string(reinterpret_cast<const char *> (udp.payload()),
+                udp.payload_length())
+            );
+        }
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr <<
+            "Usage: benchmark_regex <signatures> <capture.pcap> [iterations]" <<
+        std::endl;
+        
+        return 1;
+    }
+    
+    auto iterations = argc > 3 ? std::stoul(argv[3]) : 10;
+    
+    /**
+     * Compile every regex:/<regex>/[i] signature both ways.
+     */
+    std::vector<std::string> patterns;
+    std::vector<opensentinel::regex_dfa> dfas;
+    std::vector<std::regex> regexes;
+    
+    std::ifstream ifs(argv[1]);
+    
+    std::string line;
+    
+    while (std::getline(ifs, line))
+    {
+        auto pos = line.find("regex:/");
+        
+        auto end = line.rfind('/');
+        
+        if (line.empty() || line[0] == '#' || pos == std::string::npos)
+        {
+            continue;
+        }
+        
+        auto pattern = line.substr(pos + 7, end - pos - 7);
+        auto case_insensitive = line.substr(end + 1) == "i";
+        
+        try
+        {
+            opensentinel::regex_dfa dfa;
+            
+            dfa.compile(pattern, case_insensitive);
+            
+            regexes.push_back(std::regex(pattern,
+                case_insensitive ? std::regex::ECMAScript | std::regex::icase :
+                std::regex::ECMAScript)
+            );
+            
+            std::cout <<
+                pattern << ": " << dfa.states() << " states, " <<
+                dfa.classes() << " classes, " << dfa.table_size() <<
+                " bytes" <<
+            std::endl;
+            
+            patterns.push_back(pattern);
+            dfas.push_back(std::move(dfa));
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Skipping " << pattern << ", " << e.what() << std::endl;
+        }
+    }
+    
+    /**
+     * Read the payloads.
+     */
+    std::vector<std::string> payloads;
+    
+    std::size_t bytes = 0;
+    
+    try
+    {
+        opensentinel::pcap_reader reader;
+        
+        reader.open(argv[2]);
+        
+        std::chrono::nanoseconds timestamp;
+        
+        while (reader.read(timestamp) == true)
+        {
+            const auto & data = reader.data();
+            
+            std::size_t offset = 0;
+            
+            switch (reader.link_type())
+            {
+                case opensentinel::pcap_reader::link_type_ethernet:
+                {
+                    offset = 14;
+                    
+                    /**
+                     * Skip a VLAN tag.
+                     */
+                    if (
+                        data.size() > offset &&
+                        data[12] == 0x81 && data[13] == 0x00
+                        )
+                    {
+                        offset += 4;
+                    }
+                }
+                break;
+                case opensentinel::pcap_reader::link_type_linux_sll:
+                {
+                    offset = 16;
+                }
+                break;
+                default:
+                break;
+            }
+            
+            if (data.size() > offset)
+            {
+                add_payload(&data[offset], data.size() - offset, payloads);
+            }
+        }
+    }
+    catch (std::exception & e)
+    {
+        std::cerr << "Failed to read " << argv[2] << ", " << e.what() << std::endl;
+        
+        return 1;
+    }
+    
+    for (auto & i : payloads)
+    {
+        bytes += i.size();
+    }
+    
+    std::cout <<
+        patterns.size() << " regexes, " << payloads.size() << " payloads, " <<
+        bytes << " bytes, " << iterations << " iterations." <<
+    std::endl;
+    
+    if (patterns.empty() || payloads.empty())
+    {
+        return 1;
+    }
+    
+    std::size_t matches_dfa = 0, matches_std = 0;
+    
+    auto time_start = std::chrono::steady_clock::now();
+    
+    for (std::size_t i = 0; i < iterations; i++)
+    {
+        for (auto & j : payloads)
+        {
+            for (auto & k : dfas)
+            {
+                matches_dfa += k.search(j.data(), j.size());
+            }
+        }
+    }
+    
+    auto elapsed_dfa = std::chrono::duration<double> (
+        std::chrono::steady_clock::now() - time_start
+    ).count();
+    
+    time_start = std::chrono::steady_clock::now();
+    
+    for (std::size_t i = 0; i < iterations; i++)
+    {
+        for (auto & j : payloads)
+        {
+            for (auto & k : regexes)
+            {
+                matches_std += std::regex_search(j.begin(), j.end(), k);
+            }
+        }
+    }
+    
+    auto elapsed_std = std::chrono::duration<double> (
+        std::chrono::steady_clock::now() - time_start
+    ).count();
+    
+    auto megabytes = static_cast<double> (bytes * iterations) / (1 << 20);
+    
+    std::cout <<
+        "regex_dfa: " << elapsed_dfa << " s, " << megabytes / elapsed_dfa <<
+        " MiB/s, " << matches_dfa / iterations << " matches." << std::endl <<
+        "std::regex: " << elapsed_std << " s, " << megabytes / elapsed_std <<
+        " MiB/s, " << matches_std / iterations << " matches." << std::endl <<
+        "Speedup: " << elapsed_std / elapsed_dfa << "x" <<
+    std::endl;
+    
+    return matches_dfa == matches_std ? 0 : 1;
+}
@@ -18,6 +18,10 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+#include <map>
+#include <string>
+
 #define ASIO_STANDALONE 1
 
 #include <asio.hpp>
@@ -49,6 +53,34 @@ int main(int argc, const char * argv[])
     return ret;
 #endif // PERFORM_TESTS
     
+    /**
+     * The arguments in the form of --key=value or --key value.
+     */
+    std::map<std::string, std::string> args;
+    
+    for (auto i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "--", 2) == 0)
+        {
+            std::string arg = argv[i] + 2;
+            
+            auto pos = arg.find("=");
+            
+            if (pos != std::string::npos)
+            {
+                args[arg.substr(0, pos)] = arg.substr(pos + 1);
+            }
+            else if (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0)
+            {
+                args[arg] = argv[++i];
+            }
+            else
+            {
+                args[arg] = "1";
+            }
+        }
+    }
+    
     /**
      * Allocate the opensentinel::stack.
      */
@@ -57,7 +89,19 @@ int main(int argc, const char * argv[])
     /**
      * Start the opensentinel::stack.
      */
-    opensentinel_stack.start();
+    opensentinel_stack.start(args);
+    
+    /**
+     * A replay exits once the capture file has been drained.
+     */
+    if (args.count("replay") > 0)
+    {
+        opensentinel_stack.replay();
+        
+        opensentinel_stack.stop();
+        
+        return 0;
+    }
     
     /**
      * The asio::io_service that waits on the asio::signal_set.
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017-2018 Durban & Diamond, LLC.
+ *
+ * This file is part of Open Sentinel.
+ *
+ * Open Sentinel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <string>
+
+#include <opensentinel/regex_dfa.hpp>
+
+/**
+ * Checks the regex_dfa anchors and alternations.
+ * Usage: test_regex_dfa
+ */
+
+/**
+ * The number of failed checks.
+ */
+static int g_failures = 0;
+
+/**
+ * Checks that a pattern compiles and matches (or not) a payload.
+ * @param pattern The pattern.
+ * @param payload The payload.
+ * @param expected If true the payload should match.
+ */
+static void check_match(
+    const std::string & pattern, const std::string & payload,
+    const bool & expected
+    )
+{
+    try
+    {
+        opensentinel::regex_dfa dfa;
+        
+        dfa.compile(pattern, false);
+        
+        if (dfa.search(payload.data(), payload.size()) != expected)
+        {
+            std::cerr <<
+                "FAIL: " << pattern << (expected ? " should" : " should not") <<
+                " match " << payload <<
+            std::endl;
+            
+            ++g_failures;
+        }
+    }
+    catch (std::exception & e)
+    {
+        std::cerr <<
+            "FAIL: " << pattern << " failed to compile, " << e.what() <<
+        std::endl;
+        
+        ++g_failures;
+    }
+}
+
+/**
+ * Checks that a pattern is rejected.
+ * @param pattern The pattern.
+ */
+static void check_rejected(const std::string & pattern)
+{
+    try
+    {
+        opensentinel::regex_dfa dfa;
+        
+        dfa.compile(pattern, false);
+        
+        std::cerr << "FAIL: " << pattern << " should be rejected" << std::endl;
+        
+        ++g_failures;
+    }
+    catch (std::exception & e)
+    {
+        // ...
+    }
+}
+
+int main()
+{
+    /**
+     * Grouped alternations may be anchored.
+     */
+    check_match("^(?:GET|POST)$", "GET", true);
+    check_match("^(?:GET|POST)$", "POST", true);
+    check_match("^(?:GET|POST)$", "GETS", false);
+    check_match("^(?:GET|POST)$", "PUT", false);
+    check_match("^(?:a|b)", "bcd", true);
+    check_match("^(?:a|b)", "cab", false);
+    check_match("(?:admin|root)$", "user root", true);
+    check_match("(?:admin|root)$", "root user", false);
+    check_match("^(GET|POST) /", "POST /index.html", true);
+    
+    /**
+     * Unanchored alternations need no group.
+     */
+    check_match("admin|root", "login root", true);
+    
+    /**
+     * The anchors would bind to the first and last alternative only.
+     */
+    check_rejected("^GET|POST");
+    check_rejected("GET|POST$");
+    check_rejected("^GET|POST$");
+    
+    if (g_failures > 0)
+    {
+        std::cerr << g_failures << " checks failed." << std::endl;
+        
+        return 1;
+    }
+    
+    std::cout << "All checks passed." << std::endl;
+    
+    return 0;
+}